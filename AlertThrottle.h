@@ -0,0 +1,130 @@
+#pragma once
+
+#include "GMCheckCore.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string>
+
+// Rate limit for one alert output (sound, beep, popup): up to Burst at once, then one
+// more every Refill.  Anything over that is dropped and counted as suppressed.  A Refill
+// of zero (or less) is taken as one tick of Clock, Take divides by it.
+template <typename Clock>
+class TokenBucket
+{
+public:
+	using time_point = typename Clock::time_point;
+	using duration = typename Clock::duration;
+
+	TokenBucket(uint32_t Burst, duration Refill) : m_Burst(Burst), m_Refill(std::max(Refill, duration(1))), m_Tokens(Burst) {}
+
+	bool Take(time_point Now)
+	{
+		if (m_Tokens < m_Burst && Now > m_LastRefill)
+		{
+			const auto earned = static_cast<uint64_t>((Now - m_LastRefill) / m_Refill);
+			m_Tokens = static_cast<uint32_t>(std::min<uint64_t>(m_Burst, m_Tokens + earned));
+			m_LastRefill += m_Refill * earned;
+		}
+
+		if (!m_Tokens)
+		{
+			++m_Suppressed;
+			return false;
+		}
+
+		// Refilling starts with the first token taken from a full bucket
+		if (m_Tokens == m_Burst)
+			m_LastRefill = Now;
+		--m_Tokens;
+		return true;
+	}
+
+	uint64_t Suppressed() const { return m_Suppressed; }
+
+private:
+	uint32_t m_Burst;
+	duration m_Refill;
+	uint32_t m_Tokens;
+	time_point m_LastRefill;
+	uint64_t m_Suppressed = 0;
+};
+
+// Holds enter and leave alerts for a window after the first one, so GMs that zone in (or
+// out) together get one alert naming all of them instead of one alert each.  A window of
+// zero makes every alert due as soon as it's added.
+template <typename Clock>
+class AlertCoalescer
+{
+public:
+	using time_point = typename Clock::time_point;
+	using duration = typename Clock::duration;
+
+	void SetWindow(duration Window) { m_Window = Window; }
+
+	// Owned is whether this client plays the sounds for the GM (see GMSharedState.h)
+	void Add(const char* Name, GMStatuses Status, bool Owned, time_point Now)
+	{
+		Batch& batch = m_Batches[Status == GMStatuses::Leave ? 1 : 0];
+		if (batch.Names.empty())
+		{
+			batch.Due = Now + m_Window;
+			batch.Owned = false;
+		}
+		else
+		{
+			batch.Names += ", ";
+		}
+		batch.Names += Name;
+		batch.Owned = batch.Owned || Owned;
+		++m_Queued;
+	}
+
+	bool Pending() const { return !m_Batches[0].Names.empty() || !m_Batches[1].Names.empty(); }
+
+	// Callback gets (const char* Names, GMStatuses Status, bool Owned) for each batch that's due,
+	// or every batch if Force, the older batch first
+	template <typename Callback>
+	void Flush(time_point Now, bool Force, Callback&& callback)
+	{
+		const bool leave_first = !m_Batches[1].Names.empty() && (m_Batches[0].Names.empty() || m_Batches[1].Due < m_Batches[0].Due);
+		for (const size_t index : { leave_first ? size_t(1) : size_t(0), leave_first ? size_t(0) : size_t(1) })
+		{
+			Batch& batch = m_Batches[index];
+			if (batch.Names.empty() || (!Force && Now < batch.Due))
+				continue;
+
+			// Swapped out first in case the alert adds another
+			++m_Sent;
+			const bool owned = batch.Owned;
+			m_Sending.swap(batch.Names);
+			batch.Names.clear();
+			callback(m_Sending.c_str(), index ? GMStatuses::Leave : GMStatuses::Enter, owned);
+		}
+	}
+
+	void Clear()
+	{
+		for (Batch& batch : m_Batches)
+			batch.Names.clear();
+	}
+
+	// Enter/leave alerts added, and the alerts they went out as
+	uint64_t Queued() const { return m_Queued; }
+	uint64_t Sent() const { return m_Sent; }
+
+private:
+	struct Batch
+	{
+		std::string Names;
+		time_point Due;
+		bool Owned = false;
+	};
+
+	std::array<Batch, 2> m_Batches;
+	std::string m_Sending;
+	duration m_Window = duration::zero();
+	uint64_t m_Queued = 0;
+	uint64_t m_Sent = 0;
+};
@@ -0,0 +1,97 @@
+#include "AllocAccounting.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace AllocAccounting
+{
+	static thread_local uint64_t t_Allocations = 0;
+	static std::atomic<uint64_t> s_Allocations = 0;
+
+	uint64_t ThreadAllocations()
+	{
+		return t_Allocations;
+	}
+
+	uint64_t TotalAllocations()
+	{
+		return s_Allocations.load(std::memory_order_relaxed);
+	}
+
+#if GMCHECK_ALLOC_ACCOUNTING
+	static void* Allocate(size_t Size, size_t Alignment = 0)
+	{
+		++t_Allocations;
+		s_Allocations.fetch_add(1, std::memory_order_relaxed);
+		if (Size == 0)
+			Size = 1;
+#if _WIN32
+		return Alignment ? _aligned_malloc(Size, Alignment) : malloc(Size);
+#else
+		return Alignment ? aligned_alloc(Alignment, (Size + Alignment - 1) / Alignment * Alignment) : malloc(Size);
+#endif
+	}
+
+	static void Free(void* Ptr, bool Aligned = false)
+	{
+#if _WIN32
+		if (Aligned)
+		{
+			_aligned_free(Ptr);
+			return;
+		}
+#else
+		(void)Aligned;
+#endif
+		free(Ptr);
+	}
+#endif
+}
+
+#if GMCHECK_ALLOC_ACCOUNTING
+void* operator new(size_t Size)
+{
+	if (void* ptr = AllocAccounting::Allocate(Size))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t Size)
+{
+	return operator new(Size);
+}
+
+void* operator new(size_t Size, const std::nothrow_t&) noexcept
+{
+	return AllocAccounting::Allocate(Size);
+}
+
+void* operator new[](size_t Size, const std::nothrow_t&) noexcept
+{
+	return AllocAccounting::Allocate(Size);
+}
+
+void* operator new(size_t Size, std::align_val_t Alignment)
+{
+	if (void* ptr = AllocAccounting::Allocate(Size, static_cast<size_t>(Alignment)))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t Size, std::align_val_t Alignment)
+{
+	return operator new(Size, Alignment);
+}
+
+void operator delete(void* Ptr) noexcept { AllocAccounting::Free(Ptr); }
+void operator delete[](void* Ptr) noexcept { AllocAccounting::Free(Ptr); }
+void operator delete(void* Ptr, size_t) noexcept { AllocAccounting::Free(Ptr); }
+void operator delete[](void* Ptr, size_t) noexcept { AllocAccounting::Free(Ptr); }
+void operator delete(void* Ptr, const std::nothrow_t&) noexcept { AllocAccounting::Free(Ptr); }
+void operator delete[](void* Ptr, const std::nothrow_t&) noexcept { AllocAccounting::Free(Ptr); }
+void operator delete(void* Ptr, std::align_val_t) noexcept { AllocAccounting::Free(Ptr, true); }
+void operator delete[](void* Ptr, std::align_val_t) noexcept { AllocAccounting::Free(Ptr, true); }
+void operator delete(void* Ptr, size_t, std::align_val_t) noexcept { AllocAccounting::Free(Ptr, true); }
+void operator delete[](void* Ptr, size_t, std::align_val_t) noexcept { AllocAccounting::Free(Ptr, true); }
+#endif
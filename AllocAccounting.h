@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+// Heap allocation counting for checking that a quiet pulse never allocates.  Only the
+// benchmark and test_quiet_pulse are built with GMCHECK_ALLOC_ACCOUNTING=1, which
+// replaces the global operator new (AllocAccounting.cpp).  The plugin never links it.
+#ifndef GMCHECK_ALLOC_ACCOUNTING
+#define GMCHECK_ALLOC_ACCOUNTING 0
+#endif
+
+namespace AllocAccounting
+{
+	constexpr inline bool Enabled = GMCHECK_ALLOC_ACCOUNTING != 0;
+
+	// Allocations made by the calling thread since it started
+	uint64_t ThreadAllocations();
+	// Allocations made by every thread
+	uint64_t TotalAllocations();
+}
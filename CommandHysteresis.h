@@ -0,0 +1,169 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+// When to run GMEnterCmd / GMLeaveCmd.  A GM who flickers in and out (invis toggles,
+// zone bouncing) would otherwise run the pair every time, so:
+//   - the leave command waits LeaveDelay after the last GM goes, and a GM coming back
+//     in that time just cancels it,
+//   - neither command runs until the state the last one left (GMs here or not) has
+//     lasted MinState, a skipped command that still changes it counts too,
+//   - no more than MaxCommands run in any Window.
+// A command that's held by either of the last two runs as soon as it's allowed, if it's
+// still wanted.  Time only ever comes in through the arguments.
+enum class CommandAction
+{
+	None,
+	Enter,
+	Leave,
+};
+
+enum class CommandState
+{
+	Idle,      // no enter command in effect
+	Entering,  // GMs are here but the enter command is being held
+	Active,    // the enter command ran
+	Leaving,   // the GMs are gone, waiting to run the leave command
+};
+
+template <typename Clock>
+class CommandHysteresis
+{
+public:
+	using time_point = typename Clock::time_point;
+	using duration = typename Clock::duration;
+	static constexpr inline uint32_t MaxCommandsLimit = 16;
+
+	struct Config
+	{
+		duration MinState = duration::zero();
+		duration LeaveDelay = duration::zero();
+		uint32_t MaxCommands = MaxCommandsLimit;
+		duration Window = duration::zero();
+	};
+
+	void Configure(const Config& Settings)
+	{
+		m_Config = Settings;
+		if (m_Config.MaxCommands > MaxCommandsLimit)
+			m_Config.MaxCommands = MaxCommandsLimit;
+	}
+
+	// With whether there are GMs in zone, returns the command to run now (if any).  Report back
+	// what happened with Completed().
+	CommandAction Update(bool GMsPresent, time_point Now)
+	{
+		switch (m_State)
+		{
+		case CommandState::Idle:
+		case CommandState::Entering:
+			if (!GMsPresent)
+			{
+				m_State = CommandState::Idle;
+				return CommandAction::None;
+			}
+			if (!Allowed(Now))
+			{
+				if (m_State == CommandState::Idle)
+					++m_Held;
+				m_State = CommandState::Entering;
+				return CommandAction::None;
+			}
+			return CommandAction::Enter;
+
+		case CommandState::Active:
+			if (GMsPresent)
+				return CommandAction::None;
+			m_State = CommandState::Leaving;
+			m_LeftAt = Now;
+			[[fallthrough]];
+
+		case CommandState::Leaving:
+			if (GMsPresent)
+			{
+				// Back before the leave command ran, nothing to do
+				++m_Absorbed;
+				m_State = CommandState::Active;
+				return CommandAction::None;
+			}
+			if (Now - m_LeftAt < m_Config.LeaveDelay || !Allowed(Now))
+				return CommandAction::None;
+			return CommandAction::Leave;
+		}
+		return CommandAction::None;
+	}
+
+	// Ran is false if the command was skipped (none set, or its condition was false)
+	void Completed(CommandAction Action, bool Ran, time_point Now)
+	{
+		if (Action == CommandAction::None)
+			return;
+
+		if (Ran)
+		{
+			m_Recent[m_Next++ % MaxCommandsLimit] = Now;
+			++m_Commands;
+		}
+
+		// A skipped enter leaves nothing to undo, a skipped leave still means the GMs are gone
+		const CommandState state = Action == CommandAction::Enter && Ran ? CommandState::Active : CommandState::Idle;
+		if (state == CommandState::Active || Action == CommandAction::Leave)
+		{
+			m_StateSince = Now;
+			m_StateChanged = true;
+		}
+		m_State = state;
+	}
+
+	// Back to Idle without a leave command, for zoning: the GMs didn't leave, we did, and the
+	// enter command runs again for any in the new zone.  The timing and the window carry over.
+	void Reset()
+	{
+		m_State = CommandState::Idle;
+	}
+
+	// Update needs calling (on the pulse) while this is true, nothing else happens without an event
+	bool Pending() const { return m_State == CommandState::Entering || m_State == CommandState::Leaving; }
+	CommandState State() const { return m_State; }
+
+	uint64_t Commands() const { return m_Commands; }
+	uint64_t Held() const { return m_Held; }
+	uint64_t Absorbed() const { return m_Absorbed; }
+
+	static const char* Name(CommandState State)
+	{
+		switch (State)
+		{
+		case CommandState::Idle: return "IDLE";
+		case CommandState::Entering: return "ENTERING";
+		case CommandState::Active: return "ACTIVE";
+		case CommandState::Leaving: return "LEAVING";
+		}
+		return "UNKNOWN";
+	}
+
+private:
+	bool Allowed(time_point Now) const
+	{
+		if (m_StateChanged && Now - m_StateSince < m_Config.MinState)
+			return false;
+
+		// The command MaxCommands back has to be out of the window, 0 is no limit
+		if (!m_Config.MaxCommands || m_Next < m_Config.MaxCommands)
+			return true;
+		return Now - m_Recent[(m_Next - m_Config.MaxCommands) % MaxCommandsLimit] >= m_Config.Window;
+	}
+
+	Config m_Config;
+	CommandState m_State = CommandState::Idle;
+	time_point m_LeftAt;
+	// When Idle / Active was last entered, the state the plugin starts in has no minimum
+	time_point m_StateSince;
+	bool m_StateChanged = false;
+	std::array<time_point, MaxCommandsLimit> m_Recent = {};
+	uint64_t m_Next = 0;
+	uint64_t m_Commands = 0;
+	uint64_t m_Held = 0;
+	uint64_t m_Absorbed = 0;
+};
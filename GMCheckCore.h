@@ -0,0 +1,63 @@
+#pragma once
+
+// The seams between the GM tracking logic and the game.  Nothing in here (or in the
+// other GMCheck*.h / GMRegistry.h headers) includes MQ, so the tracking, settings
+// and history code can be driven by a stand-in spawn list and ini outside the client.
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+enum class GMStatuses
+{
+	Enter,
+	Leave,
+	Reminder
+};
+
+// A spawn as the tracker sees it.  Handle only identifies the spawn and is never dereferenced.
+struct SpawnRef
+{
+	uint32_t SpawnID = 0;
+	const char* Name = "";
+	const void* Handle = nullptr;
+};
+
+// Where GMs come from.  Only spawns that pass the GM filter (flag set, not us, corpse setting) are reported.
+class ISpawnSource
+{
+public:
+	virtual ~ISpawnSource() = default;
+	virtual bool FindGM(uint32_t SpawnID, SpawnRef& Spawn) const = 0;
+	virtual void ForEachGM(const std::function<void(const SpawnRef&)>& Callback) const = 0;
+};
+
+// Where alerts go.  Sighted is called once for each new GM, before any alert for it.
+// Removed is called for every GM dropped from the list, however it went (despawn,
+// verify or audit), but not when the whole list is cleared on zoning.
+class IAlertSink
+{
+public:
+	virtual ~IAlertSink() = default;
+	virtual void Sighted(const SpawnRef& Spawn) = 0;
+	virtual void Removed(const SpawnRef& Spawn) = 0;
+	virtual void Alert(const char* Names, GMStatuses Status) = 0;
+};
+
+// Where settings are kept
+class IProfileStore
+{
+public:
+	virtual ~IProfileStore() = default;
+	virtual std::string GetString(const char* Section, const char* Key, const std::string& Default) const = 0;
+	virtual int GetInt(const char* Section, const char* Key, int Default) const = 0;
+	virtual bool GetBool(const char* Section, const char* Key, bool Default) const = 0;
+	virtual bool KeyExists(const char* Section, const char* Key) const = 0;
+	virtual std::vector<std::string> GetKeys(const char* Section) const = 0;
+	virtual std::vector<std::string> GetSections() const = 0;
+	virtual void WriteString(const char* Section, const char* Key, const std::string& Value) = 0;
+	virtual void WriteInt(const char* Section, const char* Key, int Value) = 0;
+	virtual void WriteBool(const char* Section, const char* Key, bool Value) = 0;
+	virtual void DeleteSection(const char* Section) = 0;
+};
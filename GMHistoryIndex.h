@@ -0,0 +1,315 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// In-memory index over the sighting log, built once when the log is opened and then
+// added to as sightings are recorded.  Each GM/server/zone combination keeps its
+// sighting times in order with running totals, so a query is a lookup of the
+// combinations in scope and a binary search for "since" in each.  Totals per GM and
+// per GM and server are kept alongside for the TLO, which only ever wants one GM.
+enum class HistorySort
+{
+	Name,
+	Count,
+	LastSeen,
+};
+
+struct HistoryQuery
+{
+	std::string_view Server;   // empty for every server
+	std::string_view Zone;     // empty for every zone
+	std::string_view Filter;   // only GMs with this in their name (any case)
+	int64_t Since = 0;
+	HistorySort Sort = HistorySort::Name;
+	size_t Offset = 0;
+	size_t Limit = 0;          // 0 for no limit
+};
+
+struct HistoryTotals
+{
+	uint64_t Count = 0;
+	int64_t LastSeen = 0;
+};
+
+struct HistoryRow
+{
+	std::string_view GM;
+	std::string_view LastServer;
+	std::string_view LastZone;
+	uint64_t Count = 0;
+	int64_t LastSeen = 0;
+};
+
+class GMHistoryIndex
+{
+public:
+	void Add(std::string_view GM, std::string_view Server, std::string_view Zone, int64_t Timestamp, uint32_t Count);
+	void Clear();
+
+	size_t GMCount() const { return m_GMs.size(); }
+	uint64_t Sightings() const { return m_Sightings; }
+
+	// GM names are matched in any case, 0 if the GM has never been seen
+	uint32_t FindGM(std::string_view GM) const;
+	const HistoryTotals& Totals(uint32_t GM) const;
+	uint64_t Count(uint32_t GM, std::string_view Server) const;
+	uint64_t Count(uint32_t GM, std::string_view Server, std::string_view Zone) const;
+
+	// Fills Rows with the requested page and returns how many GMs matched in total
+	size_t Run(const HistoryQuery& Query, std::vector<HistoryRow>& Rows);
+
+private:
+	struct Series
+	{
+		uint32_t GM = 0;
+		uint32_t Server = 0;
+		uint32_t Zone = 0;
+		std::vector<int64_t> Times;
+		std::vector<uint64_t> Totals;   // Totals[i] is the count of everything up to and including Times[i]
+	};
+
+	struct SeriesKey
+	{
+		uint32_t GM;
+		uint32_t Server;
+		uint32_t Zone;
+		bool operator==(const SeriesKey& Other) const { return GM == Other.GM && Server == Other.Server && Zone == Other.Zone; }
+	};
+
+	struct SeriesKeyHash
+	{
+		size_t operator()(const SeriesKey& Key) const { return std::hash<uint64_t>()(((static_cast<uint64_t>(Key.GM) << 32) | Key.Server) * 0x9E3779B97F4A7C15ull ^ Key.Zone); }
+	};
+
+	static uint64_t PairKey(uint32_t A, uint32_t B) { return (static_cast<uint64_t>(A) << 32) | B; }
+	static std::string Lower(std::string_view Text);
+	static bool ContainsNoCase(std::string_view Text, std::string_view Part);
+	uint32_t Intern(std::string_view Text);
+	uint32_t Find(std::string_view Text) const;
+	std::string_view Text(uint32_t Id) const { return m_Strings[Id - 1]; }
+	void Accumulate(const Series& series, const HistoryQuery& Query);
+
+	std::vector<std::string> m_Strings;
+	std::unordered_map<std::string, uint32_t> m_Ids;
+	std::vector<Series> m_Series;
+	std::map<std::pair<uint32_t, uint32_t>, std::vector<uint32_t>> m_ByServerZone;
+	std::unordered_map<uint32_t, std::vector<uint32_t>> m_ByServer;
+	std::unordered_map<SeriesKey, uint32_t, SeriesKeyHash> m_ByKey;
+	std::unordered_map<uint32_t, HistoryTotals> m_GMs;
+	std::unordered_map<std::string, uint32_t> m_GMsByName;   // lower cased
+	std::unordered_map<uint64_t, uint64_t> m_ServerCounts;   // GM and server ids
+	uint64_t m_Sightings = 0;
+
+	// Per query scratch, indexed by GM id, kept so repeat queries don't allocate
+	std::vector<HistoryRow> m_Rows;
+	std::vector<uint32_t> m_Touched;
+};
+
+inline std::string GMHistoryIndex::Lower(std::string_view Text)
+{
+	std::string lower(Text);
+	std::transform(lower.begin(), lower.end(), lower.begin(), [](char c) { return static_cast<char>(tolower(static_cast<unsigned char>(c))); });
+	return lower;
+}
+
+inline bool GMHistoryIndex::ContainsNoCase(std::string_view Text, std::string_view Part)
+{
+	return std::search(Text.begin(), Text.end(), Part.begin(), Part.end(),
+		[](char a, char b) { return tolower(static_cast<unsigned char>(a)) == tolower(static_cast<unsigned char>(b)); }) != Text.end();
+}
+
+inline uint32_t GMHistoryIndex::Intern(std::string_view Text)
+{
+	const auto [it, added] = m_Ids.try_emplace(std::string(Text), static_cast<uint32_t>(m_Strings.size() + 1));
+	if (added)
+		m_Strings.emplace_back(Text);
+	return it->second;
+}
+
+inline uint32_t GMHistoryIndex::Find(std::string_view Text) const
+{
+	const auto it = m_Ids.find(std::string(Text));
+	return it == m_Ids.end() ? 0 : it->second;
+}
+
+inline void GMHistoryIndex::Add(std::string_view GM, std::string_view Server, std::string_view Zone, int64_t Timestamp, uint32_t Count)
+{
+	if (GM.empty())
+		return;
+
+	const uint32_t gm = Intern(GM);
+	const uint32_t server = Intern(Server);
+	const uint32_t zone = Intern(Zone);
+
+	auto [it, added] = m_ByKey.try_emplace({ gm, server, zone }, static_cast<uint32_t>(m_Series.size()));
+	if (added)
+	{
+		Series& series = m_Series.emplace_back();
+		series.GM = gm;
+		series.Server = server;
+		series.Zone = zone;
+		m_ByServerZone[{ server, zone }].push_back(it->second);
+		m_ByServer[server].push_back(it->second);
+		m_GMsByName.try_emplace(Lower(GM), gm);
+	}
+
+	HistoryTotals& totals = m_GMs[gm];
+	totals.Count += Count;
+	totals.LastSeen = std::max(totals.LastSeen, Timestamp);
+	m_ServerCounts[PairKey(gm, server)] += Count;
+	m_Sightings += Count;
+
+	Series& series = m_Series[it->second];
+
+	// Sightings nearly always arrive in order, imports and merges are the exception
+	if (series.Times.empty() || Timestamp >= series.Times.back())
+	{
+		series.Times.push_back(Timestamp);
+		series.Totals.push_back((series.Totals.empty() ? 0 : series.Totals.back()) + Count);
+		return;
+	}
+
+	const size_t at = std::upper_bound(series.Times.begin(), series.Times.end(), Timestamp) - series.Times.begin();
+	series.Times.insert(series.Times.begin() + at, Timestamp);
+	series.Totals.insert(series.Totals.begin() + at, (at ? series.Totals[at - 1] : 0) + Count);
+	for (size_t i = at + 1; i < series.Totals.size(); ++i)
+		series.Totals[i] += Count;
+}
+
+inline void GMHistoryIndex::Clear()
+{
+	m_Strings.clear();
+	m_Ids.clear();
+	m_Series.clear();
+	m_ByServerZone.clear();
+	m_ByServer.clear();
+	m_ByKey.clear();
+	m_GMs.clear();
+	m_GMsByName.clear();
+	m_ServerCounts.clear();
+	m_Sightings = 0;
+	m_Rows.clear();
+	m_Touched.clear();
+}
+
+inline uint32_t GMHistoryIndex::FindGM(std::string_view GM) const
+{
+	const auto it = m_GMsByName.find(Lower(GM));
+	return it == m_GMsByName.end() ? 0 : it->second;
+}
+
+inline const HistoryTotals& GMHistoryIndex::Totals(uint32_t GM) const
+{
+	static const HistoryTotals none;
+	const auto it = m_GMs.find(GM);
+	return it == m_GMs.end() ? none : it->second;
+}
+
+inline uint64_t GMHistoryIndex::Count(uint32_t GM, std::string_view Server) const
+{
+	const auto it = m_ServerCounts.find(PairKey(GM, Find(Server)));
+	return it == m_ServerCounts.end() ? 0 : it->second;
+}
+
+inline uint64_t GMHistoryIndex::Count(uint32_t GM, std::string_view Server, std::string_view Zone) const
+{
+	const auto it = m_ByKey.find({ GM, Find(Server), Find(Zone) });
+	return it == m_ByKey.end() ? 0 : m_Series[it->second].Totals.back();
+}
+
+inline void GMHistoryIndex::Accumulate(const Series& series, const HistoryQuery& Query)
+{
+	size_t first = 0;
+	if (Query.Since)
+		first = std::lower_bound(series.Times.begin(), series.Times.end(), Query.Since) - series.Times.begin();
+	if (first == series.Times.size())
+		return;
+
+	if (!Query.Filter.empty() && !ContainsNoCase(Text(series.GM), Query.Filter))
+		return;
+
+	HistoryRow& row = m_Rows[series.GM - 1];
+	if (row.GM.empty())
+	{
+		row.GM = Text(series.GM);
+		m_Touched.push_back(series.GM - 1);
+	}
+
+	row.Count += series.Totals.back() - (first ? series.Totals[first - 1] : 0);
+	if (series.Times.back() >= row.LastSeen)
+	{
+		row.LastSeen = series.Times.back();
+		row.LastServer = Text(series.Server);
+		row.LastZone = Text(series.Zone);
+	}
+}
+
+inline size_t GMHistoryIndex::Run(const HistoryQuery& Query, std::vector<HistoryRow>& Rows)
+{
+	Rows.clear();
+	m_Rows.resize(m_Strings.size());
+	m_Touched.clear();
+
+	if (Query.Server.empty())
+	{
+		for (const Series& series : m_Series)
+		{
+			if (Query.Zone.empty() || Text(series.Zone) == Query.Zone)
+				Accumulate(series, Query);
+		}
+	}
+	else if (const uint32_t server = Find(Query.Server))
+	{
+		const std::vector<uint32_t>* pSeries = nullptr;
+		if (Query.Zone.empty())
+		{
+			const auto it = m_ByServer.find(server);
+			pSeries = it == m_ByServer.end() ? nullptr : &it->second;
+		}
+		else if (const uint32_t zone = Find(Query.Zone))
+		{
+			const auto it = m_ByServerZone.find({ server, zone });
+			pSeries = it == m_ByServerZone.end() ? nullptr : &it->second;
+		}
+
+		if (pSeries)
+		{
+			for (const uint32_t index : *pSeries)
+				Accumulate(m_Series[index], Query);
+		}
+	}
+
+	for (const uint32_t index : m_Touched)
+	{
+		Rows.push_back(m_Rows[index]);
+		m_Rows[index] = HistoryRow();
+	}
+
+	switch (Query.Sort)
+	{
+	case HistorySort::Name:
+		std::sort(Rows.begin(), Rows.end(), [](const HistoryRow& a, const HistoryRow& b) { return a.GM < b.GM; });
+		break;
+	case HistorySort::Count:
+		std::sort(Rows.begin(), Rows.end(), [](const HistoryRow& a, const HistoryRow& b) { return a.Count != b.Count ? a.Count > b.Count : a.GM < b.GM; });
+		break;
+	case HistorySort::LastSeen:
+		std::sort(Rows.begin(), Rows.end(), [](const HistoryRow& a, const HistoryRow& b) { return a.LastSeen != b.LastSeen ? a.LastSeen > b.LastSeen : a.GM < b.GM; });
+		break;
+	}
+
+	const size_t matched = Rows.size();
+	const size_t first = std::min(Query.Offset, matched);
+	const size_t last = Query.Limit ? std::min(matched, first + Query.Limit) : matched;
+	Rows.erase(Rows.begin() + last, Rows.end());
+	Rows.erase(Rows.begin(), Rows.begin() + first);
+	return matched;
+}
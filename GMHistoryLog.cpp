@@ -0,0 +1,463 @@
+#include "GMHistoryLog.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <tuple>
+
+uint32_t GMHistoryLog::Checksum(const HistoryRecord* pRecords, size_t Slots)
+{
+	// FNV-1a over everything but the checksum itself
+	const uint8_t* pData = reinterpret_cast<const uint8_t*>(pRecords) + sizeof(uint32_t);
+	const size_t length = Slots * sizeof(HistoryRecord) - sizeof(uint32_t);
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < length; ++i)
+	{
+		hash ^= pData[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+HistoryRecord GMHistoryLog::MakeIndex(HistoryEvent Type) const
+{
+	HistoryRecord record = {};
+	record.Type = Type;
+	record.Index.Magic = Magic;
+	record.Index.Version = Version;
+	record.Index.Events = m_Events;
+	record.Index.Strings = static_cast<uint32_t>(m_Strings.size());
+	record.Index.LastTimestamp = m_LastTimestamp;
+	record.Checksum = Checksum(&record, 1);
+	return record;
+}
+
+bool GMHistoryLog::ReadSlots(const std::filesystem::path& Path, std::istream& File, std::vector<HistoryRecord>& Slots)
+{
+	std::error_code ec;
+	const uintmax_t size = std::filesystem::file_size(Path, ec);
+	if (ec)
+		return false;
+
+	Slots.resize(static_cast<size_t>(size / sizeof(HistoryRecord)));
+	File.clear();
+	File.seekg(0);
+	File.read(reinterpret_cast<char*>(Slots.data()), Slots.size() * sizeof(HistoryRecord));
+	return !File.fail();
+}
+
+bool GMHistoryLog::ValidHeader(const std::vector<HistoryRecord>& Slots)
+{
+	return !Slots.empty() && Slots[0].Type == HistoryEvent::Header && Slots[0].Index.Magic == Magic
+		&& Slots[0].Index.Version >= 1 && Slots[0].Index.Version <= Version && Slots[0].Checksum == Checksum(&Slots[0], 1);
+}
+
+size_t GMHistoryLog::Scan(const std::vector<HistoryRecord>& Slots, std::vector<std::string>& Strings, uint32_t& Events, int64_t& LastTimestamp, int64_t& CompactedBefore, bool& FoundFooter)
+{
+	FoundFooter = false;
+	size_t slot = 1;
+	while (slot < Slots.size())
+	{
+		const HistoryRecord& record = Slots[slot];
+		size_t span = 1;
+		if (record.Type == HistoryEvent::String)
+		{
+			span = StringSlots(record.Length);
+			if (record.Length > MaxStringLength || slot + span > Slots.size() || record.String.Id != Strings.size() + 1)
+				break;
+		}
+
+		if (record.Checksum != Checksum(&record, span))
+			break;
+
+		if (record.Type == HistoryEvent::Footer)
+		{
+			FoundFooter = slot + 1 == Slots.size() && record.Index.Events == Events
+				&& record.Index.Strings == Strings.size();
+			break;
+		}
+
+		if (record.Type == HistoryEvent::String)
+		{
+			Strings.emplace_back(record.String.Text, record.Length);
+		}
+		else if (record.Type == HistoryEvent::Sighting || record.Type == HistoryEvent::Leave || record.Type == HistoryEvent::Rollup)
+		{
+			if (record.Event.GM > Strings.size() || record.Event.Server > Strings.size() || record.Event.Zone > Strings.size())
+				break;
+
+			++Events;
+			LastTimestamp = std::max(LastTimestamp, record.Event.Timestamp);
+		}
+		else if (record.Type == HistoryEvent::Compacted)
+		{
+			CompactedBefore = std::max(CompactedBefore, record.Event.Timestamp);
+		}
+		else
+		{
+			break;
+		}
+
+		slot += span;
+	}
+	return slot;
+}
+
+// Starts a brand new log with just a header and a footer
+bool GMHistoryLog::Reset()
+{
+	m_File.close();
+	m_Strings.clear();
+	m_StringIds.clear();
+	m_Events = 0;
+	m_LastTimestamp = 0;
+	m_CompactedBefore = 0;
+
+	m_File.open(m_Path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!m_File.is_open())
+		return false;
+
+	const HistoryRecord records[2] = { MakeIndex(HistoryEvent::Header), MakeIndex(HistoryEvent::Footer) };
+	m_File.write(reinterpret_cast<const char*>(records), sizeof(records));
+	m_File.flush();
+	m_FooterOffset = sizeof(HistoryRecord);
+	return !m_File.fail();
+}
+
+bool GMHistoryLog::Open(const std::filesystem::path& Path)
+{
+	std::scoped_lock lock(m_Mutex);
+	m_Path = Path;
+	m_DroppedBytes = 0;
+
+	std::error_code ec;
+	if (!exists(m_Path, ec) || std::filesystem::file_size(m_Path, ec) == 0)
+		return Reset();
+
+	// Reopening re-reads it, something else may have written it since
+	m_File.close();
+	m_Strings.clear();
+	m_StringIds.clear();
+	m_Events = 0;
+	m_LastTimestamp = 0;
+	m_CompactedBefore = 0;
+
+	m_File.open(m_Path, std::ios::in | std::ios::out | std::ios::binary);
+	std::vector<HistoryRecord> slots;
+	if (!m_File.is_open() || !ReadSlots(m_Path, m_File, slots))
+		return false;
+
+	// A partial slot at the end can only be a torn write
+	m_DroppedBytes = std::filesystem::file_size(m_Path, ec) % sizeof(HistoryRecord);
+
+	if (!ValidHeader(slots))
+	{
+		// Not something we can recover, keep it around rather than overwrite it
+		m_File.close();
+		std::filesystem::path bad_path = m_Path;
+		bad_path += ".bad";
+		std::filesystem::rename(m_Path, bad_path, ec);
+		m_DroppedBytes = slots.size() * sizeof(HistoryRecord);
+		return Reset();
+	}
+
+	bool found_footer = false;
+	const size_t slot = Scan(slots, m_Strings, m_Events, m_LastTimestamp, m_CompactedBefore, found_footer);
+	for (size_t i = 0; i < m_Strings.size(); ++i)
+		m_StringIds.emplace(m_Strings[i], static_cast<uint32_t>(i + 1));
+
+	m_FooterOffset = slot * sizeof(HistoryRecord);
+	if (!found_footer)
+	{
+		// Torn write (or a footer that doesn't match what's in front of it), cut it off and re-index
+		m_DroppedBytes += (slots.size() - slot) * sizeof(HistoryRecord);
+		m_File.close();
+		std::filesystem::resize_file(m_Path, m_FooterOffset, ec);
+		m_File.open(m_Path, std::ios::in | std::ios::out | std::ios::binary);
+		const HistoryRecord footer = MakeIndex(HistoryEvent::Footer);
+		m_File.seekp(m_FooterOffset);
+		m_File.write(reinterpret_cast<const char*>(&footer), sizeof(footer));
+		m_File.flush();
+	}
+
+	return m_File.is_open() && !m_File.fail();
+}
+
+void GMHistoryLog::Close()
+{
+	std::scoped_lock lock(m_Mutex);
+	m_File.close();
+}
+
+bool GMHistoryLog::Load(const std::filesystem::path& Path, std::vector<HistorySighting>& Sightings)
+{
+	std::ifstream file(Path, std::ios::in | std::ios::binary);
+	std::vector<HistoryRecord> slots;
+	if (!file.is_open() || !ReadSlots(Path, file, slots) || !ValidHeader(slots))
+		return false;
+
+	std::vector<std::string> strings;
+	uint32_t events = 0;
+	int64_t last_timestamp = 0;
+	int64_t compacted_before = 0;
+	bool found_footer = false;
+	const size_t end = Scan(slots, strings, events, last_timestamp, compacted_before, found_footer);
+	Sightings.reserve(Sightings.size() + events);
+	ForEachEvent(slots, end, strings, [&Sightings](const HistoryEntry& entry)
+		{
+			Sightings.push_back({ entry.Event, entry.Timestamp, std::string(entry.GM), std::string(entry.Server), std::string(entry.Zone), entry.Count });
+		});
+	return true;
+}
+
+uint32_t GMHistoryLog::Intern(std::string_view Text, std::vector<HistoryRecord>& Out)
+{
+	Text = Text.substr(0, MaxStringLength);
+	if (Text.empty())
+		return 0;
+
+	if (const auto it = m_StringIds.find(std::string(Text)); it != m_StringIds.end())
+		return it->second;
+
+	const size_t span = StringSlots(Text.length());
+	const size_t first = Out.size();
+	Out.resize(first + span, HistoryRecord{});
+
+	HistoryRecord& record = Out[first];
+	record.Type = HistoryEvent::String;
+	record.Length = static_cast<uint16_t>(Text.length());
+	record.String.Id = static_cast<uint32_t>(m_Strings.size() + 1);
+	// The text runs on past the first slot when it needs to
+	memcpy(record.String.Text, Text.data(), Text.length());
+	record.Checksum = Checksum(&record, span);
+
+	m_Strings.emplace_back(Text);
+	m_StringIds.emplace(m_Strings.back(), record.String.Id);
+	return record.String.Id;
+}
+
+void GMHistoryLog::AddEvent(const HistorySighting& Sighting, std::vector<HistoryRecord>& Out)
+{
+	const uint32_t gm = Intern(Sighting.GM, Out);
+	const uint32_t server = Intern(Sighting.Server, Out);
+	const uint32_t zone = Intern(Sighting.Zone, Out);
+
+	HistoryRecord record = {};
+	record.Type = Sighting.Event;
+	record.Event.Timestamp = Sighting.Timestamp;
+	record.Event.GM = gm;
+	record.Event.Server = server;
+	record.Event.Zone = zone;
+	record.Event.Count = Sighting.Count;
+	record.Checksum = Checksum(&record, 1);
+	Out.push_back(record);
+
+	++m_Events;
+	m_LastTimestamp = std::max(m_LastTimestamp, Sighting.Timestamp);
+}
+
+bool GMHistoryLog::Append(const std::vector<HistorySighting>& Sightings)
+{
+	std::scoped_lock lock(m_Mutex);
+	if (!m_File.is_open() || Sightings.empty())
+		return false;
+
+	std::vector<HistoryRecord> records;
+	records.reserve(Sightings.size() * 2 + 1);
+	for (const HistorySighting& sighting : Sightings)
+		AddEvent(sighting, records);
+	return WriteRecords(records);
+}
+
+// Writes new records over the old footer and puts a new one at the very end
+bool GMHistoryLog::WriteRecords(std::vector<HistoryRecord>& Records)
+{
+	Records.push_back(MakeIndex(HistoryEvent::Footer));
+	m_File.clear();
+	m_File.seekp(m_FooterOffset);
+	m_File.write(reinterpret_cast<const char*>(Records.data()), Records.size() * sizeof(HistoryRecord));
+	m_File.flush();
+	m_FooterOffset += (Records.size() - 1) * sizeof(HistoryRecord);
+	return !m_File.fail();
+}
+
+bool GMHistoryLog::Merge(std::vector<HistorySighting>& Sightings, int64_t Window, uint32_t& Added)
+{
+	std::scoped_lock lock(m_Mutex);
+	Added = 0;
+	if (!m_File.is_open())
+		return false;
+
+	// Event times already in the log per leave or not, GM, server and zone (by string id), in order
+	using Key = std::tuple<bool, uint32_t, uint32_t, uint32_t>;
+	std::map<Key, std::vector<int64_t>> times;
+	const auto id = [this](std::string_view Text) -> uint32_t
+		{
+			const auto it = m_StringIds.find(std::string(Text.substr(0, MaxStringLength)));
+			return it == m_StringIds.end() ? 0 : it->second;
+		};
+	ForEachLocked([&](const HistoryEntry& entry)
+		{
+			times[{ entry.Event == HistoryEvent::Leave, id(entry.GM), id(entry.Server), id(entry.Zone) }].push_back(entry.Timestamp);
+		});
+	for (auto& [key, list] : times)
+		std::sort(list.begin(), list.end());
+
+	std::stable_sort(Sightings.begin(), Sightings.end(), [](const HistorySighting& a, const HistorySighting& b) { return a.Timestamp < b.Timestamp; });
+
+	std::vector<HistoryRecord> records;
+	for (const HistorySighting& sighting : Sightings)
+	{
+		// Already counted in a rollup if it's older than the last compaction
+		if (sighting.GM.empty() || sighting.Timestamp < m_CompactedBefore)
+			continue;
+
+		const bool leave = sighting.Event == HistoryEvent::Leave;
+		const uint32_t gm = id(sighting.GM);
+		const uint32_t server = id(sighting.Server);
+		const uint32_t zone = id(sighting.Zone);
+		if (gm && (server || sighting.Server.empty()) && (zone || sighting.Zone.empty()))
+		{
+			const auto it = times.find({ leave, gm, server, zone });
+			if (it != times.end())
+			{
+				const auto near = std::lower_bound(it->second.begin(), it->second.end(), sighting.Timestamp - Window);
+				if (near != it->second.end() && *near <= sighting.Timestamp + Window)
+					continue;
+			}
+		}
+
+		AddEvent(sighting, records);
+		++Added;
+		std::vector<int64_t>& list = times[{ leave, id(sighting.GM), id(sighting.Server), id(sighting.Zone) }];
+		list.insert(std::upper_bound(list.begin(), list.end(), sighting.Timestamp), sighting.Timestamp);
+	}
+
+	return records.empty() || WriteRecords(records);
+}
+
+bool GMHistoryLog::Compact(int64_t Now, const HistoryRetention& Retention, HistoryCompaction& Result)
+{
+	std::scoped_lock lock(m_Mutex);
+	Result = HistoryCompaction();
+	if (!m_File.is_open())
+		return false;
+
+	std::error_code ec;
+	Result.BytesBefore = std::filesystem::file_size(m_Path, ec);
+	Result.EventsBefore = m_Events;
+	Result.BytesAfter = Result.BytesBefore;
+	Result.EventsAfter = m_Events;
+
+	// Old events go into a bucket per GM/server/zone and day or month (UTC), keyed by where the bucket starts
+	using namespace std::chrono;
+	const int64_t compacted_before = std::max(m_CompactedBefore, Now - Retention.RawSeconds);
+	struct Bucket
+	{
+		HistorySighting Sighting;
+		uint32_t Events = 0;
+	};
+	std::map<std::tuple<std::string_view, std::string_view, std::string_view, int64_t>, Bucket> buckets;
+	std::vector<HistorySighting> kept;
+	bool dropped = false;
+	ForEachLocked([&](const HistoryEntry& entry)
+		{
+			const int64_t age = Now - entry.Timestamp;
+			if (age <= Retention.RawSeconds)
+			{
+				kept.push_back({ entry.Event, entry.Timestamp, std::string(entry.GM), std::string(entry.Server), std::string(entry.Zone), entry.Count });
+				return;
+			}
+
+			if (entry.Event == HistoryEvent::Leave)
+			{
+				dropped = true;
+				return;
+			}
+
+			const sys_days day = floor<days>(sys_seconds(seconds(entry.Timestamp)));
+			const sys_days start = age <= Retention.DailySeconds ? day : sys_days(year_month_day(day).year() / year_month_day(day).month() / 1);
+			Bucket& bucket = buckets[{ entry.GM, entry.Server, entry.Zone, start.time_since_epoch().count() }];
+			if (bucket.Events++ == 0)
+			{
+				bucket.Sighting = { entry.Event, entry.Timestamp, std::string(entry.GM), std::string(entry.Server), std::string(entry.Zone), entry.Count };
+				return;
+			}
+
+			// Rolled up events carry the total and the last time in their bucket
+			bucket.Sighting.Event = HistoryEvent::Rollup;
+			bucket.Sighting.Count += entry.Count;
+			bucket.Sighting.Timestamp = std::max(bucket.Sighting.Timestamp, entry.Timestamp);
+		});
+
+	const bool merged = std::any_of(buckets.begin(), buckets.end(), [](const auto& bucket) { return bucket.second.Events > 1; });
+	if (!merged && !dropped)
+		return true;
+
+	for (auto& [key, bucket] : buckets)
+		kept.push_back(std::move(bucket.Sighting));
+	std::stable_sort(kept.begin(), kept.end(), [](const HistorySighting& a, const HistorySighting& b) { return a.Timestamp < b.Timestamp; });
+
+	// Build the new log from scratch, keeping the old state in case it can't be written
+	std::vector<std::string> old_strings;
+	std::unordered_map<std::string, uint32_t> old_ids;
+	old_strings.swap(m_Strings);
+	old_ids.swap(m_StringIds);
+	const uint32_t old_events = m_Events;
+	const int64_t old_last = m_LastTimestamp;
+	m_Events = 0;
+	m_LastTimestamp = 0;
+
+	std::vector<HistoryRecord> records;
+	records.reserve(kept.size() * 2 + 3);
+	records.push_back(MakeIndex(HistoryEvent::Header));
+
+	// So a merge later on doesn't add back sightings that are in the rollups now
+	HistoryRecord cutoff = {};
+	cutoff.Type = HistoryEvent::Compacted;
+	cutoff.Event.Timestamp = compacted_before;
+	cutoff.Checksum = Checksum(&cutoff, 1);
+	records.push_back(cutoff);
+	for (const HistorySighting& sighting : kept)
+		AddEvent(sighting, records);
+	records.push_back(MakeIndex(HistoryEvent::Footer));
+
+	std::filesystem::path temp_path = m_Path;
+	temp_path += ".tmp";
+	{
+		std::ofstream temp(temp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+		temp.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(HistoryRecord));
+		temp.flush();
+		if (!temp.fail())
+		{
+			temp.close();
+			m_File.close();
+			std::filesystem::rename(temp_path, m_Path, ec);
+		}
+		else
+		{
+			ec = std::make_error_code(std::errc::io_error);
+		}
+	}
+
+	if (ec)
+	{
+		std::filesystem::remove(temp_path, ec);
+		m_Strings.swap(old_strings);
+		m_StringIds.swap(old_ids);
+		m_Events = old_events;
+		m_LastTimestamp = old_last;
+		if (!m_File.is_open())
+			m_File.open(m_Path, std::ios::in | std::ios::out | std::ios::binary);
+		return false;
+	}
+
+	m_File.open(m_Path, std::ios::in | std::ios::out | std::ios::binary);
+	m_FooterOffset = (records.size() - 1) * sizeof(HistoryRecord);
+	m_CompactedBefore = compacted_before;
+	Result.Changed = true;
+	Result.BytesAfter = records.size() * sizeof(HistoryRecord);
+	Result.EventsAfter = m_Events;
+	return m_File.is_open();
+}
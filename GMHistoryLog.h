@@ -0,0 +1,208 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Append-only GM sighting log (MQ2GMCheck.gmlog).  Every record is a fixed 32 byte
+// slot: a header, interned strings (which may spill into the following slots),
+// events, and a footer indexing the rest.  Anything after the last record with a
+// good checksum is treated as a torn write and dropped when the log is opened.
+enum class HistoryEvent : uint16_t
+{
+	Header = 1,
+	String,
+	Sighting,
+	Leave,
+	Rollup,
+	Footer,
+	Compacted,  // (version 2) everything before its Timestamp has been rolled up, not an event
+};
+
+struct HistoryEventData
+{
+	int64_t Timestamp;
+	uint32_t GM;
+	uint32_t Server;
+	uint32_t Zone;
+	uint32_t Count;
+};
+
+struct HistoryStringData
+{
+	uint32_t Id;
+	char Text[20];
+};
+
+struct HistoryIndexData
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t Events;
+	uint32_t Strings;
+	int64_t LastTimestamp;
+};
+
+#pragma pack(push, 1)
+struct HistoryRecord
+{
+	uint32_t Checksum;
+	HistoryEvent Type;
+	uint16_t Length;
+	union
+	{
+		HistoryEventData Event;
+		HistoryStringData String;
+		HistoryIndexData Index;
+	};
+};
+#pragma pack(pop)
+static_assert(sizeof(HistoryRecord) == 32, "history records must stay 32 bytes");
+
+struct HistorySighting
+{
+	HistoryEvent Event = HistoryEvent::Sighting;
+	int64_t Timestamp = 0;
+	std::string GM;
+	std::string Server;
+	std::string Zone;
+	uint32_t Count = 1;
+};
+
+// How long sightings are kept as they are before being rolled up, older than Raw they're
+// summed per GM/server/zone/day, older than Daily per month.  Leave events are dropped
+// once they're past Raw.
+struct HistoryRetention
+{
+	int64_t RawSeconds = 0;
+	int64_t DailySeconds = 0;
+};
+
+struct HistoryCompaction
+{
+	bool Changed = false;
+	uint64_t BytesBefore = 0;
+	uint64_t BytesAfter = 0;
+	uint32_t EventsBefore = 0;
+	uint32_t EventsAfter = 0;
+};
+
+// An event with its interned ids already resolved
+struct HistoryEntry
+{
+	HistoryEvent Event;
+	int64_t Timestamp;
+	std::string_view GM;
+	std::string_view Server;
+	std::string_view Zone;
+	uint32_t Count;
+};
+
+class GMHistoryLog
+{
+public:
+	static constexpr inline uint32_t Magic = 0x4C434D47; // "GMCL"
+	// Version 1 logs (no Compacted record) are still read, and appended to as they are
+	static constexpr inline uint32_t Version = 2;
+	static constexpr inline size_t MaxStringLength = 255;
+
+	bool Open(const std::filesystem::path& Path);
+	void Close();
+	bool IsOpen() const { return m_File.is_open(); }
+	bool Recovered() const { return m_DroppedBytes > 0; }
+	uint64_t DroppedBytes() const { return m_DroppedBytes; }
+	uint32_t EventCount() const { return m_Events; }
+	// Sightings from before this have been rolled up, 0 if the log has never been compacted
+	int64_t CompactedBefore() const { return m_CompactedBefore; }
+
+	bool Append(const std::vector<HistorySighting>& Sightings);
+
+	// Appends the sightings that aren't already in the log, one is already there if the log has
+	// the same kind of event for the same GM/server/zone within Window seconds of it, or it's from
+	// before CompactedBefore() (it can only be one that was merged before and rolled up since).
+	// Sightings is sorted by time.
+	bool Merge(std::vector<HistorySighting>& Sightings, int64_t Window, uint32_t& Added);
+
+	// Reads every event in a log without opening it for writing, for logs another process may
+	// still be appending to.  A torn write at the end is just left out.
+	static bool Load(const std::filesystem::path& Path, std::vector<HistorySighting>& Sightings);
+
+	// Rewrites the log with everything older than the retention rolled up, only touching the
+	// file if something actually rolls up.  Appends wait until it's done.
+	bool Compact(int64_t Now, const HistoryRetention& Retention, HistoryCompaction& Result);
+
+	// Callback gets a const HistoryEntry& for every event, oldest first
+	template <typename Callback>
+	void ForEach(Callback&& callback);
+
+private:
+	static uint32_t Checksum(const HistoryRecord* pRecords, size_t Slots);
+	static size_t StringSlots(size_t Length) { return Length <= sizeof(HistoryStringData::Text) ? 1 : 1 + (Length - sizeof(HistoryStringData::Text) + sizeof(HistoryRecord) - 1) / sizeof(HistoryRecord); }
+	static bool ValidHeader(const std::vector<HistoryRecord>& Slots);
+	// Checks the records after the header, returns the slot of the first one that isn't good
+	static size_t Scan(const std::vector<HistoryRecord>& Slots, std::vector<std::string>& Strings, uint32_t& Events, int64_t& LastTimestamp, int64_t& CompactedBefore, bool& FoundFooter);
+	static bool ReadSlots(const std::filesystem::path& Path, std::istream& File, std::vector<HistoryRecord>& Slots);
+
+	template <typename Callback>
+	static void ForEachEvent(const std::vector<HistoryRecord>& Slots, size_t End, const std::vector<std::string>& Strings, Callback&& callback);
+	template <typename Callback>
+	void ForEachLocked(Callback&& callback);
+
+	uint32_t Intern(std::string_view Text, std::vector<HistoryRecord>& Out);
+	void AddEvent(const HistorySighting& Sighting, std::vector<HistoryRecord>& Out);
+	HistoryRecord MakeIndex(HistoryEvent Type) const;
+	bool WriteRecords(std::vector<HistoryRecord>& Records);
+	bool Reset();
+
+	std::mutex m_Mutex;
+	std::fstream m_File;
+	std::filesystem::path m_Path;
+	std::vector<std::string> m_Strings;
+	std::unordered_map<std::string, uint32_t> m_StringIds;
+	uint64_t m_FooterOffset = 0;
+	uint64_t m_DroppedBytes = 0;
+	uint32_t m_Events = 0;
+	int64_t m_LastTimestamp = 0;
+	int64_t m_CompactedBefore = 0;
+};
+
+template <typename Callback>
+void GMHistoryLog::ForEach(Callback&& callback)
+{
+	std::scoped_lock lock(m_Mutex);
+	ForEachLocked(callback);
+}
+
+template <typename Callback>
+void GMHistoryLog::ForEachLocked(Callback&& callback)
+{
+	std::vector<HistoryRecord> slots;
+	if (!m_File.is_open() || !ReadSlots(m_Path, m_File, slots))
+		return;
+
+	ForEachEvent(slots, std::min(slots.size(), static_cast<size_t>(m_FooterOffset / sizeof(HistoryRecord))), m_Strings, callback);
+}
+
+template <typename Callback>
+void GMHistoryLog::ForEachEvent(const std::vector<HistoryRecord>& Slots, size_t End, const std::vector<std::string>& Strings, Callback&& callback)
+{
+	const auto lookup = [&Strings](uint32_t Id) { return Id && Id <= Strings.size() ? std::string_view(Strings[Id - 1]) : std::string_view(); };
+	for (size_t slot = 1; slot < End; ++slot)
+	{
+		const HistoryRecord& record = Slots[slot];
+		if (record.Type == HistoryEvent::String)
+		{
+			slot += StringSlots(record.Length) - 1;
+		}
+		else if (record.Type == HistoryEvent::Sighting || record.Type == HistoryEvent::Leave || record.Type == HistoryEvent::Rollup)
+		{
+			const HistoryEntry entry = { record.Type, record.Event.Timestamp, lookup(record.Event.GM), lookup(record.Event.Server), lookup(record.Event.Zone), record.Event.Count };
+			callback(entry);
+		}
+	}
+}
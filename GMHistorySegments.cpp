@@ -0,0 +1,117 @@
+#include "GMHistorySegments.h"
+
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <thread>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+namespace HistorySegments
+{
+	static constexpr const char* Extension = ".gmseg";
+
+	uint32_t CurrentProcessID()
+	{
+#if defined(_WIN32)
+		return GetCurrentProcessId();
+#else
+		return static_cast<uint32_t>(getpid());
+#endif
+	}
+
+	bool IsProcessRunning(uint32_t ProcessID)
+	{
+#if defined(_WIN32)
+		HANDLE hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, ProcessID);
+		if (!hProcess)
+			return GetLastError() == ERROR_ACCESS_DENIED;
+
+		DWORD exit_code = 0;
+		const bool running = GetExitCodeProcess(hProcess, &exit_code) && exit_code == STILL_ACTIVE;
+		CloseHandle(hProcess);
+		return running;
+#else
+		return kill(static_cast<pid_t>(ProcessID), 0) == 0 || errno == EPERM;
+#endif
+	}
+
+	std::filesystem::path PathFor(const std::filesystem::path& LogPath, uint32_t ProcessID)
+	{
+		return LogPath.parent_path() / (LogPath.stem().string() + "." + std::to_string(ProcessID) + Extension);
+	}
+
+	std::vector<HistorySegment> Find(const std::filesystem::path& LogPath)
+	{
+		std::vector<HistorySegment> segments;
+		const std::string prefix = LogPath.stem().string() + ".";
+		std::error_code ec;
+		for (const auto& file : std::filesystem::directory_iterator(LogPath.parent_path(), ec))
+		{
+			// <stem>.<pid>.gmseg and nothing else
+			const std::filesystem::path& path = file.path();
+			const std::string stem = path.stem().string();
+			if (path.extension() != Extension || stem.size() <= prefix.size() || stem.compare(0, prefix.size(), prefix) != 0)
+				continue;
+
+			const std::string pid = stem.substr(prefix.size());
+			if (pid.size() > 10 || !std::all_of(pid.begin(), pid.end(), [](char c) { return isdigit(static_cast<unsigned char>(c)) != 0; }))
+				continue;
+
+			segments.push_back({ path, static_cast<uint32_t>(std::stoul(pid)) });
+		}
+		return segments;
+	}
+}
+
+HistoryFileLock::HistoryFileLock(const std::filesystem::path& Path, std::chrono::milliseconds Timeout)
+{
+	const auto give_up = std::chrono::steady_clock::now() + Timeout;
+	while (!TryLock(Path) && std::chrono::steady_clock::now() < give_up)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+}
+
+bool HistoryFileLock::TryLock(const std::filesystem::path& Path)
+{
+#if defined(_WIN32)
+	// No sharing at all, and the file goes away with the last handle
+	HANDLE hFile = CreateFileW(Path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+	m_hFile = hFile;
+#else
+	// flock belongs to this open, so a second lock from the same process waits too
+	m_Descriptor = open(Path.c_str(), O_CREAT | O_RDWR, 0600);
+	if (m_Descriptor < 0)
+		return false;
+	if (flock(m_Descriptor, LOCK_EX | LOCK_NB) != 0)
+	{
+		close(m_Descriptor);
+		m_Descriptor = -1;
+		return false;
+	}
+#endif
+	m_Locked = true;
+	return true;
+}
+
+HistoryFileLock::~HistoryFileLock()
+{
+#if defined(_WIN32)
+	if (m_hFile)
+		CloseHandle(m_hFile);
+#else
+	if (m_Descriptor >= 0)
+		close(m_Descriptor);
+#endif
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// Every client appends its sightings to a segment of its own next to the main log
+// (MQ2GMCheck.<pid>.gmseg, in the same format) so no two processes ever write the same
+// file.  Segments are folded into the main log while holding its lock file, on load
+// and with /gmcheck merge, and the segments of clients that are gone are then deleted.
+struct HistorySegment
+{
+	std::filesystem::path Path;
+	uint32_t ProcessID = 0;
+};
+
+namespace HistorySegments
+{
+	uint32_t CurrentProcessID();
+	bool IsProcessRunning(uint32_t ProcessID);
+	std::filesystem::path PathFor(const std::filesystem::path& LogPath, uint32_t ProcessID);
+	// Every segment belonging to the log, including this client's
+	std::vector<HistorySegment> Find(const std::filesystem::path& LogPath);
+}
+
+// Exclusive lock on a file shared by every client, the OS lets go of it if the holder dies
+class HistoryFileLock
+{
+public:
+	HistoryFileLock(const std::filesystem::path& Path, std::chrono::milliseconds Timeout);
+	~HistoryFileLock();
+	HistoryFileLock(const HistoryFileLock&) = delete;
+	HistoryFileLock& operator=(const HistoryFileLock&) = delete;
+
+	bool Locked() const { return m_Locked; }
+
+private:
+	bool TryLock(const std::filesystem::path& Path);
+
+	void* m_hFile = nullptr;
+	int m_Descriptor = -1;
+	bool m_Locked = false;
+};
@@ -0,0 +1,293 @@
+#include "GMHistoryWorker.h"
+
+#include "GMHistorySegments.h"
+
+bool HistoryWorker::Start(const std::filesystem::path& LogPath)
+{
+	if (m_Thread.joinable())
+		return true;
+
+	m_LogPath = LogPath;
+	if (!m_Segment.Open(HistorySegments::PathFor(m_LogPath, HistorySegments::CurrentProcessID())))
+		return false;
+
+	m_SegmentEvents = m_Segment.EventCount();
+	m_Stop = false;
+	m_Thread = std::thread(&HistoryWorker::Run, this);
+	return true;
+}
+
+void HistoryWorker::Stop()
+{
+	if (!m_Thread.joinable())
+		return;
+
+	{
+		std::scoped_lock lock(m_Mutex);
+		m_Stop = true;
+	}
+	m_Wake.notify_all();
+	m_Thread.join();
+	m_Segment.Close();
+
+	m_Pending.clear();
+	m_Unmerged.clear();
+	m_TrackUnmerged = false;
+	m_Job = HistoryJob::None;
+	m_Result = HistoryJobResult();
+	m_ResultReady = false;
+}
+
+void HistoryWorker::Add(HistorySighting&& Sighting)
+{
+	if (!m_Thread.joinable())
+		return;
+
+	{
+		std::scoped_lock lock(m_Mutex);
+		if (m_TrackUnmerged)
+			m_Unmerged.push_back(Sighting);
+		m_Pending.push_back(std::move(Sighting));
+	}
+	m_Wake.notify_all();
+}
+
+void HistoryWorker::RequestFlush()
+{
+	{
+		std::scoped_lock lock(m_Mutex);
+		if (m_Pending.empty())
+			return;
+		m_FlushRequested = true;
+	}
+	m_Wake.notify_all();
+}
+
+void HistoryWorker::Flush()
+{
+	std::unique_lock lock(m_Mutex);
+	if (!m_Thread.joinable())
+		return;
+
+	m_FlushRequested = true;
+	m_Wake.notify_all();
+	m_Idle.wait(lock, [this] { return m_Pending.empty() && !m_Busy; });
+}
+
+bool HistoryWorker::RequestJob(HistoryJob Job)
+{
+	if (!m_Thread.joinable() || m_Job != HistoryJob::None || m_JobRunning || m_ResultReady)
+		return false;
+
+	m_Job = Job;
+	m_Wake.notify_all();
+	return true;
+}
+
+bool HistoryWorker::Load(std::vector<HistorySighting>&& Import)
+{
+	std::scoped_lock lock(m_Mutex);
+	if (!RequestJob(HistoryJob::Load))
+		return false;
+	m_Import = std::move(Import);
+	return true;
+}
+
+bool HistoryWorker::Merge()
+{
+	std::scoped_lock lock(m_Mutex);
+	return RequestJob(HistoryJob::Merge);
+}
+
+bool HistoryWorker::Compact(int64_t Now, const HistoryRetention& Retention)
+{
+	std::scoped_lock lock(m_Mutex);
+	if (!RequestJob(HistoryJob::Compact))
+		return false;
+	m_CompactNow = Now;
+	m_Retention = Retention;
+	return true;
+}
+
+bool HistoryWorker::Busy()
+{
+	std::scoped_lock lock(m_Mutex);
+	return m_Job != HistoryJob::None || m_JobRunning || m_ResultReady;
+}
+
+bool HistoryWorker::TakeResult(HistoryJobResult& Result)
+{
+	std::scoped_lock lock(m_Mutex);
+	if (!m_ResultReady)
+		return false;
+
+	Result = std::move(m_Result);
+	m_Result = HistoryJobResult();
+	if (Result.Reindexed)
+	{
+		for (const HistorySighting& sighting : m_Unmerged)
+		{
+			if (sighting.Event != HistoryEvent::Leave)
+				Result.Index.Add(sighting.GM, sighting.Server, sighting.Zone, sighting.Timestamp, sighting.Count);
+		}
+	}
+	m_Unmerged.clear();
+	m_TrackUnmerged = false;
+	m_ResultReady = false;
+	return true;
+}
+
+size_t HistoryWorker::QueueDepth()
+{
+	std::scoped_lock lock(m_Mutex);
+	return m_Pending.size();
+}
+
+void HistoryWorker::Run()
+{
+	TraceBuffer::SetThreadName("History");
+	std::unique_lock lock(m_Mutex);
+	while (true)
+	{
+		m_Wake.wait(lock, [this] { return m_Stop || !m_Pending.empty() || m_Job != HistoryJob::None; });
+		if (m_Stop)
+		{
+			// Unloading shouldn't wait on another client's lock
+			m_Job = HistoryJob::None;
+		}
+		else if (m_Job == HistoryJob::None && !m_FlushRequested)
+		{
+			// Give sightings that arrive together a chance to share a write
+			m_Wake.wait_for(lock, CoalesceDelay, [this] { return m_Stop || m_FlushRequested || m_Job != HistoryJob::None; });
+			if (m_Stop)
+				m_Job = HistoryJob::None;
+		}
+
+		std::vector<HistorySighting> batch;
+		batch.swap(m_Pending);
+		m_FlushRequested = false;
+		m_Busy = true;
+
+		// The job reads the segment once this batch is in it, anything Added from here on
+		// isn't in what it merges and has to go into its index later
+		const HistoryJob job = m_Job;
+		std::vector<HistorySighting> import;
+		const int64_t now = m_CompactNow;
+		const HistoryRetention retention = m_Retention;
+		if (job != HistoryJob::None)
+		{
+			m_Job = HistoryJob::None;
+			m_JobRunning = true;
+			m_TrackUnmerged = true;
+			import.swap(m_Import);
+		}
+
+		lock.unlock();
+		WriteBatch(batch);
+		HistoryJobResult result;
+		if (job != HistoryJob::None)
+		{
+			result.Job = job;
+			RunJob(result, import, now, retention);
+		}
+		lock.lock();
+
+		if (job != HistoryJob::None)
+		{
+			m_Result = std::move(result);
+			m_JobRunning = false;
+			m_ResultReady = true;
+		}
+		m_Busy = false;
+		m_Idle.notify_all();
+
+		if (m_Stop && m_Pending.empty())
+			break;
+	}
+}
+
+void HistoryWorker::WriteBatch(std::vector<HistorySighting>& Batch)
+{
+	if (Batch.empty())
+		return;
+
+	TraceSpan span(m_Trace, "HistoryWrite");
+	const auto start = std::chrono::steady_clock::now();
+	m_Segment.Append(Batch);
+	Batch.clear();
+	m_SegmentEvents = m_Segment.EventCount();
+
+	const float elapsed = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	m_LastFlushMS = elapsed;
+	if (elapsed > m_MaxFlushMS)
+		m_MaxFlushMS = elapsed;
+	++m_FlushCount;
+}
+
+// The main log is shared by every client, so it's only open while its lock is held
+void HistoryWorker::RunJob(HistoryJobResult& Result, std::vector<HistorySighting>& Import, int64_t Now, const HistoryRetention& Retention)
+{
+	TraceSpan span(m_Trace, Result.Job == HistoryJob::Compact ? "HistoryCompact" : "HistoryMerge");
+	const auto start = std::chrono::steady_clock::now();
+
+	HistoryFileLock access(std::filesystem::path(m_LogPath) += ".lock", LockTimeout);
+	GMHistoryLog log;
+	if (!access.Locked() || !log.Open(m_LogPath))
+		return;
+
+	Result.DroppedBytes = log.DroppedBytes();
+	// Another client may have imported the same entries, or this one before a load that failed
+	// later on, so only what isn't in the log yet goes in
+	if (!Import.empty() && !log.Merge(Import, 0, Result.Imported))
+		return;
+
+	if (Result.Job == HistoryJob::Compact && !log.Compact(Now, Retention, Result.Compaction))
+		return;
+
+	if (Result.Job != HistoryJob::Compact || Result.Compaction.Changed)
+	{
+		if (!MergeSegments(log, Result.Merged))
+			return;
+
+		log.ForEach([&Result](const HistoryEntry& entry)
+			{
+				if (entry.Event != HistoryEvent::Leave)
+					Result.Index.Add(entry.GM, entry.Server, entry.Zone, entry.Timestamp, entry.Count);
+			});
+		Result.Reindexed = true;
+	}
+
+	Result.LogEvents = log.EventCount();
+	m_LogEvents = Result.LogEvents;
+	Result.Succeeded = true;
+	Result.ElapsedMS = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool HistoryWorker::MergeSegments(GMHistoryLog& Log, HistoryMergeResult& Result)
+{
+	// Merging a segment again only finds what's already there, so only the segments of clients
+	// that were already gone before it was read can go (one still running may add to it)
+	std::vector<HistorySighting> sightings;
+	std::vector<std::filesystem::path> finished;
+	for (const HistorySegment& segment : HistorySegments::Find(m_LogPath))
+	{
+		const bool running = segment.ProcessID == HistorySegments::CurrentProcessID() || HistorySegments::IsProcessRunning(segment.ProcessID);
+		if (!GMHistoryLog::Load(segment.Path, sightings))
+			continue;
+
+		++Result.Segments;
+		if (!running)
+			finished.push_back(segment.Path);
+	}
+
+	if (!Log.Merge(sightings, MergeWindow, Result.Added))
+		return false;
+
+	for (const std::filesystem::path& path : finished)
+	{
+		std::error_code ec;
+		if (std::filesystem::remove(path, ec))
+			++Result.Removed;
+	}
+	return true;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "GMHistoryIndex.h"
+#include "GMHistoryLog.h"
+#include "TraceBuffer.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// The sighting log's I/O thread, so the game thread never touches a file or waits on the
+// log's lock.  Sightings are batched into this client's segment (see GMHistorySegments.h),
+// and the jobs that need the main log (merging the segments into it, compacting it) run
+// here too, under its lock, and hand back a freshly built index for the caller to swap in.
+enum class HistoryJob
+{
+	None,
+	Load,      // a merge that also imports sightings from elsewhere (the old ini history)
+	Merge,
+	Compact,   // merges as well if anything rolled up, the index would be out of date otherwise
+};
+
+struct HistoryMergeResult
+{
+	uint32_t Segments = 0;
+	uint32_t Added = 0;
+	uint32_t Removed = 0;
+};
+
+struct HistoryJobResult
+{
+	HistoryJob Job = HistoryJob::None;
+	// False if the lock couldn't be had in time or the log couldn't be opened or written
+	bool Succeeded = false;
+	float ElapsedMS = 0.0f;
+	uint64_t DroppedBytes = 0;      // the log wasn't closed cleanly
+	uint32_t Imported = 0;          // what wasn't in the log already
+	uint32_t LogEvents = 0;
+	HistoryMergeResult Merged;
+	HistoryCompaction Compaction;
+	// Only filled in if Reindexed
+	bool Reindexed = false;
+	GMHistoryIndex Index;
+};
+
+class HistoryWorker
+{
+public:
+	// How long the thread waits for more sightings before writing a batch
+	static constexpr inline std::chrono::milliseconds CoalesceDelay = std::chrono::milliseconds(2000);
+	// Another client may be merging or compacting, only this thread waits for it
+	static constexpr inline std::chrono::milliseconds LockTimeout = std::chrono::seconds(5);
+	// Clients in the same zone see a GM within moments of each other, the same kind of event
+	// for the same GM/server/zone this close together is one sighting no matter how many logged it
+	static constexpr inline int64_t MergeWindow = 30;
+
+	explicit HistoryWorker(TraceBuffer& Trace) : m_Trace(Trace) {}
+	~HistoryWorker() { Stop(); }
+	HistoryWorker(const HistoryWorker&) = delete;
+	HistoryWorker& operator=(const HistoryWorker&) = delete;
+
+	// Opens this client's segment of the log at LogPath and starts the thread
+	bool Start(const std::filesystem::path& LogPath);
+	// Writes what's still queued, a job that hasn't started yet is dropped
+	void Stop();
+	bool Running() const { return m_Thread.joinable(); }
+	void Add(HistorySighting&& Sighting);
+	// Writes the queue without waiting out CoalesceDelay, returns without waiting for it
+	void RequestFlush();
+	// Blocks until everything queued so far is in the segment
+	void Flush();
+
+	// One job at a time, false if there's already one waiting or running or its result hasn't
+	// been taken
+	bool Load(std::vector<HistorySighting>&& Import);
+	bool Merge();
+	bool Compact(int64_t Now, const HistoryRetention& Retention);
+	bool Busy();
+	// The last job's result once it's done.  Anything Added after the job read the segments is
+	// added to its index here, so the index can replace the caller's as it is.
+	bool TakeResult(HistoryJobResult& Result);
+
+	size_t QueueDepth();
+	uint64_t FlushCount() const { return m_FlushCount; }
+	float LastFlushMS() const { return m_LastFlushMS; }
+	float MaxFlushMS() const { return m_MaxFlushMS; }
+	// As of the last job
+	uint32_t LogEventCount() const { return m_LogEvents; }
+	uint32_t SegmentEventCount() const { return m_SegmentEvents; }
+
+private:
+	void Run();
+	void WriteBatch(std::vector<HistorySighting>& Batch);
+	bool RequestJob(HistoryJob Job);
+	void RunJob(HistoryJobResult& Result, std::vector<HistorySighting>& Import, int64_t Now, const HistoryRetention& Retention);
+	bool MergeSegments(GMHistoryLog& Log, HistoryMergeResult& Result);
+
+	TraceBuffer& m_Trace;
+	std::filesystem::path m_LogPath;
+	GMHistoryLog m_Segment;
+
+	std::vector<HistorySighting> m_Pending;
+	// What was Added after the running job's last write to the segment
+	std::vector<HistorySighting> m_Unmerged;
+	bool m_TrackUnmerged = false;
+
+	HistoryJob m_Job = HistoryJob::None;
+	std::vector<HistorySighting> m_Import;
+	int64_t m_CompactNow = 0;
+	HistoryRetention m_Retention;
+	HistoryJobResult m_Result;
+	bool m_JobRunning = false;
+	bool m_ResultReady = false;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_Wake;
+	std::condition_variable m_Idle;
+	std::thread m_Thread;
+	bool m_Stop = false;
+	bool m_FlushRequested = false;
+	bool m_Busy = false;
+
+	std::atomic<uint64_t> m_FlushCount = 0;
+	std::atomic<float> m_LastFlushMS = 0.0f;
+	std::atomic<float> m_MaxFlushMS = 0.0f;
+	std::atomic<uint32_t> m_LogEvents = 0;
+	std::atomic<uint32_t> m_SegmentEvents = 0;
+};
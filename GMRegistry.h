@@ -0,0 +1,190 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// The GMs currently in zone.  Entries live in a flat slot array indexed by SpawnID
+// and by a case-folded hash of the name, with a separate name-sorted order so the
+// Names member and reminders list them the same way every time.  Two names with the
+// same hash are both kept, lookups by name compare the name itself.
+struct GMEntry
+{
+	std::string Name;
+	uint64_t NameHash = 0;
+	uint32_t SpawnID = 0;
+	const void* pSpawn = nullptr;
+	bool Alerted = false;
+	// The tracker's clock (its time_since_epoch) when the GM was added
+	std::chrono::nanoseconds FirstSeen{ 0 };
+};
+
+class GMRegistry
+{
+public:
+	static uint64_t HashName(std::string_view Name);
+	static bool NameEquals(std::string_view A, std::string_view B);
+
+	// Returns the entry and whether it is a new GM (a known name only gets its spawn updated)
+	std::pair<GMEntry*, bool> Add(uint32_t SpawnID, std::string_view Name, const void* pSpawn, std::chrono::nanoseconds FirstSeen);
+	bool Remove(uint32_t SpawnID);
+	void Clear();
+
+	GMEntry* FindBySpawnID(uint32_t SpawnID);
+	GMEntry* FindByName(std::string_view Name);
+	// Either one if two names share the hash
+	GMEntry* FindByNameHash(uint64_t NameHash);
+	void SetAlerted(GMEntry& Entry);
+
+	bool Empty() const { return m_Order.empty(); }
+	uint32_t Count() const { return static_cast<uint32_t>(m_Order.size()); }
+	uint32_t PendingAlerts() const { return m_PendingAlerts; }
+	// Bumped by anything that changes an entry, so callers can tell when their copy is stale
+	uint64_t Changes() const { return m_Changes; }
+
+	// Callback gets a GMEntry& for every GM, sorted by name
+	template <typename Callback>
+	void ForEach(Callback&& callback)
+	{
+		for (const uint32_t slot : m_Order)
+			callback(m_Slots[slot]);
+	}
+
+private:
+	std::vector<GMEntry> m_Slots;
+	std::vector<uint32_t> m_FreeSlots;
+	std::vector<uint32_t> m_Order;
+	std::unordered_map<uint32_t, uint32_t> m_BySpawnID;
+	std::unordered_multimap<uint64_t, uint32_t> m_ByName;
+	uint32_t m_PendingAlerts = 0;
+	uint64_t m_Changes = 0;
+};
+
+inline uint64_t GMRegistry::HashName(std::string_view Name)
+{
+	// FNV-1a over the lower cased name
+	uint64_t hash = 14695981039346656037ull;
+	for (const char c : Name)
+	{
+		hash ^= static_cast<uint8_t>(tolower(static_cast<unsigned char>(c)));
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+inline bool GMRegistry::NameEquals(std::string_view A, std::string_view B)
+{
+	return A.size() == B.size() && std::equal(A.begin(), A.end(), B.begin(),
+		[](char a, char b) { return tolower(static_cast<unsigned char>(a)) == tolower(static_cast<unsigned char>(b)); });
+}
+
+inline std::pair<GMEntry*, bool> GMRegistry::Add(uint32_t SpawnID, std::string_view Name, const void* pSpawn, std::chrono::nanoseconds FirstSeen)
+{
+	if (GMEntry* pEntry = FindBySpawnID(SpawnID))
+		return { pEntry, false };
+
+	if (GMEntry* pEntry = FindByName(Name))
+	{
+		m_BySpawnID.erase(pEntry->SpawnID);
+		pEntry->SpawnID = SpawnID;
+		pEntry->pSpawn = pSpawn;
+		m_BySpawnID[SpawnID] = static_cast<uint32_t>(pEntry - m_Slots.data());
+		++m_Changes;
+		return { pEntry, false };
+	}
+
+	uint32_t slot;
+	if (m_FreeSlots.empty())
+	{
+		slot = static_cast<uint32_t>(m_Slots.size());
+		m_Slots.emplace_back();
+	}
+	else
+	{
+		slot = m_FreeSlots.back();
+		m_FreeSlots.pop_back();
+	}
+
+	GMEntry& entry = m_Slots[slot];
+	entry.Name = Name;
+	entry.NameHash = HashName(Name);
+	entry.SpawnID = SpawnID;
+	entry.pSpawn = pSpawn;
+	entry.Alerted = false;
+	entry.FirstSeen = FirstSeen;
+
+	m_BySpawnID[SpawnID] = slot;
+	m_ByName.emplace(entry.NameHash, slot);
+	m_Order.insert(std::upper_bound(m_Order.begin(), m_Order.end(), slot,
+		[this](uint32_t a, uint32_t b) { return m_Slots[a].Name < m_Slots[b].Name; }), slot);
+	++m_PendingAlerts;
+	++m_Changes;
+	return { &entry, true };
+}
+
+inline bool GMRegistry::Remove(uint32_t SpawnID)
+{
+	const auto it = m_BySpawnID.find(SpawnID);
+	if (it == m_BySpawnID.end())
+		return false;
+
+	const uint32_t slot = it->second;
+	GMEntry& entry = m_Slots[slot];
+	if (!entry.Alerted)
+		--m_PendingAlerts;
+
+	m_BySpawnID.erase(it);
+	const auto [first, last] = m_ByName.equal_range(entry.NameHash);
+	m_ByName.erase(std::find_if(first, last, [slot](const auto& named) { return named.second == slot; }));
+	m_Order.erase(std::find(m_Order.begin(), m_Order.end(), slot));
+	entry = GMEntry();
+	m_FreeSlots.push_back(slot);
+	++m_Changes;
+	return true;
+}
+
+inline void GMRegistry::Clear()
+{
+	m_Slots.clear();
+	m_FreeSlots.clear();
+	m_Order.clear();
+	m_BySpawnID.clear();
+	m_ByName.clear();
+	m_PendingAlerts = 0;
+	++m_Changes;
+}
+
+inline GMEntry* GMRegistry::FindBySpawnID(uint32_t SpawnID)
+{
+	const auto it = m_BySpawnID.find(SpawnID);
+	return it == m_BySpawnID.end() ? nullptr : &m_Slots[it->second];
+}
+
+inline GMEntry* GMRegistry::FindByName(std::string_view Name)
+{
+	const auto [first, last] = m_ByName.equal_range(HashName(Name));
+	const auto it = std::find_if(first, last, [this, Name](const auto& named) { return NameEquals(m_Slots[named.second].Name, Name); });
+	return it == last ? nullptr : &m_Slots[it->second];
+}
+
+inline GMEntry* GMRegistry::FindByNameHash(uint64_t NameHash)
+{
+	const auto it = m_ByName.find(NameHash);
+	return it == m_ByName.end() ? nullptr : &m_Slots[it->second];
+}
+
+inline void GMRegistry::SetAlerted(GMEntry& Entry)
+{
+	if (!Entry.Alerted)
+	{
+		Entry.Alerted = true;
+		--m_PendingAlerts;
+		++m_Changes;
+	}
+}
@@ -0,0 +1,288 @@
+#include "GMSharedState.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <thread>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool GMSharedState::Open(const char* Name)
+{
+	Close();
+
+#if defined(_WIN32)
+	// Local\ keeps it to this login session, which is where the other clients are
+	m_Name = std::string("Local\\") + Name;
+	m_PID = GetCurrentProcessId();
+	HANDLE hMapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, static_cast<DWORD>(sizeof(Segment)), m_Name.c_str());
+	if (!hMapping)
+		return false;
+
+	m_pSegment = static_cast<Segment*>(MapViewOfFile(hMapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(Segment)));
+	if (!m_pSegment)
+	{
+		CloseHandle(hMapping);
+		return false;
+	}
+	m_hMapping = hMapping;
+#else
+	m_Name = std::string("/") + Name;
+	m_PID = static_cast<uint32_t>(getpid());
+	m_Descriptor = shm_open(m_Name.c_str(), O_CREAT | O_RDWR, 0600);
+	if (m_Descriptor < 0)
+		return false;
+
+	// New segments come back zero filled, which is an empty table
+	struct stat info = {};
+	if (fstat(m_Descriptor, &info) != 0 || (info.st_size < static_cast<off_t>(sizeof(Segment)) && ftruncate(m_Descriptor, sizeof(Segment)) != 0))
+	{
+		Close();
+		return false;
+	}
+
+	void* pMapped = mmap(nullptr, sizeof(Segment), PROT_READ | PROT_WRITE, MAP_SHARED, m_Descriptor, 0);
+	if (pMapped == MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+	m_pSegment = static_cast<Segment*>(pMapped);
+#endif
+
+	// Whoever gets here first stamps it: the layout goes in first and the magic last, so a
+	// client that sees the magic sees the layout with it.  One that opens in between waits
+	// for the magic, anything stamped by a different layout is left alone.
+	uint32_t magic = 0;
+	if (m_pSegment->Magic.compare_exchange_strong(magic, Stamping, std::memory_order_acquire))
+	{
+		m_pSegment->Version = Version;
+		m_pSegment->Slots = SlotCount;
+		m_pSegment->Magic.store(Magic, std::memory_order_release);
+		return true;
+	}
+
+	// Only a client that died mid stamp leaves it there for good
+	const auto give_up = std::chrono::steady_clock::now() + StampWait;
+	while (magic == Stamping && std::chrono::steady_clock::now() < give_up)
+	{
+		std::this_thread::yield();
+		magic = m_pSegment->Magic.load(std::memory_order_acquire);
+	}
+
+	if (magic != Magic || m_pSegment->Version != Version || m_pSegment->Slots != SlotCount)
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void GMSharedState::Close()
+{
+	if (m_pSegment)
+		ReleaseAll();
+
+#if defined(_WIN32)
+	if (m_pSegment)
+		UnmapViewOfFile(m_pSegment);
+	if (m_hMapping)
+		CloseHandle(m_hMapping);
+#else
+	if (m_pSegment)
+		munmap(m_pSegment, sizeof(Segment));
+	if (m_Descriptor >= 0)
+		close(m_Descriptor);
+#endif
+
+	m_pSegment = nullptr;
+	m_hMapping = nullptr;
+	m_Descriptor = -1;
+}
+
+int64_t GMSharedState::Now()
+{
+	return static_cast<int64_t>(time(nullptr));
+}
+
+bool GMSharedState::Matches(const Entry& entry, std::string_view Server, uint32_t ZoneID, std::string_view GM)
+{
+	return entry.ZoneID == ZoneID
+		&& Server.substr(0, sizeof(entry.Server) - 1) == std::string_view(entry.Server, strnlen(entry.Server, sizeof(entry.Server)))
+		&& GM.substr(0, sizeof(entry.GM) - 1) == std::string_view(entry.GM, strnlen(entry.GM, sizeof(entry.GM)));
+}
+
+bool GMSharedState::Read(const Slot& slot, Entry& entry, uint32_t& Sequence)
+{
+	uint64_t words[EntryWords];
+	for (int attempt = 0; attempt < 1000; ++attempt)
+	{
+		Sequence = slot.Sequence.load(std::memory_order_acquire);
+		if (Sequence & 1)
+			continue;
+
+		for (size_t i = 0; i < EntryWords; ++i)
+			words[i] = slot.Words[i].load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.Sequence.load(std::memory_order_relaxed) == Sequence)
+		{
+			memcpy(&entry, words, sizeof(entry));
+			entry.Server[sizeof(entry.Server) - 1] = '\0';
+			entry.GM[sizeof(entry.GM) - 1] = '\0';
+			return true;
+		}
+	}
+	return false;
+}
+
+// Only succeeds if nobody has written the slot since it was read at Sequence, a null entry clears it
+bool GMSharedState::TryWrite(Slot& slot, uint32_t Sequence, const Entry* pEntry)
+{
+	if (!slot.Sequence.compare_exchange_strong(Sequence, Sequence + 1, std::memory_order_acquire))
+		return false;
+	std::atomic_thread_fence(std::memory_order_release);
+
+	uint64_t words[EntryWords] = {};
+	if (pEntry)
+		memcpy(words, pEntry, sizeof(Entry));
+	for (size_t i = 0; i < EntryWords; ++i)
+		slot.Words[i].store(words[i], std::memory_order_relaxed);
+
+	slot.Sequence.store(Sequence + 2, std::memory_order_release);
+	return true;
+}
+
+bool GMSharedState::Claim(std::string_view Server, uint32_t ZoneID, std::string_view GM, uint32_t SpawnID, int64_t Now)
+{
+	if (!m_pSegment || GM.empty())
+		return true;
+
+	// Full pass, slots are freed in any order so there's no probe sequence to stop early on
+	Slot* pOwn = nullptr;
+	Slot* pFree = nullptr;
+	Entry own = {};
+	uint32_t own_sequence = 0;
+	uint32_t free_sequence = 0;
+	uint32_t other_pid = 0;
+	for (Slot& slot : m_pSegment->Table)
+	{
+		Entry entry;
+		uint32_t sequence;
+		if (!Read(slot, entry, sequence))
+			continue;
+
+		if (entry.GM[0] && Matches(entry, Server, ZoneID, GM))
+		{
+			if (entry.OwnerPID == m_PID || !IsLive(entry, Now))
+			{
+				// Ours to refresh, or stale and ours to take over
+				if (!pOwn)
+				{
+					pOwn = &slot;
+					own = entry;
+					own_sequence = sequence;
+				}
+			}
+			else if (!other_pid || entry.OwnerPID < other_pid)
+			{
+				other_pid = entry.OwnerPID;
+			}
+		}
+		else if (!pFree && !IsLive(entry, Now))
+		{
+			pFree = &slot;
+			free_sequence = sequence;
+		}
+	}
+
+	// Two clients that claimed at the same time end up with a slot each, the lower pid keeps it
+	if (other_pid && (!pOwn || other_pid < m_PID))
+	{
+		if (pOwn && own.OwnerPID == m_PID)
+			TryWrite(*pOwn, own_sequence, nullptr);
+		return false;
+	}
+
+	if (pOwn)
+	{
+		own.OwnerPID = m_PID;
+		own.SpawnID = SpawnID;
+		own.Updated = Now;
+		return TryWrite(*pOwn, own_sequence, &own) || Owns(Server, ZoneID, GM);
+	}
+
+	// Table is full, every client tracks it on its own like it did before sharing
+	if (!pFree)
+		return true;
+
+	Entry entry = {};
+	memcpy(entry.Server, Server.data(), std::min(Server.size(), sizeof(entry.Server) - 1));
+	memcpy(entry.GM, GM.data(), std::min(GM.size(), sizeof(entry.GM) - 1));
+	entry.ZoneID = ZoneID;
+	entry.SpawnID = SpawnID;
+	entry.FirstSeen = Now;
+	entry.Updated = Now;
+	entry.OwnerPID = m_PID;
+	// Someone else may have taken the slot or claimed the GM into another one meanwhile
+	TryWrite(*pFree, free_sequence, &entry);
+	return Owns(Server, ZoneID, GM);
+}
+
+bool GMSharedState::Owns(std::string_view Server, uint32_t ZoneID, std::string_view GM) const
+{
+	if (!m_pSegment)
+		return true;
+
+	bool owned = false;
+	bool yielded = false;
+	ForEach(Now(), [&](const Entry& entry)
+		{
+			if (Matches(entry, Server, ZoneID, GM))
+			{
+				if (entry.OwnerPID == m_PID)
+					owned = true;
+				else if (entry.OwnerPID < m_PID)
+					yielded = true;
+			}
+		});
+	return owned && !yielded;
+}
+
+void GMSharedState::Release(std::string_view Server, uint32_t ZoneID, std::string_view GM)
+{
+	if (!m_pSegment)
+		return;
+
+	for (Slot& slot : m_pSegment->Table)
+	{
+		Entry entry;
+		uint32_t sequence;
+		if (Read(slot, entry, sequence) && entry.GM[0] && entry.OwnerPID == m_PID && Matches(entry, Server, ZoneID, GM))
+			TryWrite(slot, sequence, nullptr);
+	}
+}
+
+void GMSharedState::ReleaseAll()
+{
+	if (!m_pSegment)
+		return;
+
+	for (Slot& slot : m_pSegment->Table)
+	{
+		Entry entry;
+		uint32_t sequence;
+		if (Read(slot, entry, sequence) && entry.GM[0] && entry.OwnerPID == m_PID)
+			TryWrite(slot, sequence, nullptr);
+	}
+}
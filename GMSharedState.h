@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Opt-in table of the GMs every client on this machine is tracking, kept in a named
+// shared memory segment (a file mapping on Windows, shm_open everywhere else).  Each
+// slot is a seqlock, so readers never block and never see a half written entry.  The
+// first client to claim a GM owns it and is the only one that records the sighting
+// and plays its sounds.  Owners refresh their slots every second, and once a slot
+// goes stale (the owner left, zoned or crashed) any other client still seeing that
+// GM takes it over.
+class GMSharedState
+{
+public:
+	static constexpr inline uint32_t Magic = 0x53434D47; // "GMCS"
+	static constexpr inline uint32_t Version = 1;
+	static constexpr inline uint32_t SlotCount = 256;
+	static constexpr inline int64_t StaleSeconds = 5;
+
+	struct Entry
+	{
+		char Server[32];
+		char GM[64];
+		uint32_t ZoneID;
+		uint32_t SpawnID;
+		int64_t FirstSeen;
+		int64_t Updated;
+		uint32_t OwnerPID;
+		uint32_t Reserved;
+	};
+
+	GMSharedState() = default;
+	~GMSharedState() { Close(); }
+	GMSharedState(const GMSharedState&) = delete;
+	GMSharedState& operator=(const GMSharedState&) = delete;
+
+	bool Open(const char* Name);
+	void Close();
+	bool IsOpen() const { return m_pSegment != nullptr; }
+	uint32_t ProcessID() const { return m_PID; }
+
+	// Claims the GM unless another live client already has it, true if this client owns it
+	// afterwards.  Calling it again for a GM this client owns just refreshes the slot.
+	bool Claim(std::string_view Server, uint32_t ZoneID, std::string_view GM, uint32_t SpawnID, int64_t Now);
+	bool Owns(std::string_view Server, uint32_t ZoneID, std::string_view GM) const;
+	void Release(std::string_view Server, uint32_t ZoneID, std::string_view GM);
+	// Everything this client owns, e.g. when zoning
+	void ReleaseAll();
+
+	// Callback gets a const Entry& for every slot that's in use and not stale
+	template <typename Callback>
+	void ForEach(int64_t Now, Callback&& callback) const;
+
+private:
+	// In Magic while the first client is still writing the layout
+	static constexpr inline uint32_t Stamping = ~Magic;
+	static constexpr inline std::chrono::milliseconds StampWait = std::chrono::milliseconds(100);
+	static constexpr inline size_t EntryWords = sizeof(Entry) / sizeof(uint64_t);
+	static_assert(sizeof(Entry) % sizeof(uint64_t) == 0, "shared entries must be whole words");
+	static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory needs address free atomics");
+
+	// Sequence is odd while a writer is in the slot
+	struct Slot
+	{
+		std::atomic<uint32_t> Sequence;
+		uint32_t Reserved;
+		std::atomic<uint64_t> Words[EntryWords];
+	};
+
+	struct Segment
+	{
+		std::atomic<uint32_t> Magic;
+		uint32_t Version;
+		uint32_t Slots;
+		uint32_t Reserved;
+		Slot Table[SlotCount];
+	};
+
+	static bool Matches(const Entry& entry, std::string_view Server, uint32_t ZoneID, std::string_view GM);
+	static bool IsLive(const Entry& entry, int64_t Now) { return entry.GM[0] && Now - entry.Updated <= StaleSeconds; }
+	static bool Read(const Slot& slot, Entry& entry, uint32_t& Sequence);
+	static bool TryWrite(Slot& slot, uint32_t Sequence, const Entry* pEntry);
+	static int64_t Now();
+
+	Segment* m_pSegment = nullptr;
+	void* m_hMapping = nullptr;
+	int m_Descriptor = -1;
+	std::string m_Name;
+	uint32_t m_PID = 0;
+};
+
+template <typename Callback>
+void GMSharedState::ForEach(int64_t Now, Callback&& callback) const
+{
+	if (!m_pSegment)
+		return;
+
+	for (const Slot& slot : m_pSegment->Table)
+	{
+		Entry entry;
+		uint32_t sequence;
+		if (Read(slot, entry, sequence) && IsLive(entry, Now))
+			callback(static_cast<const Entry&>(entry));
+	}
+}
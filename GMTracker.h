@@ -0,0 +1,312 @@
+#pragma once
+
+#include "GMCheckCore.h"
+#include "GMRegistry.h"
+#include "PulseScheduler.h"
+#include "ReminderSchedule.h"
+#include "TraceBuffer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+// The settings the tracker goes by, filled in from the settings snapshot by the plugin
+struct TrackerOptions
+{
+	bool Enabled = true;
+	bool Quiet = false;
+	std::chrono::seconds ReminderInterval = std::chrono::seconds(30);
+	uint32_t ReminderBackoff = 2;
+	std::chrono::seconds ReminderMax = std::chrono::seconds(600);
+	std::chrono::seconds ReminderZoneDelay = std::chrono::seconds(10);
+};
+
+// Adds a GM to the list in szBuffer (truncating if it doesn't fit) without going through a std::string
+inline void AppendGMName(char* szBuffer, size_t BufferSize, size_t& Length, const char* szFirst, const char* szSeparator, const char* szName)
+{
+	for (const char* szPart : { Length ? szSeparator : szFirst, szName })
+	{
+		const size_t count = std::min(strlen(szPart), BufferSize - 1 - Length);
+		memcpy(szBuffer + Length, szPart, count);
+		Length += count;
+	}
+	szBuffer[Length] = '\0';
+}
+
+// The GMs in zone and everything the pulse does with them: verifying the known ones,
+// the occasional full audit, enter alerts and reminders.  The game only comes in
+// through ISpawnSource / IAlertSink and the time only through the arguments, so the
+// tests and benchmarks run it against a stand-in spawn list and clock.
+template <typename Clock>
+class GMTracker
+{
+public:
+	using clock = Clock;
+	using time_point = typename Clock::time_point;
+
+	// Known GM spawns are re-checked often, the whole spawn list only rarely
+	static constexpr inline std::chrono::seconds VerifyInterval = std::chrono::seconds(1);
+	static constexpr inline std::chrono::seconds AuditInterval = std::chrono::seconds(300);
+	// Same as MQ's MAX_STRING, the most of a reminder that's ever printed
+	static constexpr inline size_t MaxReminderNames = 2048;
+
+	GMTracker(ISpawnSource& SpawnSource, IAlertSink& AlertSink, TraceBuffer& Trace, const TrackerOptions& Options, time_point Now);
+
+	// Takes effect on the reminders already waiting
+	void Configure(const TrackerOptions& Options);
+	const TrackerOptions& Options() const { return m_Options; }
+
+	// True (and counted as skipped) if the pulse has nothing to do, which is most of them
+	bool Idle(time_point Now);
+	void Pulse(time_point Now);
+
+	uint32_t CheckAlerts(time_point Now);
+	void VerifyGMs();
+	void Audit();
+	bool AlertPending() const;
+	uint32_t GMCount() const { return GMs.Count(); }
+	bool IsTracked(uint32_t SpawnID) { return GMs.FindBySpawnID(SpawnID) != nullptr; }
+	void AddGM(const SpawnRef& Spawn);
+	void RemoveGM(uint32_t SpawnID);
+	void Clear();
+	// After zoning, reminders wait out ReminderZoneDelay and the new zone is audited right away
+	void Restart(time_point Now);
+
+	// Seconds until the GM's next reminder, -1 if there isn't one coming
+	int ReminderIn(uint64_t NameHash, time_point Now) const;
+	uint64_t RemindersFired() const { return m_Reminders.Fired(); }
+
+	GMRegistry GMs;
+	uint32_t AuditCount = 0;
+	uint32_t AuditDriftCount = 0;
+	uint64_t ActivePulses = 0;
+	uint64_t SkippedPulses = 0;
+
+private:
+	enum class PulseTimer { Verify, Audit, Reminder, Count };
+
+	void ScheduleReminder();
+
+	ISpawnSource& m_Spawns;
+	IAlertSink& m_Alerts;
+	TraceBuffer& m_Trace;
+	TrackerOptions m_Options;
+	PulseScheduler<Clock, PulseTimer> m_Timers;
+	// Per GM, keyed by GMEntry::NameHash, the reminder timer is kept at its soonest deadline
+	ReminderSchedule<Clock> m_Reminders;
+	// Reused by every pulse so a quiet one doesn't allocate
+	std::vector<SpawnRef> m_AuditFound;
+	std::vector<uint32_t> m_StaleSpawnIDs;
+	char m_ReminderNames[MaxReminderNames] = { 0 };
+};
+
+template <typename Clock>
+GMTracker<Clock>::GMTracker(ISpawnSource& SpawnSource, IAlertSink& AlertSink, TraceBuffer& Trace, const TrackerOptions& Options, time_point Now)
+	: m_Spawns(SpawnSource), m_Alerts(AlertSink), m_Trace(Trace), m_Options(Options)
+{
+	m_Timers.Schedule(PulseTimer::Verify, Now + VerifyInterval);
+	m_Timers.Schedule(PulseTimer::Audit, Now + AuditInterval);
+	m_Reminders.Hold(Now + m_Options.ReminderZoneDelay);
+	ScheduleReminder();
+	m_AuditFound.reserve(64);
+	m_StaleSpawnIDs.reserve(64);
+}
+
+template <typename Clock>
+void GMTracker<Clock>::Configure(const TrackerOptions& Options)
+{
+	m_Options = Options;
+	ScheduleReminder();
+}
+
+// The reminder timer follows whichever GM is due first
+template <typename Clock>
+void GMTracker<Clock>::ScheduleReminder()
+{
+	typename ReminderSchedule<Clock>::Config config;
+	config.First = m_Options.ReminderInterval;
+	config.Backoff = m_Options.ReminderBackoff;
+	config.Max = m_Options.ReminderMax;
+	m_Reminders.Configure(config);
+
+	const time_point due = m_Reminders.NextDue();
+	if (due != time_point::max())
+		m_Timers.Schedule(PulseTimer::Reminder, due);
+	else
+		m_Timers.Cancel(PulseTimer::Reminder);
+}
+
+template <typename Clock>
+bool GMTracker<Clock>::Idle(time_point Now)
+{
+	if (AlertPending() || m_Timers.AnyDue(Now))
+		return false;
+	++SkippedPulses;
+	return true;
+}
+
+template <typename Clock>
+void GMTracker<Clock>::Pulse(time_point Now)
+{
+	++ActivePulses;
+	const bool alert_pending = AlertPending();
+
+	if (m_Timers.TakeDue(PulseTimer::Audit, Now))
+	{
+		m_Timers.Schedule(PulseTimer::Audit, Now + AuditInterval);
+		m_Timers.Schedule(PulseTimer::Verify, Now + VerifyInterval);
+		Audit();
+	}
+	else if (m_Timers.TakeDue(PulseTimer::Verify, Now))
+	{
+		m_Timers.Schedule(PulseTimer::Verify, Now + VerifyInterval);
+		VerifyGMs();
+	}
+
+	// A reminder that comes due with an alert waiting is left due for the next pulse, taking it
+	// now would move the GM on to its next interval without the reminder being given
+	if (alert_pending)
+		CheckAlerts(Now);
+	else if (m_Timers.TakeDue(PulseTimer::Reminder, Now))
+	{
+		// Only the GMs that are due, each moves on to its next (longer) interval
+		size_t length = 0;
+		m_ReminderNames[0] = '\0';
+		m_Reminders.TakeDue(Now, [this, &length](uint64_t NameHash)
+			{
+				if (const GMEntry* pEntry = GMs.FindByNameHash(NameHash))
+					AppendGMName(m_ReminderNames, sizeof(m_ReminderNames), length, "\ag", "\ax\am,\ax \ag", pEntry->Name.c_str());
+			});
+		ScheduleReminder();
+		if (length && !m_Options.Quiet && m_Options.Enabled)
+			m_Alerts.Alert(m_ReminderNames, GMStatuses::Reminder);
+	}
+}
+
+// Alerts for any GMs that haven't been flagged yet, returns how many were alerted
+template <typename Clock>
+uint32_t GMTracker<Clock>::CheckAlerts(time_point Now)
+{
+	TraceSpan span(m_Trace, "CheckAlerts");
+	uint32_t alerted = 0;
+	if (AlertPending())
+	{
+		GMs.ForEach([this, &alerted, Now](GMEntry& entry)
+			{
+				if (!entry.Alerted)
+				{
+					GMs.SetAlerted(entry);
+					++alerted;
+					m_Reminders.Add(entry.NameHash, Now);
+					m_Alerts.Alert(entry.Name.c_str(), GMStatuses::Enter);
+				}
+			});
+		ScheduleReminder();
+	}
+	return alerted;
+}
+
+// Cheap check of the spawns we already know are GMs -- drops any that went away or lost the GM flag
+template <typename Clock>
+void GMTracker<Clock>::VerifyGMs()
+{
+	TraceSpan span(m_Trace, "VerifyGMs");
+	m_StaleSpawnIDs.clear();
+	GMs.ForEach([this](const GMEntry& entry)
+		{
+			SpawnRef spawn;
+			if (!m_Spawns.FindGM(entry.SpawnID, spawn) || spawn.Handle != entry.pSpawn)
+				m_StaleSpawnIDs.push_back(entry.SpawnID);
+		});
+
+	for (const uint32_t SpawnID : m_StaleSpawnIDs)
+		RemoveGM(SpawnID);
+}
+
+// Full spawn list scan to catch anything the spawn callbacks missed (e.g. a GM flag turning on)
+template <typename Clock>
+void GMTracker<Clock>::Audit()
+{
+	TraceSpan span(m_Trace, "Audit");
+	++AuditCount;
+
+	// Sorted by SpawnID instead of a map so the buffers can be reused
+	m_AuditFound.clear();
+	m_Spawns.ForEachGM([this](const SpawnRef& spawn) { m_AuditFound.push_back(spawn); });
+	const auto bySpawnID = [](const SpawnRef& a, const SpawnRef& b) { return a.SpawnID < b.SpawnID; };
+	std::sort(m_AuditFound.begin(), m_AuditFound.end(), bySpawnID);
+
+	m_StaleSpawnIDs.clear();
+	GMs.ForEach([this, &bySpawnID](const GMEntry& entry)
+		{
+			if (!std::binary_search(m_AuditFound.begin(), m_AuditFound.end(), SpawnRef{ entry.SpawnID }, bySpawnID))
+				m_StaleSpawnIDs.push_back(entry.SpawnID);
+		});
+
+	bool drift = !m_StaleSpawnIDs.empty();
+	for (const uint32_t SpawnID : m_StaleSpawnIDs)
+		RemoveGM(SpawnID);
+
+	for (const SpawnRef& spawn : m_AuditFound)
+	{
+		if (!IsTracked(spawn.SpawnID))
+		{
+			drift = true;
+			AddGM(spawn);
+		}
+	}
+
+	if (drift)
+		++AuditDriftCount;
+}
+
+template <typename Clock>
+bool GMTracker<Clock>::AlertPending() const
+{
+	return GMs.PendingAlerts() && !m_Options.Quiet && m_Options.Enabled;
+}
+
+template <typename Clock>
+void GMTracker<Clock>::AddGM(const SpawnRef& Spawn)
+{
+	TraceSpan span(m_Trace, "AddGM");
+	if (GMs.Add(Spawn.SpawnID, Spawn.Name, Spawn.Handle, Clock::now().time_since_epoch()).second)
+		m_Alerts.Sighted(Spawn);
+}
+
+template <typename Clock>
+void GMTracker<Clock>::RemoveGM(uint32_t SpawnID)
+{
+	if (const GMEntry* pEntry = GMs.FindBySpawnID(SpawnID))
+	{
+		m_Reminders.Remove(pEntry->NameHash);
+		m_Alerts.Removed(SpawnRef{ pEntry->SpawnID, pEntry->Name.c_str(), pEntry->pSpawn });
+		GMs.Remove(SpawnID);
+	}
+}
+
+template <typename Clock>
+void GMTracker<Clock>::Clear()
+{
+	GMs.Clear();
+	m_Reminders.Clear();
+	ScheduleReminder();
+}
+
+template <typename Clock>
+void GMTracker<Clock>::Restart(time_point Now)
+{
+	m_Reminders.Hold(Now + m_Options.ReminderZoneDelay);
+	m_Timers.Schedule(PulseTimer::Audit, Now);
+	ScheduleReminder();
+}
+
+template <typename Clock>
+int GMTracker<Clock>::ReminderIn(uint64_t NameHash, time_point Now) const
+{
+	const time_point due = m_Reminders.Due(NameHash);
+	if (due == time_point::max())
+		return -1;
+	return static_cast<int>(std::max<long long>(std::chrono::duration_cast<std::chrono::seconds>(due - Now).count(), 0));
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Fixed size latency histogram that can be recorded into from any thread.  Buckets
+// are quarter steps of each power of two nanoseconds, so a percentile is never more
+// than 25% above the real value, and the whole thing is a couple of KB.
+class LatencyHistogram
+{
+public:
+	static constexpr inline size_t SubBuckets = 4;
+	static constexpr inline size_t Buckets = 64 * SubBuckets;
+
+	void Record(uint64_t Nanoseconds)
+	{
+		m_Buckets[BucketFor(Nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+		m_Count.fetch_add(1, std::memory_order_relaxed);
+		m_Total.fetch_add(Nanoseconds, std::memory_order_relaxed);
+		uint64_t max = m_Max.load(std::memory_order_relaxed);
+		while (Nanoseconds > max && !m_Max.compare_exchange_weak(max, Nanoseconds, std::memory_order_relaxed)) {}
+	}
+
+	uint64_t Count() const { return m_Count.load(std::memory_order_relaxed); }
+	uint64_t Max() const { return m_Max.load(std::memory_order_relaxed); }
+	uint64_t Mean() const { const uint64_t count = Count(); return count ? m_Total.load(std::memory_order_relaxed) / count : 0; }
+
+	// Upper edge of the bucket holding the given percentile (0-100), in nanoseconds
+	uint64_t Percentile(double Percent) const
+	{
+		const uint64_t count = Count();
+		if (count == 0)
+			return 0;
+
+		const uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(count * std::clamp(Percent, 0.0, 100.0) / 100.0)));
+		uint64_t seen = 0;
+		for (size_t bucket = 0; bucket < Buckets; ++bucket)
+		{
+			seen += m_Buckets[bucket].load(std::memory_order_relaxed);
+			if (seen >= target)
+				return std::min(BucketUpper(bucket), Max());
+		}
+		return Max();
+	}
+
+	void Reset()
+	{
+		for (std::atomic<uint64_t>& bucket : m_Buckets)
+			bucket.store(0, std::memory_order_relaxed);
+		m_Count.store(0, std::memory_order_relaxed);
+		m_Total.store(0, std::memory_order_relaxed);
+		m_Max.store(0, std::memory_order_relaxed);
+	}
+
+private:
+	// Values below SubBuckets get a bucket each, after that each power of two is split in SubBuckets
+	static size_t BucketFor(uint64_t Value)
+	{
+		if (Value < SubBuckets)
+			return static_cast<size_t>(Value);
+
+		const size_t msb = std::bit_width(Value) - 1;
+		const size_t sub = static_cast<size_t>(Value >> (msb - 2)) & (SubBuckets - 1);
+		return std::min((msb - 1) * SubBuckets + sub, Buckets - 1);
+	}
+
+	static uint64_t BucketUpper(size_t Bucket)
+	{
+		if (Bucket < SubBuckets)
+			return Bucket;
+
+		const size_t msb = Bucket / SubBuckets + 1;
+		const uint64_t width = uint64_t(1) << (msb - 2);
+		return (SubBuckets + Bucket % SubBuckets) * width + width - 1;
+	}
+
+	std::array<std::atomic<uint64_t>, Buckets> m_Buckets = {};
+	std::atomic<uint64_t> m_Count = 0;
+	std::atomic<uint64_t> m_Total = 0;
+	std::atomic<uint64_t> m_Max = 0;
+};
@@ -16,8 +16,42 @@
 //        need separate settings to handle this (an interim fix might be to just track when it was loaded by char)
 
 #include <mq/Plugin.h>
+#include "AlertThrottle.h"
+#include "CommandHysteresis.h"
+#include "GMCheckCore.h"
+#include "GMHistoryIndex.h"
+#include "GMHistoryLog.h"
+#include "GMHistoryWorker.h"
+#include "GMRegistry.h"
+#include "GMSharedState.h"
+#include "GMTracker.h"
+#include "LatencyHistogram.h"
+#include "MemberTable.h"
+#include "SoundWorker.h"
+#include "StereoGain.h"
+#include "TraceBuffer.h"
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <condition_variable>
+#include <fstream>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <thread>
 #include <vector>
 #include <mmsystem.h>
+#if defined(_WIN32)
+#include <mfapi.h>
+#include <mfidl.h>
+#include <mfreadwrite.h>
+#include <wrl/client.h>
+
+#pragma comment(lib, "mfplat.lib")
+#pragma comment(lib, "mfreadwrite.lib")
+#pragma comment(lib, "mfuuid.lib")
+#endif
 #include <mq/imgui/ImGuiUtils.h>
 
 PreSetup("MQ2GMCheck");
@@ -25,91 +59,345 @@ PLUGIN_VERSION(5.5);
 
 constexpr const char* PluginMsg = "\ay[\aoMQ2GMCheck\ax] ";
 
-uint32_t bmMQ2GMCheck = 0;
-uint64_t StopSoundTimer = 0;
+// Spans for /gmcheck trace, off unless started
+TraceBuffer s_trace;
 
-DWORD dwVolume;
-DWORD NewVol;
+//----------------------------------------------------------------------------
+// per-phase timing.  Each phase gets its own MQ benchmark (except sound playing,
+// which runs on the sound thread) plus a histogram for ${GMCheck.Perf[phase]}
+// and the Performance section of the settings panel.
+enum class PerfPhase
+{
+	Pulse,
+	ActivePulse,
+	AddSpawn,
+	RemoveSpawn,
+	TrackGMs,
+	Alert,
+	Sound,
+	TLO,
+	Panel,
+	Count
+};
+
+struct PerfPhaseStats
+{
+	const char* Name;
+	bool GameThread;
+	uint32_t Benchmark = 0;
+	LatencyHistogram Histogram;
+};
+
+std::array<PerfPhaseStats, static_cast<size_t>(PerfPhase::Count)> s_perfPhases = { {
+	{ "Pulse", true },
+	{ "ActivePulse", true },
+	{ "AddSpawn", true },
+	{ "RemoveSpawn", true },
+	{ "TrackGMs", true },
+	{ "Alert", true },
+	{ "Sound", false },
+	{ "TLO", true },
+	{ "Panel", true },
+} };
+
+class ScopedPhase
+{
+public:
+	explicit ScopedPhase(PerfPhase Phase) : m_Stats(s_perfPhases[static_cast<size_t>(Phase)])
+	{
+		if (m_Stats.Benchmark)
+			EnterMQ2Benchmark(m_Stats.Benchmark);
+	}
+
+	~ScopedPhase()
+	{
+		const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+		m_Stats.Histogram.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(end - m_Start).count());
+		s_trace.Record(m_Stats.Name, m_Start, end);
+		if (m_Stats.Benchmark)
+			ExitMQ2Benchmark(m_Stats.Benchmark);
+	}
+
+	ScopedPhase(const ScopedPhase&) = delete;
+	ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+private:
+	PerfPhaseStats& m_Stats;
+	const std::chrono::steady_clock::time_point m_Start = std::chrono::steady_clock::now();
+};
+
+static void RegisterPerfPhases()
+{
+	for (PerfPhaseStats& phase : s_perfPhases)
+	{
+		// The pulse keeps the plugin's original benchmark name (bmMQ2GMCheck), and like it
+		// times every pulse.  "MQ2GMCheck ActivePulse" only counts the ones that weren't
+		// skipped, so the difference in their counts is the skipped pulses.
+		if (phase.GameThread)
+			phase.Benchmark = AddMQ2Benchmark(&phase == &s_perfPhases[0] ? mqplugin::PluginName : fmt::format("{} {}", mqplugin::PluginName, phase.Name).c_str());
+	}
+}
+
+static void UnregisterPerfPhases()
+{
+	for (PerfPhaseStats& phase : s_perfPhases)
+	{
+		if (phase.Benchmark)
+			RemoveMQ2Benchmark(phase.Benchmark);
+		phase.Benchmark = 0;
+	}
+}
 
-bool bGMCmdActive = false;
-bool bVolSet = false;
+static PerfPhaseStats* FindPerfPhase(const char* Name)
+{
+	for (PerfPhaseStats& phase : s_perfPhases)
+	{
+		if (ci_equals(phase.Name, Name))
+			return &phase;
+	}
+	return nullptr;
+}
 
 enum FlagOptions { Off, On, Toggle };
 
-template <size_t BUFFER_SIZE = MAX_STRING>
-std::string DisplayDT(const std::string& Format)
+template <size_t BUFFER_SIZE>
+const char* DisplayDT(char (&CurrentDT)[BUFFER_SIZE], const char* Format)
 {
-	char CurrentDT[MAX_STRING] = { 0 };
 	struct tm currentDT;
 	time_t long_dt;
 	CurrentDT[0] = 0;
 	time(&long_dt);
 	localtime_s(&currentDT, &long_dt);
-	strftime(CurrentDT, MAX_STRING, Format.c_str(), &currentDT);
-	return(std::string(CurrentDT));
+	strftime(CurrentDT, BUFFER_SIZE, Format, &currentDT);
+	return CurrentDT;
 }
 
-enum class GMStatuses
+// The GMs in zone as the TLO hands them out, rebuilt only when the registry changes
+struct GMList
 {
-	Enter,
-	Leave,
-	Reminder
+	struct Entry
+	{
+		std::string Name;
+		uint32_t SpawnID = 0;
+		uint64_t NameHash = 0;
+		std::chrono::nanoseconds FirstSeen{ 0 };
+	};
+
+	uint64_t Version = UINT64_MAX;
+	std::string Names;
+	std::vector<Entry> Entries;
 };
 
-class GMTrack
+class GMTrack : public GMTracker<std::chrono::high_resolution_clock>
 {
 private:
-	typedef std::chrono::high_resolution_clock clock;
-	typedef std::chrono::duration<float, std::milli> duration;
-	clock::time_point pulsestart;
-	clock::time_point reminderstart;
-	clock::time_point reminderdelay;
+	// ExcludeZoneList compiled down to zone ids, redone when the settings generation changes
+	std::bitset<MAX_ZONES> ExcludedZoneIDs;
+	std::string ExcludedZoneIDList;
+	std::string ExcludedZonesSource;
+	uint32_t ExcludedZonesGeneration = 0;
+	// Settings generation the tracker options were last taken from
+	uint32_t OptionsGeneration = 0;
+	GMList CachedList;
 	enum ExcludeZone { Exclude, Include, Zoning };
 public:
 	ExcludeZone eExcludeZone = ExcludeZone::Include;
-	std::map<std::string, bool> GMNames;
 	std::string LastGMName = "NONE";
 	std::string LastGMTime = "NEVER";
 	std::string LastGMDate = "NEVER";
 	std::string LastGMZone = "NONE";
-	GMTrack();
-	template <class Iterator> Iterator ciEqual(Iterator first, Iterator last, const char* value);
-	void CheckAlerts();
-	bool AlertPending();
-	uint32_t GMCount() const;
-	void AddGM(const char* gm_name);
-	void RemoveGM(const char* gm_name);
+	GMTrack(ISpawnSource& SpawnSource, IAlertSink& AlertSink);
+	void SyncOptions();
+	const GMList& List();
+	int ReminderIn(uint64_t NameHash) const;
 	void PlayAlerts();
-	void Clear();
 	void BeginZone();
 	void EndZone();
+	void CompileExcludedZones();
+	const std::string& GetExcludedZoneIDs();
 	void SetExcludedZone();
 	bool IsIncludedZone() const;
 } *gmTrack;
 
-static void DoGMAlert(const char* gm_name, GMStatuses status, bool test = false);
+static void DoGMAlert(const char* gm_name, GMStatuses status, bool test = false, bool owner = true);
+static void QueueGMAlert(const char* gm_name, GMStatuses status);
+static void GMRemoved(const char* gm_name);
+static bool OwnsAnySharedGM();
 static void TrackGMs(const char* GMName);
+static bool ClaimSharedGM(const SpawnRef& Spawn);
+static bool IsTrackableGM(const PlayerClient* pSpawn);
+static void OnSettingsChanged();
+
+//----------------------------------------------------------------------------
+// the game side of the interfaces in GMCheckCore.h
+static SpawnRef MakeSpawnRef(const PlayerClient* pSpawn)
+{
+	return { pSpawn->SpawnID, pSpawn->DisplayedName, pSpawn };
+}
+
+class MQSpawnSource : public ISpawnSource
+{
+public:
+	bool FindGM(uint32_t SpawnID, SpawnRef& Spawn) const override
+	{
+		const PlayerClient* pSpawn = GetSpawnByID(SpawnID);
+		if (!pSpawn || !IsTrackableGM(pSpawn))
+			return false;
+		Spawn = MakeSpawnRef(pSpawn);
+		return true;
+	}
+
+	void ForEachGM(const std::function<void(const SpawnRef&)>& Callback) const override
+	{
+		for (const PlayerClient* pSpawn = pSpawnList; pSpawn; pSpawn = pSpawn->GetNext())
+		{
+			if (IsTrackableGM(pSpawn))
+				Callback(MakeSpawnRef(pSpawn));
+		}
+	}
+} s_spawnSource;
+
+class MQAlertSink : public IAlertSink
+{
+public:
+	void Sighted(const SpawnRef& Spawn) override
+	{
+		// With shared state on, only the client that owns the GM records it
+		if (ClaimSharedGM(Spawn))
+			TrackGMs(Spawn.Name);
+		char szTime[64];
+		gmTrack->LastGMName = Spawn.Name;
+		gmTrack->LastGMTime = DisplayDT(szTime, "%I:%M:%S %p");
+		gmTrack->LastGMDate = DisplayDT(szTime, "%m-%d-%y");
+		gmTrack->LastGMZone = "UNKNOWN";
+		const int zoneid = pLocalPC ? pLocalPC->get_zoneId() : MAX_ZONES;
+		if (zoneid < MAX_ZONES)
+		{
+			gmTrack->LastGMZone = pWorldData->ZoneArray[zoneid]->LongName;
+		}
+	}
+
+	void Removed(const SpawnRef& Spawn) override
+	{
+		GMRemoved(Spawn.Name);
+	}
+
+	void Alert(const char* Names, GMStatuses Status) override
+	{
+		if (Status == GMStatuses::Reminder)
+			DoGMAlert(Names, Status, false, OwnsAnySharedGM());
+		else
+			QueueGMAlert(Names, Status);
+	}
+} s_alertSink;
+
+//----------------------------------------------------------------------------
+// enter/leave alerts waiting out AlertWindow, and the limits on each kind of output
+AlertCoalescer<std::chrono::steady_clock> s_alertCoalescer;
+
+struct AlertLimits
+{
+	// A burst of 3, then one more every 10 seconds
+	static constexpr inline uint32_t Burst = 3;
+	static constexpr inline std::chrono::seconds Refill = std::chrono::seconds(10);
+
+	TokenBucket<std::chrono::steady_clock> Sound{ Burst, Refill };
+	TokenBucket<std::chrono::steady_clock> Beep{ Burst, Refill };
+	TokenBucket<std::chrono::steady_clock> Popup{ Burst, Refill };
+} s_alertLimits;
+
+// GMEnterCmd / GMLeaveCmd, with hysteresis against GMs flickering in and out
+CommandHysteresis<std::chrono::steady_clock> s_gmCommands;
+
+class MQProfileStore : public IProfileStore
+{
+public:
+	std::string GetString(const char* Section, const char* Key, const std::string& Default) const override
+	{
+		return GetPrivateProfileString(Section, Key, Default, INIFileName);
+	}
+
+	int GetInt(const char* Section, const char* Key, int Default) const override
+	{
+		return GetPrivateProfileInt(Section, Key, Default, INIFileName);
+	}
+
+	bool GetBool(const char* Section, const char* Key, bool Default) const override
+	{
+		return GetPrivateProfileBool(Section, Key, Default, INIFileName);
+	}
+
+	bool KeyExists(const char* Section, const char* Key) const override
+	{
+		return PrivateProfileKeyExists(Section, Key, INIFileName);
+	}
+
+	std::vector<std::string> GetKeys(const char* Section) const override
+	{
+		return GetPrivateProfileKeys(Section, INIFileName);
+	}
+
+	std::vector<std::string> GetSections() const override
+	{
+		std::vector<char> buffer(0x10000);
+		while (GetPrivateProfileSectionNames(buffer.data(), static_cast<DWORD>(buffer.size()), INIFileName) == buffer.size() - 2)
+			buffer.resize(buffer.size() * 2);
+
+		std::vector<std::string> sections;
+		for (const char* pSection = buffer.data(); *pSection; pSection += strlen(pSection) + 1)
+			sections.emplace_back(pSection);
+		return sections;
+	}
+
+	void WriteString(const char* Section, const char* Key, const std::string& Value) override
+	{
+		TraceSpan span(s_trace, "IniWrite");
+		WritePrivateProfileString(Section, Key, Value, INIFileName);
+	}
+
+	void WriteInt(const char* Section, const char* Key, int Value) override
+	{
+		TraceSpan span(s_trace, "IniWrite");
+		WritePrivateProfileInt(Section, Key, Value, INIFileName);
+	}
+
+	void WriteBool(const char* Section, const char* Key, bool Value) override
+	{
+		TraceSpan span(s_trace, "IniWrite");
+		WritePrivateProfileBool(Section, Key, Value, INIFileName);
+	}
+
+	void DeleteSection(const char* Section) override
+	{
+		TraceSpan span(s_trace, "IniWrite");
+		WritePrivateProfileString(Section, nullptr, nullptr, INIFileName);
+	}
+} s_profileStore;
 
 class BooleanOption
 {
 private:
+	IProfileStore* pStore = nullptr;
 	std::string KeyName;
 	std::string ChatMessage;
 	bool bFlag = false;
 public:
 	BooleanOption() {};
-	BooleanOption(bool Default, std::string Key, std::string Message)
+	BooleanOption(IProfileStore& Store, bool Default, std::string Key, std::string Message)
 	{
+		pStore = &Store;
 		KeyName = Key;
 		ChatMessage = Message;
 		bFlag = Default;
-		if (KeyName.length())
-			bFlag = GetPrivateProfileBool("Settings", KeyName.c_str(), Default, INIFileName);
 	};
-	bool Read()
+	// Only hits the ini, everything else should use Read() or the settings snapshot
+	void Load()
 	{
 		if (KeyName.length())
-			bFlag = GetPrivateProfileBool("Settings", KeyName.c_str(), bFlag, INIFileName);
+			bFlag = pStore->GetBool("Settings", KeyName.c_str(), bFlag);
+	};
+	bool Read() const
+	{
 		return(bFlag);
 	};
 	void Write(enum FlagOptions fopt, bool silent = false)
@@ -121,12 +409,55 @@ public:
 		else
 			bFlag = false;
 		if (KeyName.length())
-			WritePrivateProfileBool("Settings", KeyName.c_str(), bFlag, INIFileName);
+			pStore->WriteBool("Settings", KeyName.c_str(), bFlag);
 		if (!silent)
 			WriteChatf("%s\am%s %s\am.", PluginMsg, ChatMessage.c_str(), bFlag ? "\agENABLED" : "\arDISABLED");
+		OnSettingsChanged();
 	};
 };
 
+//----------------------------------------------------------------------------
+// read-only copy of the settings. A new one (with a new generation) is published
+// whenever something changes, so the pulse/spawn/panel code never touches the ini.
+struct SettingsSnapshot
+{
+	uint32_t Generation = 0;
+	bool GMCheckEnabled = false;
+	bool GMSoundEnabled = false;
+	bool GMBeepEnabled = false;
+	bool GMPopupEnabled = false;
+	bool GMCorpseEnabled = false;
+	bool GMChatAlertEnabled = false;
+	bool GMQuietEnabled = false;
+	bool ExcludeZonesEnabled = false;
+	bool SharedStateEnabled = false;
+	int ReminderInterval = 0;
+	int ReminderBackoff = 0;
+	int ReminderMax = 0;
+	int ReminderZoneDelay = 0;
+	int AlertWindow = 0;
+	int CmdMinState = 0;
+	int CmdLeaveDelay = 0;
+	int CmdMaxPerWindow = 0;
+	int CmdWindow = 0;
+	int HistoryRawDays = 0;
+	int HistoryDailyDays = 0;
+	int LeftVolume = 0;
+	int RightVolume = 0;
+	std::string szGMEnterCmd;
+	std::string szGMEnterCmdIf;
+	std::string szGMLeaveCmd;
+	std::string szGMLeaveCmdIf;
+	std::string szExcludeZones;
+	std::filesystem::path Sound_GMEnter;
+	std::filesystem::path Sound_GMLeave;
+	std::filesystem::path Sound_GMRemind;
+	// The sound paths as text, for the TLO
+	std::string Sound_GMEnterPath;
+	std::string Sound_GMLeavePath;
+	std::string Sound_GMRemindPath;
+};
+
 //----------------------------------------------------------------------------
 // this class holds persisted settings for this plugin.
 class Settings
@@ -140,7 +471,19 @@ public:
 	static constexpr inline FlagOptions default_GMCorpseEnabled = FlagOptions::Off;
 	static constexpr inline FlagOptions default_GMChatAlertEnabled = FlagOptions::On;
 	static constexpr inline FlagOptions default_ExcludeZonesEnabled = FlagOptions::Off;
+	static constexpr inline FlagOptions default_SharedStateEnabled = FlagOptions::Off;
 	static constexpr inline int default_ReminderInterval = 30;
+	static constexpr inline int default_ReminderBackoff = 2;
+	static constexpr inline int default_ReminderMax = 600;
+	static constexpr inline int default_ReminderZoneDelay = 10;
+	static constexpr inline int default_AlertWindow = 250;
+	static constexpr inline int default_CmdMinState = 10;
+	static constexpr inline int default_CmdLeaveDelay = 10;
+	static constexpr inline int default_CmdMaxPerWindow = 4;
+	static constexpr inline int default_CmdWindow = 300;
+	static constexpr inline int default_HistoryRawDays = 30;
+	static constexpr inline int default_HistoryDailyDays = 365;
+	static constexpr inline int default_Volume = 50;
 	static constexpr inline const char* default_ExcludeZones = "nexus|poknowledge";
 
 	std::string szGMEnterCmd = std::string();
@@ -160,58 +503,156 @@ public:
 	BooleanOption m_GMChatAlertEnabled;
 	BooleanOption m_GMQuietEnabled;
 	BooleanOption m_ExcludeZonesEnabled;
+	BooleanOption m_SharedStateEnabled;
 
-	inline int GetReminderInterval() const { return m_ReminderInterval; }
+	// Read these back from the snapshot like everything else
 	void SetReminderInterval(int reminderinterval);
+	void SetVolume(int LeftVolume, int RightVolume);
 	void Load();
 	void Reset();
 
+	// The published snapshot, only valid until the next change -- don't hold on to it
+	inline const SettingsSnapshot& Current() const { return *m_Snapshot; }
+	// For holding on to it across something that might change the settings
+	inline std::shared_ptr<const SettingsSnapshot> Snapshot() const { return m_Snapshot; }
+	inline uint32_t Generation() const { return m_Snapshot->Generation; }
+	void Publish();
+
+	// Holds back Publish() until the outermost batch ends, so Load/Reset go out as one snapshot
+	class PublishBatch
+	{
+	public:
+		explicit PublishBatch(Settings& Owner) : m_Owner(Owner) { ++m_Owner.m_Batching; }
+		~PublishBatch() { End(); }
+		PublishBatch(const PublishBatch&) = delete;
+		PublishBatch& operator=(const PublishBatch&) = delete;
+
+		// Publishes anything held back (if this is the outermost batch) without waiting for the destructor
+		void End()
+		{
+			if (m_Ended)
+				return;
+			m_Ended = true;
+			if (!--m_Owner.m_Batching && m_Owner.m_PublishHeld)
+				m_Owner.Publish();
+		}
+
+	private:
+		Settings& m_Owner;
+		bool m_Ended = false;
+	};
+
+	// Where a requested sound file was found, remembered per character until the next invalidate
+	struct ResolvedSoundFile
+	{
+		std::filesystem::path Path;
+		bool Exists = false;
+		std::filesystem::file_time_type LastWrite;
+		bool Warned = false;
+		bool Stale = false;
+	};
+
 	[[nodiscard]] std::filesystem::path SearchSoundPaths(std::filesystem::path file_path);
-	[[nodiscard]] std::filesystem::path GetBestSoundFile(const std::filesystem::path& file_path, bool try_alternate_extension = true);
+	[[nodiscard]] const ResolvedSoundFile& GetBestSoundFile(const std::filesystem::path& file_path);
+	void InvalidateSoundFiles();
+	inline size_t SoundFileCount() const { return m_SoundFiles.size(); }
+	inline uint32_t SoundFileHits() const { return m_SoundFileHits; }
+	inline uint32_t SoundFileMisses() const { return m_SoundFileMisses; }
 	void SetGMSoundFile(const char* friendly_name, std::filesystem::path* global_path);
 	void SetAllGMSoundFiles();
 
-	Settings()
-	{
-		m_GMCheckEnabled = BooleanOption(default_GMCheckEnabled, "GMCheck", "GM checking is now");
-		m_GMSoundEnabled = BooleanOption(default_GMSoundEnabled, "GMSound", "Sound playing on GM detection is now");
-		m_GMBeepEnabled = BooleanOption(default_GMBeepEnabled, "GMBeep", "Beeping on GM detection is now");
-		m_GMPopupEnabled = BooleanOption(default_GMPopupEnabled, "GMPopup", "Showing popup message on GM detection is now");
-		m_GMCorpseEnabled = BooleanOption(default_GMCorpseEnabled, "GMCorpse", "Alerting for GM corpses is now");
-		m_GMChatAlertEnabled = BooleanOption(default_GMChatAlertEnabled, "GMChat", "Displaying GM detection alerts in MQ chat window is now");
-		m_GMQuietEnabled = BooleanOption(FlagOptions::Off, "", "GM alert and reminder quiet mode is now");
-		m_ExcludeZonesEnabled = BooleanOption(default_ExcludeZonesEnabled, "ExcludeZones", "Excluding zones listed in ExcludeZoneList from GM detection is now");
+	explicit Settings(IProfileStore& Store) : m_Store(Store)
+	{
+		m_GMCheckEnabled = BooleanOption(m_Store, default_GMCheckEnabled, "GMCheck", "GM checking is now");
+		m_GMSoundEnabled = BooleanOption(m_Store, default_GMSoundEnabled, "GMSound", "Sound playing on GM detection is now");
+		m_GMBeepEnabled = BooleanOption(m_Store, default_GMBeepEnabled, "GMBeep", "Beeping on GM detection is now");
+		m_GMPopupEnabled = BooleanOption(m_Store, default_GMPopupEnabled, "GMPopup", "Showing popup message on GM detection is now");
+		m_GMCorpseEnabled = BooleanOption(m_Store, default_GMCorpseEnabled, "GMCorpse", "Alerting for GM corpses is now");
+		m_GMChatAlertEnabled = BooleanOption(m_Store, default_GMChatAlertEnabled, "GMChat", "Displaying GM detection alerts in MQ chat window is now");
+		m_GMQuietEnabled = BooleanOption(m_Store, FlagOptions::Off, "", "GM alert and reminder quiet mode is now");
+		m_ExcludeZonesEnabled = BooleanOption(m_Store, default_ExcludeZonesEnabled, "ExcludeZones", "Excluding zones listed in ExcludeZoneList from GM detection is now");
+		m_SharedStateEnabled = BooleanOption(m_Store, default_SharedStateEnabled, "SharedState", "Sharing GM state with the other clients on this PC is now");
+		Publish();
 	};
 
 private:
+	IProfileStore& m_Store;
 	int m_ReminderInterval = default_ReminderInterval;
+	int m_ReminderBackoff = default_ReminderBackoff;
+	int m_ReminderMax = default_ReminderMax;
+	int m_ReminderZoneDelay = default_ReminderZoneDelay;
+	int m_AlertWindow = default_AlertWindow;
+	int m_CmdMinState = default_CmdMinState;
+	int m_CmdLeaveDelay = default_CmdLeaveDelay;
+	int m_CmdMaxPerWindow = default_CmdMaxPerWindow;
+	int m_CmdWindow = default_CmdWindow;
+	int m_HistoryRawDays = default_HistoryRawDays;
+	int m_HistoryDailyDays = default_HistoryDailyDays;
+	int m_LeftVolume = default_Volume;
+	int m_RightVolume = default_Volume;
+	uint32_t m_Generation = 0;
+	uint32_t m_Batching = 0;
+	bool m_PublishHeld = false;
+	// Set by Load, the sound files were re-resolved so all of them get preloaded with the next snapshot
+	bool m_PreloadHeld = false;
+	std::shared_ptr<const SettingsSnapshot> m_Snapshot;
+	std::unordered_map<std::string, ResolvedSoundFile> m_SoundFiles;
+	uint32_t m_SoundFileHits = 0;
+	uint32_t m_SoundFileMisses = 0;
+
+	int LoadVolume(const char* Key);
+	[[nodiscard]] std::filesystem::path FindSoundFile(const std::filesystem::path& file_path, bool try_alternate_extension);
 };
-Settings s_settings;
+Settings s_settings(s_profileStore);
+
+static void SetupVolumes();
+static void PreloadSounds(const SettingsSnapshot& Snapshot);
 
 void Settings::Load()
 {
-	m_GMCheckEnabled.Read();
-	m_GMSoundEnabled.Read();
-	m_GMBeepEnabled.Read();
-	m_GMPopupEnabled.Read();
-	m_GMCorpseEnabled.Read();
-	m_GMChatAlertEnabled.Read();
-	m_ExcludeZonesEnabled.Read();
+	PublishBatch batch(*this);
+	InvalidateSoundFiles();
+	m_PreloadHeld = true;
+	m_GMCheckEnabled.Load();
+	m_GMSoundEnabled.Load();
+	m_GMBeepEnabled.Load();
+	m_GMPopupEnabled.Load();
+	m_GMCorpseEnabled.Load();
+	m_GMChatAlertEnabled.Load();
+	m_ExcludeZonesEnabled.Load();
+	m_SharedStateEnabled.Load();
 	m_GMQuietEnabled.Write(FlagOptions::Off, true);
-	m_ReminderInterval = GetPrivateProfileInt("Settings", "RemInt", default_ReminderInterval, INIFileName);
+	m_ReminderInterval = m_Store.GetInt("Settings", "RemInt", default_ReminderInterval);
 	if (m_ReminderInterval < 10 && m_ReminderInterval)
 		m_ReminderInterval = 10;
+	m_ReminderBackoff = std::clamp(m_Store.GetInt("Settings", "RemBackoff", default_ReminderBackoff), 1, 10);
+	m_ReminderMax = std::max(m_Store.GetInt("Settings", "RemMax", default_ReminderMax), 0);
+	m_ReminderZoneDelay = std::clamp(m_Store.GetInt("Settings", "RemZoneDelay", default_ReminderZoneDelay), 0, 300);
+	m_AlertWindow = std::clamp(m_Store.GetInt("Settings", "AlertWindow", default_AlertWindow), 0, 5000);
+	m_CmdMinState = std::max(m_Store.GetInt("Settings", "CmdMinState", default_CmdMinState), 0);
+	m_CmdLeaveDelay = std::max(m_Store.GetInt("Settings", "CmdLeaveDelay", default_CmdLeaveDelay), 0);
+	m_CmdMaxPerWindow = std::clamp(m_Store.GetInt("Settings", "CmdMaxPerWindow", default_CmdMaxPerWindow), 0, static_cast<int>(CommandHysteresis<std::chrono::steady_clock>::MaxCommandsLimit));
+	m_CmdWindow = std::max(m_Store.GetInt("Settings", "CmdWindow", default_CmdWindow), 0);
+	// Days of raw sightings (0 turns compacting off), then daily rollups until HistoryDailyDays
+	m_HistoryRawDays = std::clamp(m_Store.GetInt("Settings", "HistoryRawDays", default_HistoryRawDays), 0, 36500);
+	m_HistoryDailyDays = std::clamp(m_Store.GetInt("Settings", "HistoryDailyDays", default_HistoryDailyDays), m_HistoryRawDays, 36500);
+	m_LeftVolume = LoadVolume("LeftVolume");
+	m_RightVolume = LoadVolume("RightVolume");
 	SetAllGMSoundFiles();
-	szGMEnterCmd = GetPrivateProfileString("Settings", "GMEnterCmd", std::string(), INIFileName);
-	szGMEnterCmdIf = GetPrivateProfileString("Settings", "GMEnterCmdIf", std::string(), INIFileName);
-	szGMLeaveCmd = GetPrivateProfileString("Settings", "GMLeaveCmd", std::string(), INIFileName);
-	szGMLeaveCmdIf = GetPrivateProfileString("Settings", "GMLeaveCmdIf", std::string(), INIFileName);
-	szExcludeZones = GetPrivateProfileString("Settings", "ExcludeZoneList", default_ExcludeZones, INIFileName);
+	szGMEnterCmd = m_Store.GetString("Settings", "GMEnterCmd", std::string());
+	szGMEnterCmdIf = m_Store.GetString("Settings", "GMEnterCmdIf", std::string());
+	szGMLeaveCmd = m_Store.GetString("Settings", "GMLeaveCmd", std::string());
+	szGMLeaveCmdIf = m_Store.GetString("Settings", "GMLeaveCmdIf", std::string());
+	szExcludeZones = m_Store.GetString("Settings", "ExcludeZoneList", default_ExcludeZones);
+	Publish();
+	batch.End();
+	SetupVolumes();
 	gmTrack->SetExcludedZone();
 }
 
 void Settings::Reset()
 {
+	PublishBatch batch(*this);
 	m_GMCheckEnabled.Write(default_GMCheckEnabled);
 	m_GMSoundEnabled.Write(default_GMSoundEnabled);
 	m_GMBeepEnabled.Write(default_GMBeepEnabled);
@@ -220,18 +661,118 @@ void Settings::Reset()
 	m_GMChatAlertEnabled.Write(default_GMChatAlertEnabled);
 	m_GMQuietEnabled.Write(default_GMQuietEnabled);
 	m_ExcludeZonesEnabled.Write(default_ExcludeZonesEnabled);
+	m_SharedStateEnabled.Write(default_SharedStateEnabled);
 	szGMEnterCmd = "";
 	szGMEnterCmdIf = "";
 	szGMLeaveCmd = "";
 	szGMLeaveCmdIf = "";
 	szExcludeZones = default_ExcludeZones;
 	m_ReminderInterval = default_ReminderInterval;
+	m_ReminderBackoff = default_ReminderBackoff;
+	m_ReminderMax = default_ReminderMax;
+	m_ReminderZoneDelay = default_ReminderZoneDelay;
+	m_AlertWindow = default_AlertWindow;
+	m_CmdMinState = default_CmdMinState;
+	m_CmdLeaveDelay = default_CmdLeaveDelay;
+	m_CmdMaxPerWindow = default_CmdMaxPerWindow;
+	m_CmdWindow = default_CmdWindow;
+	m_HistoryRawDays = default_HistoryRawDays;
+	m_HistoryDailyDays = default_HistoryDailyDays;
 	Sound_GMEnter = std::filesystem::path(gPathResources) / "Sounds\\gmenter.mp3";
 	Sound_GMLeave = std::filesystem::path(gPathResources) / "Sounds\\gmleave.mp3";
 	Sound_GMRemind = std::filesystem::path(gPathResources) / "Sounds\\gmremind.mp3";
+	Publish();
+	batch.End();
 	gmTrack->SetExcludedZone();
 }
 
+void Settings::Publish()
+{
+	if (m_Batching)
+	{
+		m_PublishHeld = true;
+		return;
+	}
+	m_PublishHeld = false;
+
+	auto snapshot = std::make_shared<SettingsSnapshot>();
+	snapshot->Generation = ++m_Generation;
+	snapshot->GMCheckEnabled = m_GMCheckEnabled.Read();
+	snapshot->GMSoundEnabled = m_GMSoundEnabled.Read();
+	snapshot->GMBeepEnabled = m_GMBeepEnabled.Read();
+	snapshot->GMPopupEnabled = m_GMPopupEnabled.Read();
+	snapshot->GMCorpseEnabled = m_GMCorpseEnabled.Read();
+	snapshot->GMChatAlertEnabled = m_GMChatAlertEnabled.Read();
+	snapshot->GMQuietEnabled = m_GMQuietEnabled.Read();
+	snapshot->ExcludeZonesEnabled = m_ExcludeZonesEnabled.Read();
+	snapshot->SharedStateEnabled = m_SharedStateEnabled.Read();
+	snapshot->ReminderInterval = m_ReminderInterval;
+	snapshot->ReminderBackoff = m_ReminderBackoff;
+	snapshot->ReminderMax = m_ReminderMax;
+	snapshot->ReminderZoneDelay = m_ReminderZoneDelay;
+	snapshot->AlertWindow = m_AlertWindow;
+	snapshot->CmdMinState = m_CmdMinState;
+	snapshot->CmdLeaveDelay = m_CmdLeaveDelay;
+	snapshot->CmdMaxPerWindow = m_CmdMaxPerWindow;
+	snapshot->CmdWindow = m_CmdWindow;
+	snapshot->HistoryRawDays = m_HistoryRawDays;
+	snapshot->HistoryDailyDays = m_HistoryDailyDays;
+	snapshot->LeftVolume = m_LeftVolume;
+	snapshot->RightVolume = m_RightVolume;
+	snapshot->szGMEnterCmd = szGMEnterCmd;
+	snapshot->szGMEnterCmdIf = szGMEnterCmdIf;
+	snapshot->szGMLeaveCmd = szGMLeaveCmd;
+	snapshot->szGMLeaveCmdIf = szGMLeaveCmdIf;
+	snapshot->szExcludeZones = szExcludeZones;
+	snapshot->Sound_GMEnter = Sound_GMEnter;
+	snapshot->Sound_GMLeave = Sound_GMLeave;
+	snapshot->Sound_GMRemind = Sound_GMRemind;
+	snapshot->Sound_GMEnterPath = Sound_GMEnter.string();
+	snapshot->Sound_GMLeavePath = Sound_GMLeave.string();
+	snapshot->Sound_GMRemindPath = Sound_GMRemind.string();
+
+	// Get new sound files decoded before the first alert that needs them
+	const bool sounds_changed = m_Snapshot && (m_Snapshot->Sound_GMEnter != Sound_GMEnter
+		|| m_Snapshot->Sound_GMLeave != Sound_GMLeave || m_Snapshot->Sound_GMRemind != Sound_GMRemind);
+	m_Snapshot = std::move(snapshot);
+	if (sounds_changed || m_PreloadHeld)
+		PreloadSounds(*m_Snapshot);
+	m_PreloadHeld = false;
+}
+
+static void OnSettingsChanged()
+{
+	s_settings.Publish();
+}
+
+int Settings::LoadVolume(const char* Key)
+{
+	int i = m_Store.GetInt("Settings", Key, -1);
+	if (i > 100 || i < 0)
+	{
+		i = default_Volume;
+		m_Store.WriteInt("Settings", Key, i);
+	}
+	return i;
+}
+
+void Settings::SetVolume(int LeftVolume, int RightVolume)
+{
+	LeftVolume = std::clamp(LeftVolume, 0, 100);
+	RightVolume = std::clamp(RightVolume, 0, 100);
+	if (LeftVolume == m_LeftVolume && RightVolume == m_RightVolume)
+		return;
+
+	if (LeftVolume != m_LeftVolume)
+		m_Store.WriteInt("Settings", "LeftVolume", LeftVolume);
+	if (RightVolume != m_RightVolume)
+		m_Store.WriteInt("Settings", "RightVolume", RightVolume);
+	m_LeftVolume = LeftVolume;
+	m_RightVolume = RightVolume;
+	Publish();
+	SetupVolumes();
+}
+
 void Settings::SetReminderInterval(int ReminderInterval)
 {
 	if (ReminderInterval == m_ReminderInterval)
@@ -240,7 +781,8 @@ void Settings::SetReminderInterval(int ReminderInterval)
 	m_ReminderInterval = ReminderInterval;
 	if (m_ReminderInterval < 10 && m_ReminderInterval)
 		m_ReminderInterval = 10;
-	WritePrivateProfileInt("Settings", "RemInt", m_ReminderInterval, INIFileName);
+	m_Store.WriteInt("Settings", "RemInt", m_ReminderInterval);
+	Publish();
 }
 
 [[nodiscard]] std::filesystem::path Settings::SearchSoundPaths(std::filesystem::path file_path)
@@ -266,7 +808,7 @@ void Settings::SetReminderInterval(int ReminderInterval)
 	return file_path;
 }
 
-[[nodiscard]] std::filesystem::path Settings::GetBestSoundFile(const std::filesystem::path& file_path, bool try_alternate_extension)
+[[nodiscard]] std::filesystem::path Settings::FindSoundFile(const std::filesystem::path& file_path, bool try_alternate_extension)
 {
 	std::error_code ec;
 	std::filesystem::path return_path = file_path;
@@ -297,11 +839,11 @@ void Settings::SetReminderInterval(int ReminderInterval)
 				tmp = return_path;
 				if (tmp.extension() == ".mp3")
 				{
-					tmp = GetBestSoundFile(tmp.replace_extension("wav"), false);
+					tmp = FindSoundFile(tmp.replace_extension("wav"), false);
 				}
 				else
 				{
-					tmp = GetBestSoundFile(tmp.replace_extension("mp3"), false);
+					tmp = FindSoundFile(tmp.replace_extension("mp3"), false);
 				}
 
 				if (exists(tmp, ec))
@@ -312,39 +854,79 @@ void Settings::SetReminderInterval(int ReminderInterval)
 		}
 	}
 
-	if (return_path != file_path)
+	return return_path;
+}
+
+// Finding a sound can take up to eight stats, so the answer is kept until settings are reloaded or a
+// sound is set.  After that an entry that was found is reused if its file is still unchanged.
+[[nodiscard]] const Settings::ResolvedSoundFile& Settings::GetBestSoundFile(const std::filesystem::path& file_path)
+{
+	std::string key = pLocalPC ? pLocalPC->Name : "";
+	key += '|';
+	key += file_path.string();
+
+	std::error_code ec;
+	ResolvedSoundFile& entry = m_SoundFiles[key];
+	if (!entry.Path.empty() || file_path.empty())
+	{
+		if (!entry.Stale)
+		{
+			++m_SoundFileHits;
+			return entry;
+		}
+
+		entry.Stale = false;
+		if (entry.Exists && std::filesystem::last_write_time(entry.Path, ec) == entry.LastWrite && !ec)
+		{
+			++m_SoundFileHits;
+			return entry;
+		}
+	}
+
+	++m_SoundFileMisses;
+	entry.Path = FindSoundFile(file_path, true);
+	entry.LastWrite = std::filesystem::last_write_time(entry.Path, ec);
+	entry.Exists = !ec;
+
+	if (entry.Path != file_path && !entry.Warned)
 	{
-		WriteChatf("%s\atWARNING - Sound file could not be found. Replacing \"\ay%s\ax\" with \"\ay%s\ax\"", PluginMsg, file_path.string().c_str(), return_path.string().c_str());
+		WriteChatf("%s\atWARNING - Sound file could not be found. Replacing \"\ay%s\ax\" with \"\ay%s\ax\"", PluginMsg, file_path.string().c_str(), entry.Path.string().c_str());
+		entry.Warned = true;
 	}
 
-	return return_path;
+	return entry;
+}
+
+void Settings::InvalidateSoundFiles()
+{
+	for (auto& [key, entry] : m_SoundFiles)
+		entry.Stale = true;
 }
 
 void Settings::SetGMSoundFile(const char* friendly_name, std::filesystem::path* global_path)
 {
-	std::error_code ec;
-	std::filesystem::path tmp;
-	if (pLocalPC && PrivateProfileKeyExists(pLocalPC->Name, friendly_name, INIFileName))
+	const ResolvedSoundFile* pSound = nullptr;
+	if (pLocalPC && m_Store.KeyExists(pLocalPC->Name, friendly_name))
 	{
-		tmp = GetBestSoundFile(GetPrivateProfileString(pLocalPC->Name, friendly_name, (*global_path).string(), INIFileName));
-		if (!exists(tmp, ec))
+		pSound = &GetBestSoundFile(m_Store.GetString(pLocalPC->Name, friendly_name, global_path->string()));
+		if (!pSound->Exists)
 		{
-			WriteChatf("%s\atWARNING - GM '%s' file not found for %s (Global Setting will be used instead): \am%s", PluginMsg, friendly_name, pLocalPC->Name, tmp.string().c_str());
+			WriteChatf("%s\atWARNING - GM '%s' file not found for %s (Global Setting will be used instead): \am%s", PluginMsg, friendly_name, pLocalPC->Name, pSound->Path.string().c_str());
 		}
 	}
 
-	if (tmp.empty() || !exists(tmp, ec))
+	if (!pSound || pSound->Path.empty() || !pSound->Exists)
 	{
-		tmp = GetBestSoundFile(GetPrivateProfileString("Settings", friendly_name, (*global_path).string(), INIFileName));
+		pSound = &GetBestSoundFile(m_Store.GetString("Settings", friendly_name, global_path->string()));
 	}
 
-	if (!exists(tmp, ec))
+	if (!pSound->Exists)
 	{
-		WriteChatf("%s\atWARNING - GM '%s' file not found: \am%s", PluginMsg, friendly_name, tmp.string().c_str());
+		WriteChatf("%s\atWARNING - GM '%s' file not found: \am%s", PluginMsg, friendly_name, pSound->Path.string().c_str());
 	}
 	else
 	{
-		*global_path = tmp;
+		*global_path = pSound->Path;
 	}
 }
 
@@ -353,216 +935,395 @@ void Settings::SetAllGMSoundFiles()
 	SetGMSoundFile("EnterSound", &Sound_GMEnter);
 	SetGMSoundFile("LeaveSound", &Sound_GMLeave);
 	SetGMSoundFile("RemindSound", &Sound_GMRemind);
+	Publish();
 }
 
-GMTrack::GMTrack()
+//----------------------------------------------------------------------------
+// alert sound output, see SoundWorker.h.  The plugin plays through wave out here.
+
+// Timing of the gain kernel, for /gmcheck status
+struct GainKernelStats
+{
+	std::atomic<uint64_t> Frames = 0;
+	std::atomic<uint64_t> Nanoseconds = 0;
+} s_gainStats;
+
+static void ApplyStereoGainTimed(const int16_t* pIn, int16_t* pOut, size_t Frames, int16_t LeftGain, int16_t RightGain)
 {
-	pulsestart = clock::now();
-	reminderstart = clock::now();
-	reminderdelay = clock::now();
+	const auto start = std::chrono::steady_clock::now();
+	ApplyStereoGain(pIn, pOut, Frames, LeftGain, RightGain);
+	s_gainStats.Nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	s_gainStats.Frames += Frames;
 }
 
-template <class Iterator>
-Iterator GMTrack::ciEqual(Iterator first, Iterator last, const char* value)
+#if defined(_WIN32)
+// Decodes through Media Foundation into the cache and plays the PCM on its own
+// wave out handle, so the volume only applies to our sounds.
+class WaveOutSoundBackend : public SoundBackend
 {
-	while (first != last)
-	{
-		if (_stricmp((*first).c_str(), value) == 0)
-		{
-			return first;
-		}
-		first++;
-	}
-	return last;
+public:
+	void Initialize() override;
+	void Shutdown() override;
+	bool Preload(const std::filesystem::path& SoundFile, std::string& Error) override;
+	bool Play(const std::filesystem::path& SoundFile, uint32_t& LengthMS, std::string& Error) override;
+	void Stop() override;
+	void SetVolume(uint32_t Volume) override;
+	void PlayError() override;
+	const SoundCache* GetCache() const override { return &m_Cache; }
+
+private:
+	std::shared_ptr<const PcmSound> Load(const std::filesystem::path& SoundFile, std::string& Error);
+	std::shared_ptr<const PcmSound> Decode(const std::filesystem::path& SoundFile, std::string& Error);
+
+	SoundCache m_Cache;
+	std::vector<int16_t> m_Buffer;
+	HWAVEOUT m_WaveOut = nullptr;
+	WAVEHDR m_Header = {};
+	int16_t m_LeftGain = 32767;
+	int16_t m_RightGain = 32767;
+	bool m_Started = false;
+};
+
+void WaveOutSoundBackend::Initialize()
+{
+	CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+	m_Started = SUCCEEDED(MFStartup(MF_VERSION, MFSTARTUP_LITE));
+}
+
+void WaveOutSoundBackend::Shutdown()
+{
+	Stop();
+	m_Cache.Clear();
+	if (m_Started)
+		MFShutdown();
+	m_Started = false;
+	CoUninitialize();
 }
 
-void GMTrack::CheckAlerts()
+std::shared_ptr<const PcmSound> WaveOutSoundBackend::Decode(const std::filesystem::path& SoundFile, std::string& Error)
 {
-	// Remove ourself if we were placed in the list
-	if (!GMNames.empty())
+	using Microsoft::WRL::ComPtr;
+
+	std::error_code ec;
+	if (!exists(SoundFile, ec))
 	{
-		for (auto it = GMNames.begin(); it != GMNames.end(); it++)
-		{
-			const PlayerClient* pSpawn = GetSpawnByName(it->first.c_str());
-			if (pSpawn && pSpawn->GM && pSpawn->SpawnID == pLocalPlayer->SpawnID)
-			{
-				GMNames.erase(it);
-			}
-		}
+		Error = fmt::format("Sound file not found: \am{}", SoundFile.string());
+		return nullptr;
 	}
-	// Remove any GMs that left
-	if (!GMNames.empty())
+
+	if (SoundFile.extension() != ".mp3" && SoundFile.extension() != ".wav")
 	{
-		for (auto it = GMNames.begin(); it != GMNames.end(); it++)
-		{
-			const PlayerClient* pSpawn = GetSpawnByName(it->first.c_str());
-			if (!pSpawn)
-			{
-				GMNames.erase(it);
-			}
-			else if (!pSpawn->GM)
-			{
-				GMNames.erase(it);
-			}
-		}
+		Error = fmt::format("Sound file not supported: \am{}", SoundFile.string());
+		return nullptr;
 	}
-	// Add any GMs that appeared
-	SPAWNINFO* pSpawn = pSpawnList;
-	while (pSpawn) {
-		if (pSpawn->GM && pSpawn->SpawnID != pLocalPlayer->SpawnID)
-		{
-			AddGM(pSpawn->DisplayedName);
-		}
-		pSpawn = pSpawn->GetNext();
+
+	ComPtr<IMFSourceReader> pReader;
+	ComPtr<IMFMediaType> pRequested;
+	ComPtr<IMFMediaType> pActual;
+	if (!m_Started
+		|| FAILED(MFCreateSourceReaderFromURL(absolute(SoundFile, ec).wstring().c_str(), nullptr, &pReader))
+		|| FAILED(pReader->SetStreamSelection(static_cast<DWORD>(MF_SOURCE_READER_ALL_STREAMS), FALSE))
+		|| FAILED(pReader->SetStreamSelection(static_cast<DWORD>(MF_SOURCE_READER_FIRST_AUDIO_STREAM), TRUE))
+		|| FAILED(MFCreateMediaType(&pRequested))
+		|| FAILED(pRequested->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Audio))
+		|| FAILED(pRequested->SetGUID(MF_MT_SUBTYPE, MFAudioFormat_PCM))
+		|| FAILED(pRequested->SetUINT32(MF_MT_AUDIO_BITS_PER_SAMPLE, 16))
+		|| FAILED(pReader->SetCurrentMediaType(static_cast<DWORD>(MF_SOURCE_READER_FIRST_AUDIO_STREAM), nullptr, pRequested.Get()))
+		|| FAILED(pReader->GetCurrentMediaType(static_cast<DWORD>(MF_SOURCE_READER_FIRST_AUDIO_STREAM), &pActual)))
+	{
+		Error = fmt::format("Something went wrong opening: \am{}", SoundFile.string());
+		return nullptr;
+	}
+
+	const uint32_t channels = MFGetAttributeUINT32(pActual.Get(), MF_MT_AUDIO_NUM_CHANNELS, 0);
+	auto sound = std::make_shared<PcmSound>();
+	sound->SampleRate = MFGetAttributeUINT32(pActual.Get(), MF_MT_AUDIO_SAMPLES_PER_SECOND, 0);
+	if (channels == 0 || sound->SampleRate == 0 || MFGetAttributeUINT32(pActual.Get(), MF_MT_AUDIO_BITS_PER_SAMPLE, 0) != 16)
+	{
+		Error = fmt::format("Sound format not supported: \am{}", SoundFile.string());
+		return nullptr;
 	}
-	// Alert if not flagged yet
-	if (!GMNames.empty() && !s_settings.m_GMQuietEnabled.Read() && s_settings.m_GMCheckEnabled.Read())
+
+	// Alerts never play for more than 9 seconds, no sense keeping more than that
+	const size_t max_frames = static_cast<size_t>(sound->SampleRate) * 9;
+	while (sound->Frames() < max_frames)
 	{
-		for (auto it = GMNames.begin(); it != GMNames.end(); it++)
+		DWORD flags = 0;
+		ComPtr<IMFSample> pSample;
+		if (FAILED(pReader->ReadSample(static_cast<DWORD>(MF_SOURCE_READER_FIRST_AUDIO_STREAM), 0, nullptr, &flags, nullptr, &pSample)))
 		{
-			if (!it->second)
-			{
-				it->second = true;
-				DoGMAlert(it->first.c_str(), GMStatuses::Enter);
-			}
+			Error = fmt::format("Something went wrong decoding: \am{}", SoundFile.string());
+			return nullptr;
+		}
+
+		if (flags & MF_SOURCE_READERF_ENDOFSTREAM)
+			break;
+
+		ComPtr<IMFMediaBuffer> pBuffer;
+		BYTE* pData = nullptr;
+		DWORD length = 0;
+		if (!pSample || FAILED(pSample->ConvertToContiguousBuffer(&pBuffer)) || FAILED(pBuffer->Lock(&pData, nullptr, &length)))
+			continue;
+
+		// Mono is duplicated to both sides, anything past the first two channels is dropped
+		const int16_t* pPcm = reinterpret_cast<const int16_t*>(pData);
+		const size_t frames = std::min<size_t>(length / (sizeof(int16_t) * channels), max_frames - sound->Frames());
+		sound->Samples.reserve(sound->Samples.size() + frames * 2);
+		for (size_t frame = 0; frame < frames; ++frame)
+		{
+			sound->Samples.push_back(pPcm[frame * channels]);
+			sound->Samples.push_back(pPcm[frame * channels + (channels > 1 ? 1 : 0)]);
 		}
+		pBuffer->Unlock();
 	}
+
+	return sound;
 }
 
-bool GMTrack::AlertPending()
+std::shared_ptr<const PcmSound> WaveOutSoundBackend::Load(const std::filesystem::path& SoundFile, std::string& Error)
 {
-	if (!GMNames.empty() && !s_settings.m_GMQuietEnabled.Read() && s_settings.m_GMCheckEnabled.Read())
+	const std::string key = SoundFile.string();
+	std::shared_ptr<const PcmSound> sound = m_Cache.Find(key);
+	if (!sound)
 	{
-		for (auto it = GMNames.begin(); it != GMNames.end(); it++)
-		{
-			if (!it->second)
-			{
-				return true;
-			}
-		}
+		sound = Decode(SoundFile, Error);
+		if (sound)
+			m_Cache.Insert(key, sound);
 	}
-	return false;
+	return sound;
 }
 
-uint32_t GMTrack::GMCount() const
+bool WaveOutSoundBackend::Preload(const std::filesystem::path& SoundFile, std::string& Error)
 {
-	return (uint32_t)GMNames.size();
+	return Load(SoundFile, Error) != nullptr;
 }
 
-void GMTrack::AddGM(const char* gm_name)
+bool WaveOutSoundBackend::Play(const std::filesystem::path& SoundFile, uint32_t& LengthMS, std::string& Error)
 {
-	for (auto it = GMNames.begin(); it != GMNames.end(); it++)
-	{
+	Stop();
 
-		if (!_stricmp(it->first.c_str(), gm_name))
-			return;
-	}
-	TrackGMs(gm_name);
-	GMNames.insert(std::make_pair(gm_name, false));
-	LastGMName = gm_name;
-	LastGMTime = DisplayDT("%I:%M:%S %p");
-	LastGMDate = DisplayDT("%m-%d-%y");
-	LastGMZone = "UNKNOWN";
-	const int zoneid = pLocalPC->get_zoneId();
-	if (zoneid < MAX_ZONES)
+	const std::shared_ptr<const PcmSound> sound = Load(SoundFile, Error);
+	if (!sound)
+		return false;
+
+	m_Buffer.resize(sound->Samples.size());
+	ApplyStereoGainTimed(sound->Samples.data(), m_Buffer.data(), sound->Frames(), m_LeftGain, m_RightGain);
+
+	WAVEFORMATEX format = {};
+	format.wFormatTag = WAVE_FORMAT_PCM;
+	format.nChannels = 2;
+	format.nSamplesPerSec = sound->SampleRate;
+	format.wBitsPerSample = 16;
+	format.nBlockAlign = format.nChannels * format.wBitsPerSample / 8;
+	format.nAvgBytesPerSec = format.nSamplesPerSec * format.nBlockAlign;
+	if (waveOutOpen(&m_WaveOut, WAVE_MAPPER, &format, 0, 0, CALLBACK_NULL) != MMSYSERR_NOERROR)
 	{
-		LastGMZone = pWorldData->ZoneArray[zoneid]->LongName;
+		m_WaveOut = nullptr;
+		Error = fmt::format("Something went wrong opening the sound device for: \am{}", SoundFile.string());
+		return false;
 	}
-}
 
-void GMTrack::RemoveGM(const char* gm_name)
-{
-	for (auto it = GMNames.begin(); it != GMNames.end(); it++)
+	m_Header = {};
+	m_Header.lpData = reinterpret_cast<LPSTR>(m_Buffer.data());
+	m_Header.dwBufferLength = static_cast<DWORD>(m_Buffer.size() * sizeof(int16_t));
+	if (waveOutPrepareHeader(m_WaveOut, &m_Header, sizeof(m_Header)) != MMSYSERR_NOERROR
+		|| waveOutWrite(m_WaveOut, &m_Header, sizeof(m_Header)) != MMSYSERR_NOERROR)
 	{
-		if (!_stricmp(it->first.c_str(), gm_name))
-		{
-			GMNames.erase(it);
-		}
+		Stop();
+		Error = fmt::format("Something went wrong playing: \am{}\ax", SoundFile.string());
+		return false;
 	}
+
+	LengthMS = sound->LengthMS();
+	return true;
 }
 
-void GMTrack::PlayAlerts()
+void WaveOutSoundBackend::Stop()
 {
-	MQScopedBenchmark bm(bmMQ2GMCheck);
-
-	if (eExcludeZone == ExcludeZone::Zoning)
+	if (!m_WaveOut)
 		return;
 
-	if (bVolSet && StopSoundTimer && MQGetTickCount64() >= StopSoundTimer)
-	{
-		StopSoundTimer = 0;
-		waveOutSetVolume(nullptr, dwVolume);
-	}
-	if (gGameState == GAMESTATE_INGAME)
-	{
-		duration elapsed = clock::now() - pulsestart;
-		bool AlertPending = gmTrack->AlertPending();
-		if (elapsed.count() > 15000 || AlertPending)
-		{
-			uint32_t gmc = gmTrack->GMCount();
-			pulsestart = clock::now();
-			gmTrack->CheckAlerts();
-			if (gmTrack->GMCount() > gmc)
-				reminderstart = clock::now();
-		}
+	waveOutReset(m_WaveOut);
+	if (m_Header.dwFlags & WHDR_PREPARED)
+		waveOutUnprepareHeader(m_WaveOut, &m_Header, sizeof(m_Header));
+	waveOutClose(m_WaveOut);
+	m_WaveOut = nullptr;
+}
 
-		if (s_settings.GetReminderInterval() > 0)
-		{
-			duration elapsed = clock::now() - reminderstart;
-			duration delayelapsed = clock::now() - reminderdelay;
-			if (elapsed.count() > s_settings.GetReminderInterval() * 1000 && delayelapsed.count() > 10000)
-			{
-				reminderstart = clock::now();
-				if (!GMNames.empty() && !s_settings.m_GMQuietEnabled.Read() && s_settings.m_GMCheckEnabled.Read() && !AlertPending)
-				{
-					std::string joined_names = "";
-					for (auto it = GMNames.begin(); it != GMNames.end(); it++)
-					{
-						if (it == GMNames.begin())
-							joined_names = "\ag";
-						else
-							joined_names += "\ax\am,\ax \ag";
-						joined_names += it->first;
-					}
-					DoGMAlert(joined_names.c_str(), GMStatuses::Reminder);
-				}
-			}
-		}
-	}
+void WaveOutSoundBackend::SetVolume(uint32_t Volume)
+{
+	m_LeftGain = static_cast<int16_t>((Volume & 0xFFFF) >> 1);
+	m_RightGain = static_cast<int16_t>((Volume >> 16) >> 1);
 }
 
-void GMTrack::Clear()
+void WaveOutSoundBackend::PlayError()
 {
-	GMNames.clear();
+	PlaySound(nullptr, nullptr, SND_NODEFAULT);
+	PlaySound("SystemDefault", nullptr, SND_ALIAS | SND_ASYNC | SND_NODEFAULT);
 }
+#endif
 
-void GMTrack::BeginZone()
+static std::unique_ptr<SoundBackend> CreateSoundBackend()
 {
-	eExcludeZone = ExcludeZone::Zoning;
-	GMNames.clear();
+#if defined(_WIN32)
+	return std::make_unique<WaveOutSoundBackend>();
+#else
+	return std::make_unique<NullSoundBackend>();
+#endif
 }
 
-void GMTrack::EndZone()
+SoundWorker s_soundWorker(s_trace, s_perfPhases[static_cast<size_t>(PerfPhase::Sound)].Histogram);
+
+static TrackerOptions MakeTrackerOptions(const SettingsSnapshot& Settings)
 {
-	s_settings.m_GMQuietEnabled.Write(FlagOptions::Off, true);
-	SetExcludedZone();
-	reminderdelay = clock::now();
+	TrackerOptions options;
+	options.Enabled = Settings.GMCheckEnabled;
+	options.Quiet = Settings.GMQuietEnabled;
+	options.ReminderInterval = std::chrono::seconds(Settings.ReminderInterval);
+	options.ReminderBackoff = static_cast<uint32_t>(Settings.ReminderBackoff);
+	options.ReminderMax = std::chrono::seconds(Settings.ReminderMax);
+	options.ReminderZoneDelay = std::chrono::seconds(Settings.ReminderZoneDelay);
+	return options;
 }
 
-void GMTrack::SetExcludedZone()
+GMTrack::GMTrack(ISpawnSource& SpawnSource, IAlertSink& AlertSink)
+	: GMTracker(SpawnSource, AlertSink, s_trace, MakeTrackerOptions(s_settings.Current()), clock::now()), OptionsGeneration(s_settings.Generation())
 {
-	if (s_settings.m_ExcludeZonesEnabled.Read() && !s_settings.szExcludeZones.empty())
+}
+
+// Settings changes reach the tracker here, once per generation
+void GMTrack::SyncOptions()
+{
+	if (OptionsGeneration == s_settings.Generation())
+		return;
+	OptionsGeneration = s_settings.Generation();
+	Configure(MakeTrackerOptions(s_settings.Current()));
+}
+
+const GMList& GMTrack::List()
+{
+	if (CachedList.Version == GMs.Changes())
+		return CachedList;
+
+	CachedList.Version = GMs.Changes();
+	CachedList.Names.clear();
+	CachedList.Entries.resize(GMs.Count());
+	size_t index = 0;
+	GMs.ForEach([this, &index](const GMEntry& entry)
+		{
+			if (!CachedList.Names.empty())
+				CachedList.Names += ", ";
+			CachedList.Names += entry.Name;
+
+			GMList::Entry& listed = CachedList.Entries[index++];
+			listed.Name = entry.Name;
+			listed.SpawnID = entry.SpawnID;
+			listed.NameHash = entry.NameHash;
+			listed.FirstSeen = entry.FirstSeen;
+		});
+	return CachedList;
+}
+
+int GMTrack::ReminderIn(uint64_t NameHash) const
+{
+	return GMTracker::ReminderIn(NameHash, clock::now());
+}
+
+void GMTrack::PlayAlerts()
+{
+	ScopedPhase pulse(PerfPhase::Pulse);
+	if (eExcludeZone == ExcludeZone::Zoning)
+		return;
+
+	std::vector<std::string> errors;
+	if (s_soundWorker.HasErrors() && s_soundWorker.TakeErrors(errors))
+	{
+		for (const std::string& error : errors)
+			WriteChatf("%s\atERROR - %s", PluginMsg, error.c_str());
+	}
+
+	if (gGameState != GAMESTATE_INGAME)
+		return;
+
+	// Most pulses have nothing to do, only the ones that do count toward ActivePulse
+	SyncOptions();
+	const clock::time_point now = clock::now();
+	if (Idle(now))
+		return;
+
+	ScopedPhase active(PerfPhase::ActivePulse);
+	Pulse(now);
+}
+
+void GMTrack::BeginZone()
+{
+	eExcludeZone = ExcludeZone::Zoning;
+	Clear();
+}
+
+void GMTrack::EndZone()
+{
+	s_settings.m_GMQuietEnabled.Write(FlagOptions::Off, true);
+	SyncOptions();
+	SetExcludedZone();
+	Restart(clock::now());
+}
+
+void GMTrack::CompileExcludedZones()
+{
+	// Zone names can't be resolved until the world data is loaded
+	if (ExcludedZonesGeneration == s_settings.Generation() || !pWorldData)
+		return;
+
+	// Most setting changes don't touch the list, no need to recompile (and warn again) for those
+	const bool bUnchanged = ExcludedZonesGeneration && ExcludedZonesSource == s_settings.Current().szExcludeZones;
+	ExcludedZonesGeneration = s_settings.Generation();
+	if (bUnchanged)
+		return;
+
+	ExcludedZonesSource = s_settings.Current().szExcludeZones;
+	ExcludedZoneIDs.reset();
+	ExcludedZoneIDList.clear();
+
+	for (const std::string& ZoneName : split(s_settings.Current().szExcludeZones, '|'))
 	{
+		if (ZoneName.empty())
+			continue;
+
+		const int ZoneID = GetZoneID(ZoneName.c_str());
+		if (ZoneID <= 0 || ZoneID >= MAX_ZONES)
+		{
+			WriteChatf("%s\atWARNING - Unknown zone in ExcludeZoneList: \am%s", PluginMsg, ZoneName.c_str());
+			continue;
+		}
+
+		if (!ExcludedZoneIDs.test(ZoneID))
+		{
+			ExcludedZoneIDs.set(ZoneID);
+			if (!ExcludedZoneIDList.empty())
+				ExcludedZoneIDList += "|";
+			ExcludedZoneIDList += std::to_string(ZoneID);
+		}
+	}
+}
+
+const std::string& GMTrack::GetExcludedZoneIDs()
+{
+	CompileExcludedZones();
+	return ExcludedZoneIDList;
+}
+
+void GMTrack::SetExcludedZone()
+{
+	if (s_settings.Current().ExcludeZonesEnabled)
+	{
+		CompileExcludedZones();
 		const int CurrentZone = pLocalPC ? (pLocalPC->zoneId & 0x7FFF) : 0;
-		if (CurrentZone > 0)
+		if (CurrentZone > 0 && CurrentZone < MAX_ZONES && ExcludedZoneIDs.test(CurrentZone))
 		{
-			const std::vector<std::string> ExcludeZones = split(s_settings.szExcludeZones, '|');
-			if (ciEqual(ExcludeZones.begin(), ExcludeZones.end(), GetShortZone(CurrentZone)) != ExcludeZones.end())
-			{
-				eExcludeZone = ExcludeZone::Exclude;
-				GMNames.clear();
-				return;
-			}
+			eExcludeZone = ExcludeZone::Exclude;
+			Clear();
+			return;
 		}
 	}
 	eExcludeZone = ExcludeZone::Include;
@@ -575,6 +1336,14 @@ bool GMTrack::IsIncludedZone() const
 	return false;
 }
 
+//----------------------------------------------------------------------------
+// the GM sighting log (MQ2GMCheck.gmlog), see GMHistoryLog.h for the format.  Every
+// write, merge and compaction happens on the history thread (see GMHistoryWorker.h)
+// so the game thread never waits on the file or on another client holding its lock.
+HistoryWorker s_history(s_trace);
+// what /gmcheck zone|server|all query, replaced by the one every merge builds and added to as GMs are seen
+GMHistoryIndex s_historyIndex;
+
 enum HistoryType {
 	eHistory_Zone,
 	eHistory_Server,
@@ -592,224 +1361,609 @@ int MCEval(const char* zBuffer)
 	return GetIntFromString(zOutput, 0);
 }
 
-class MQ2GMCheckType* pGMCheckType = nullptr;
+// Bumped every OnPulse, cached condition results are good until it changes
+static uint64_t s_pulseNumber = 0;
 
-class MQ2GMCheckType : public MQ2Type
+// GMEnterCmdIf / GMLeaveCmdIf, compiled once per settings generation.  A condition with
+// no ${} in it can't change, so it's folded to its value when compiled.  The rest are
+// parsed at most once a pulse, unless an alert asks for a fresh answer.
+class ConditionCache
 {
 public:
-	enum class GMCheckMembers
+	bool Evaluate(GMStatuses Status, bool Fresh = false)
 	{
-		Status = 1,
-		GM,
-		Names,
-		Sound,
-		Beep,
-		Popup,
-		Corpse,
-		Quiet,
-		Interval,
-		Enter,
-		Leave,
-		Remind,
-		ExcludeZones,
-		LastGMName,
-		LastGMTime,
-		LastGMDate,
-		LastGMZone,
-		GMEnterCmd,
-		GMEnterCmdIf,
-		GMLeaveCmd,
-		GMLeaveCmdIf,
-		ExcludeZoneList,
+		if (m_Generation != s_settings.Generation())
+			Compile();
+
+		Condition& condition = Status == GMStatuses::Enter ? m_Enter : m_Leave;
+		if (condition.Constant)
+		{
+			++FoldedReads;
+			return condition.Value != 0;
+		}
+
+		if (Fresh || condition.Pulse != s_pulseNumber)
+		{
+			++Evaluations;
+			condition.Value = MCEval(condition.Text.c_str());
+			condition.Pulse = s_pulseNumber;
+		}
+		else
+		{
+			++CachedReads;
+		}
+		return condition.Value != 0;
+	}
+
+	uint64_t Evaluations = 0;
+	uint64_t CachedReads = 0;
+	uint64_t FoldedReads = 0;
+
+private:
+	struct Condition
+	{
+		std::string Text;
+		bool Constant = true;
+		int Value = 1;
+		uint64_t Pulse = 0;
 	};
 
-	MQ2GMCheckType() :MQ2Type("GMCheck")
+	void Compile()
 	{
-		ScopedTypeMember(GMCheckMembers, Status);
-		ScopedTypeMember(GMCheckMembers, GM);
-		ScopedTypeMember(GMCheckMembers, Names);
-		ScopedTypeMember(GMCheckMembers, Sound);
-		ScopedTypeMember(GMCheckMembers, Beep);
-		ScopedTypeMember(GMCheckMembers, Popup);
-		ScopedTypeMember(GMCheckMembers, Corpse);
-		ScopedTypeMember(GMCheckMembers, Quiet);
-		ScopedTypeMember(GMCheckMembers, Interval);
-		ScopedTypeMember(GMCheckMembers, Enter);
-		ScopedTypeMember(GMCheckMembers, Leave);
-		ScopedTypeMember(GMCheckMembers, Remind);
-		ScopedTypeMember(GMCheckMembers, ExcludeZones);
-		ScopedTypeMember(GMCheckMembers, LastGMName);
-		ScopedTypeMember(GMCheckMembers, LastGMTime);
-		ScopedTypeMember(GMCheckMembers, LastGMDate);
-		ScopedTypeMember(GMCheckMembers, LastGMZone);
-		ScopedTypeMember(GMCheckMembers, GMEnterCmd);
-		ScopedTypeMember(GMCheckMembers, GMEnterCmdIf);
-		ScopedTypeMember(GMCheckMembers, GMLeaveCmd);
-		ScopedTypeMember(GMCheckMembers, GMLeaveCmdIf);
-		ScopedTypeMember(GMCheckMembers, ExcludeZoneList);
+		m_Generation = s_settings.Generation();
+		Compile(m_Enter, s_settings.Current().szGMEnterCmdIf);
+		Compile(m_Leave, s_settings.Current().szGMLeaveCmdIf);
 	}
 
-	virtual bool GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQTypeVar& Dest) override
+	static void Compile(Condition& condition, const std::string& Text)
 	{
-		using namespace mq::datatypes;
-		MQTypeMember* pMember = MQ2GMCheckType::FindMember(Member);
+		condition.Text = Text;
+		condition.Constant = Text.find("${") == std::string::npos;
+		// Without any ${} MCEval's parse is a no-op, so this is the same answer it would give
+		condition.Value = condition.Constant ? MCEval(Text.c_str()) : 0;
+		condition.Pulse = UINT64_MAX;
+	}
 
-		if (!pMember)
-			return false;
+	Condition m_Enter;
+	Condition m_Leave;
+	uint32_t m_Generation = UINT32_MAX;
+} s_conditions;
+
+//----------------------------------------------------------------------------
+// the GM table shared with the other clients on this PC, see GMSharedState.h
+GMSharedState s_sharedState;
+static std::chrono::steady_clock::time_point s_sharedSyncDue;
+
+// Instances of the same zone are different zones here
+static uint32_t SharedZoneID()
+{
+	return pLocalPC ? static_cast<uint32_t>(pLocalPC->zoneId) : 0;
+}
+
+static bool ClaimSharedGM(const SpawnRef& Spawn)
+{
+	if (!s_sharedState.IsOpen() || !pLocalPC)
+		return true;
+	return s_sharedState.Claim(GetServerShortName(), SharedZoneID(), Spawn.Name, Spawn.SpawnID, static_cast<int64_t>(time(nullptr)));
+}
+
+static bool OwnsSharedGM(const char* GMName)
+{
+	return !s_sharedState.IsOpen() || !pLocalPC || s_sharedState.Owns(GetServerShortName(), SharedZoneID(), GMName);
+}
+
+static bool OwnsAnySharedGM()
+{
+	if (!s_sharedState.IsOpen() || !pLocalPC)
+		return true;
 
-		switch ((GMCheckMembers)pMember->ID)
+	bool owned = false;
+	gmTrack->GMs.ForEach([&owned](const GMEntry& entry)
 		{
-		case GMCheckMembers::Status:
-			Dest.DWord = s_settings.m_GMCheckEnabled.Read();
-			Dest.Type = pBoolType;
-			return true;
+			owned = owned || OwnsSharedGM(entry.Name.c_str());
+		});
+	return owned;
+}
 
-		case GMCheckMembers::GM:
-			Dest.DWord = gmTrack->GMCount() > 0 ? true : false;
-			Dest.Type = pBoolType;
-			return true;
+// GMs any client has in this zone right now
+static int SharedGMCount()
+{
+	if (!s_sharedState.IsOpen() || !pLocalPC)
+		return static_cast<int>(gmTrack->GMCount());
 
-		case GMCheckMembers::Names:
+	const char* server = GetServerShortName();
+	const uint32_t zone = SharedZoneID();
+	int count = 0;
+	s_sharedState.ForEach(static_cast<int64_t>(time(nullptr)), [&](const GMSharedState::Entry& entry)
 		{
-			Dest.Ptr = &DataTypeTemp[0];
-			Dest.Type = pStringType;
+			if (entry.ZoneID == zone && !strcmp(entry.Server, server))
+				++count;
+		});
+	return count;
+}
 
-			if (!gmTrack->GMNames.empty() && s_settings.m_GMCheckEnabled.Read())
-			{
-				std::string joined_names = "";
-				for (auto it = gmTrack->GMNames.begin(); it != gmTrack->GMNames.end(); it++)
-				{
-					if (it != gmTrack->GMNames.begin())
-						joined_names += ", ";
-					joined_names += it->first;
-				}
-				strcpy_s(DataTypeTemp, joined_names.c_str());
-				return true;
-			}
+// Enter and leave alerts go through here so a group of GMs gets one alert
+static void FlushGMAlerts(bool Force)
+{
+	s_alertCoalescer.Flush(std::chrono::steady_clock::now(), Force, [](const char* Names, GMStatuses Status, bool Owned)
+		{
+			DoGMAlert(Names, Status, false, Owned);
+		});
+}
+
+static void QueueGMAlert(const char* gm_name, GMStatuses status)
+{
+	if (pLocalPlayer && !strcmp(gm_name, pLocalPlayer->Name))
+		return;
+
+	// Ownership is checked now, a leaving GM is released from the shared table right after this
+	s_alertCoalescer.SetWindow(std::chrono::milliseconds(s_settings.Current().AlertWindow));
+	s_alertCoalescer.Add(gm_name, status, OwnsSharedGM(gm_name), std::chrono::steady_clock::now());
+	FlushGMAlerts(false);
+}
+
+// Despawned or dropped by the verify/audit, the leave alert and the shared release go the same way
+static void GMRemoved(const char* gm_name)
+{
+	if (!pLocalPC)
+		return;
+	if (s_settings.Current().GMCheckEnabled && gmTrack->IsIncludedZone())
+		QueueGMAlert(gm_name, GMStatuses::Leave);
+	if (s_sharedState.IsOpen())
+		s_sharedState.Release(GetServerShortName(), SharedZoneID(), gm_name);
+}
+
+// Once a second: opens or closes the segment to match the setting, keeps this client's GMs
+// fresh (taking over any whose owner went quiet), and picks up GMs the others have seen here
+static void SyncSharedGMs()
+{
+	const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (now < s_sharedSyncDue)
+		return;
+	s_sharedSyncDue = now + std::chrono::seconds(1);
+
+	if (!s_settings.Current().SharedStateEnabled)
+	{
+		s_sharedState.Close();
+		return;
+	}
+
+	if (!s_sharedState.IsOpen() && !s_sharedState.Open("MQ2GMCheck"))
+	{
+		WriteChatf("%s\arERROR - Could not open the shared GM table, sharing is turned off.", PluginMsg);
+		s_settings.m_SharedStateEnabled.Write(FlagOptions::Off);
+		return;
+	}
+
+	if (gGameState != GAMESTATE_INGAME || !pLocalPC || !gmTrack->IsIncludedZone() || !s_settings.Current().GMCheckEnabled)
+		return;
+
+	TraceSpan span(s_trace, "SyncSharedGMs");
+	const int64_t time_now = static_cast<int64_t>(time(nullptr));
+	const char* server = GetServerShortName();
+	const uint32_t zone = SharedZoneID();
+	gmTrack->GMs.ForEach([&](const GMEntry& entry)
+		{
+			s_sharedState.Claim(server, zone, entry.Name, entry.SpawnID, time_now);
+		});
+
+	s_sharedState.ForEach(time_now, [&](const GMSharedState::Entry& entry)
+		{
+			SpawnRef spawn;
+			if (entry.ZoneID == zone && !strcmp(entry.Server, server) && !gmTrack->IsTracked(entry.SpawnID) && s_spawnSource.FindGM(entry.SpawnID, spawn))
+				gmTrack->AddGM(spawn);
+		});
+}
+
+class MQ2GMCheckType* pGMCheckType = nullptr;
+class MQ2GMCheckPerfType* pGMCheckPerfType = nullptr;
+class MQ2GMCheckGMType* pGMCheckGMType = nullptr;
+class MQ2GMCheckHistoryType* pGMCheckHistoryType = nullptr;
+
+static std::string FormatHistoryTime(int64_t Timestamp);
+
+// ${GMCheck.Perf[phase]}, times are in milliseconds
+class MQ2GMCheckPerfType : public MQ2Type
+{
+public:
+	enum class PerfMembers
+	{
+		Name = 1,
+		Count,
+		P50,
+		P99,
+		Max,
+		Mean,
+	};
+
+	MQ2GMCheckPerfType() :MQ2Type("GMCheckPerf")
+	{
+		ScopedTypeMember(PerfMembers, Name);
+		ScopedTypeMember(PerfMembers, Count);
+		ScopedTypeMember(PerfMembers, P50);
+		ScopedTypeMember(PerfMembers, P99);
+		ScopedTypeMember(PerfMembers, Max);
+		ScopedTypeMember(PerfMembers, Mean);
+	}
+
+	virtual bool GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQTypeVar& Dest) override
+	{
+		using namespace mq::datatypes;
+		MQTypeMember* pMember = MQ2GMCheckPerfType::FindMember(Member);
+
+		if (!pMember || VarPtr.Int < 0 || VarPtr.Int >= static_cast<int>(s_perfPhases.size()))
 			return false;
-		}
 
-		case GMCheckMembers::Sound:
-			Dest.DWord = s_settings.m_GMSoundEnabled.Read();
-			Dest.Type = pBoolType;
+		const PerfPhaseStats& phase = s_perfPhases[VarPtr.Int];
+		switch ((PerfMembers)pMember->ID)
+		{
+		case PerfMembers::Name:
+			strcpy_s(DataTypeTemp, phase.Name);
+			Dest.Ptr = &DataTypeTemp[0];
+			Dest.Type = pStringType;
 			return true;
 
-		case GMCheckMembers::Beep:
-			Dest.DWord = s_settings.m_GMBeepEnabled.Read();
-			Dest.Type = pBoolType;
+		case PerfMembers::Count:
+			Dest.Int64 = static_cast<int64_t>(phase.Histogram.Count());
+			Dest.Type = pInt64Type;
 			return true;
 
-		case GMCheckMembers::Popup:
-			Dest.DWord = s_settings.m_GMPopupEnabled.Read();
-			Dest.Type = pBoolType;
+		case PerfMembers::P50:
+			Dest.Float = phase.Histogram.Percentile(50.0) / 1000000.0f;
+			Dest.Type = pFloatType;
 			return true;
 
-		case GMCheckMembers::Corpse:
-			Dest.DWord = s_settings.m_GMCorpseEnabled.Read();
-			Dest.Type = pBoolType;
+		case PerfMembers::P99:
+			Dest.Float = phase.Histogram.Percentile(99.0) / 1000000.0f;
+			Dest.Type = pFloatType;
 			return true;
 
-		case GMCheckMembers::Quiet:
-			Dest.DWord = s_settings.m_GMQuietEnabled.Read();
-			Dest.Type = pBoolType;
+		case PerfMembers::Max:
+			Dest.Float = phase.Histogram.Max() / 1000000.0f;
+			Dest.Type = pFloatType;
 			return true;
 
-		case GMCheckMembers::Interval:
-			Dest.Int = s_settings.GetReminderInterval();
-			Dest.Type = pIntType;
+		case PerfMembers::Mean:
+			Dest.Float = phase.Histogram.Mean() / 1000000.0f;
+			Dest.Type = pFloatType;
 			return true;
+		}
+
+		return false;
+	}
+
+	virtual bool ToString(MQVarPtr VarPtr, char* Destination) override
+	{
+		if (VarPtr.Int < 0 || VarPtr.Int >= static_cast<int>(s_perfPhases.size()))
+			return false;
+		strcpy_s(Destination, MAX_STRING, s_perfPhases[VarPtr.Int].Name);
+		return true;
+	}
+};
+
+// ${GMCheck.Name[n]}, VarPtr.Int is the 0 based position in GMTrack::List()
+class MQ2GMCheckGMType : public MQ2Type
+{
+public:
+	enum class GMMembers
+	{
+		Name = 1,
+		SpawnID,
+		Since,
+		NextReminder,
+	};
+
+	MQ2GMCheckGMType() :MQ2Type("GMCheckGM")
+	{
+		ScopedTypeMember(GMMembers, Name);
+		ScopedTypeMember(GMMembers, SpawnID);
+		ScopedTypeMember(GMMembers, Since);
+		ScopedTypeMember(GMMembers, NextReminder);
+	}
+
+	virtual bool GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQTypeVar& Dest) override
+	{
+		using namespace mq::datatypes;
+		MQTypeMember* pMember = MQ2GMCheckGMType::FindMember(Member);
+
+		const GMList& list = gmTrack->List();
+		if (!pMember || VarPtr.Int < 0 || VarPtr.Int >= static_cast<int>(list.Entries.size()))
+			return false;
 
-		case GMCheckMembers::Enter:
-			strcpy_s(DataTypeTemp, s_settings.Sound_GMEnter.string().c_str());
+		const GMList::Entry& entry = list.Entries[VarPtr.Int];
+		switch ((GMMembers)pMember->ID)
+		{
+		case GMMembers::Name:
+			strcpy_s(DataTypeTemp, entry.Name.c_str());
 			Dest.Ptr = &DataTypeTemp[0];
 			Dest.Type = pStringType;
 			return true;
 
-		case GMCheckMembers::Leave:
-			strcpy_s(DataTypeTemp, s_settings.Sound_GMLeave.string().c_str());
-			Dest.Ptr = &DataTypeTemp[0];
-			Dest.Type = pStringType;
+		case GMMembers::SpawnID:
+			Dest.Int = static_cast<int>(entry.SpawnID);
+			Dest.Type = pIntType;
 			return true;
 
-		case GMCheckMembers::Remind:
-			strcpy_s(DataTypeTemp, s_settings.Sound_GMRemind.string().c_str());
-			Dest.Ptr = &DataTypeTemp[0];
-			Dest.Type = pStringType;
+		// Seconds since the GM was first seen in this zone
+		case GMMembers::Since:
+			Dest.Int = static_cast<int>(std::chrono::duration_cast<std::chrono::seconds>(GMTrack::clock::now().time_since_epoch() - entry.FirstSeen).count());
+			Dest.Type = pIntType;
 			return true;
 
-		case GMCheckMembers::ExcludeZones:
-			Dest.DWord = s_settings.m_ExcludeZonesEnabled.Read();
-			Dest.Type = pBoolType;
+		// Seconds until the GM is next in a reminder, -1 for none (reminders off, or not alerted yet)
+		case GMMembers::NextReminder:
+			Dest.Int = gmTrack->ReminderIn(entry.NameHash);
+			Dest.Type = pIntType;
 			return true;
+		}
 
-		case GMCheckMembers::LastGMName:
-			strcpy_s(DataTypeTemp, gmTrack->LastGMName.c_str());
-			Dest.Ptr = &DataTypeTemp[0];
-			Dest.Type = pStringType;
+		return false;
+	}
+
+	virtual bool ToString(MQVarPtr VarPtr, char* Destination) override
+	{
+		const GMList& list = gmTrack->List();
+		if (VarPtr.Int < 0 || VarPtr.Int >= static_cast<int>(list.Entries.size()))
+			return false;
+		strcpy_s(Destination, MAX_STRING, list.Entries[VarPtr.Int].Name.c_str());
+		return true;
+	}
+};
+
+// ${GMCheck.History[name]}, VarPtr.Int is the GM's id in s_historyIndex, NoGM without a name
+// (which only has Total) or UnknownGM for a name that's never been seen (everything but Total is 0)
+class MQ2GMCheckHistoryType : public MQ2Type
+{
+public:
+	static constexpr inline int NoGM = 0;
+	static constexpr inline int UnknownGM = -1;
+
+	enum class HistoryMembers
+	{
+		Count = 1,
+		LastSeen,
+		ServerCount,
+		ZoneCount,
+		Total,
+	};
+
+	MQ2GMCheckHistoryType() :MQ2Type("GMCheckHistory")
+	{
+		ScopedTypeMember(HistoryMembers, Count);
+		ScopedTypeMember(HistoryMembers, LastSeen);
+		ScopedTypeMember(HistoryMembers, ServerCount);
+		ScopedTypeMember(HistoryMembers, ZoneCount);
+		ScopedTypeMember(HistoryMembers, Total);
+	}
+
+	virtual bool GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQTypeVar& Dest) override
+	{
+		using namespace mq::datatypes;
+		MQTypeMember* pMember = MQ2GMCheckHistoryType::FindMember(Member);
+
+		if (!pMember)
+			return false;
+
+		// Never an id in the index, so an unknown GM finds nothing
+		const uint32_t gm = VarPtr.Int > 0 ? static_cast<uint32_t>(VarPtr.Int) : 0;
+		switch ((HistoryMembers)pMember->ID)
+		{
+		// Sightings on every server
+		case HistoryMembers::Count:
+			Dest.Int64 = static_cast<int64_t>(s_historyIndex.Totals(gm).Count);
+			Dest.Type = pInt64Type;
 			return true;
 
-		case GMCheckMembers::LastGMTime:
-			strcpy_s(DataTypeTemp, gmTrack->LastGMTime.c_str());
+		case HistoryMembers::LastSeen:
+			strcpy_s(DataTypeTemp, s_historyIndex.Totals(gm).LastSeen ? FormatHistoryTime(s_historyIndex.Totals(gm).LastSeen).c_str() : "NEVER");
 			Dest.Ptr = &DataTypeTemp[0];
 			Dest.Type = pStringType;
 			return true;
 
-		case GMCheckMembers::LastGMDate:
-			strcpy_s(DataTypeTemp, gmTrack->LastGMDate.c_str());
-			Dest.Ptr = &DataTypeTemp[0];
-			Dest.Type = pStringType;
+		case HistoryMembers::ServerCount:
+			Dest.Int64 = gm ? static_cast<int64_t>(s_historyIndex.Count(gm, GetServerShortName())) : 0;
+			Dest.Type = pInt64Type;
+			return true;
+
+		case HistoryMembers::ZoneCount:
+			Dest.Int64 = gm && pZoneInfo ? static_cast<int64_t>(s_historyIndex.Count(gm, GetServerShortName(), pZoneInfo->LongName)) : 0;
+			Dest.Type = pInt64Type;
+			return true;
+
+		// Every sighting of every GM
+		case HistoryMembers::Total:
+			Dest.Int64 = static_cast<int64_t>(s_historyIndex.Sightings());
+			Dest.Type = pInt64Type;
 			return true;
+		}
+
+		return false;
+	}
+
+	virtual bool ToString(MQVarPtr VarPtr, char* Destination) override
+	{
+		uint64_t count = 0;
+		if (VarPtr.Int == NoGM)
+			count = s_historyIndex.Sightings();
+		else if (VarPtr.Int != UnknownGM)
+			count = s_historyIndex.Totals(static_cast<uint32_t>(VarPtr.Int)).Count;
+		sprintf_s(Destination, MAX_STRING, "%llu", count);
+		return true;
+	}
+};
+
+// Results for the GMCheck members.  Strings are copied into DataTypeTemp (truncated to
+// MAX_STRING), the snapshot or list they come from can be gone before MQ reads them.
+static bool TLOBool(MQTypeVar& Dest, bool Value)
+{
+	Dest.DWord = Value;
+	Dest.Type = mq::datatypes::pBoolType;
+	return true;
+}
+
+static bool TLOInt(MQTypeVar& Dest, int Value)
+{
+	Dest.Int = Value;
+	Dest.Type = mq::datatypes::pIntType;
+	return true;
+}
+
+static bool TLOString(MQTypeVar& Dest, const char* Value)
+{
+	CopyMemberString(DataTypeTemp, MAX_STRING, Value);
+	Dest.Ptr = &DataTypeTemp[0];
+	Dest.Type = mq::datatypes::pStringType;
+	return true;
+}
+
+static bool TLOString(MQTypeVar& Dest, const std::string& Value)
+{
+	return TLOString(Dest, Value.c_str());
+}
+
+class MQ2GMCheckType : public MQ2Type
+{
+public:
+	enum class GMCheckMembers
+	{
+		Status = 1,
+		GM,
+		Names,
+		Sound,
+		Beep,
+		Popup,
+		Corpse,
+		Quiet,
+		Interval,
+		Enter,
+		Leave,
+		Remind,
+		ExcludeZones,
+		LastGMName,
+		LastGMTime,
+		LastGMDate,
+		LastGMZone,
+		GMEnterCmd,
+		GMEnterCmdIf,
+		GMLeaveCmd,
+		GMLeaveCmdIf,
+		ExcludeZoneList,
+		ExcludedZoneIDs,
+		Perf,
+		Count,
+		Name,
+		History,
+		Shared,
+		SharedGMs,
+		CmdState,
+	};
+
+	struct MemberEntry
+	{
+		const char* Name;
+		GMCheckMembers ID;
+		bool (*Get)(char* Index, MQTypeVar& Dest);
+	};
 
-		case GMCheckMembers::LastGMZone:
-			strcpy_s(DataTypeTemp, gmTrack->LastGMZone.c_str());
-			Dest.Ptr = &DataTypeTemp[0];
-			Dest.Type = pStringType;
-			return true;
+	// GetMember finds these through MemberTable (hashed at compile time) instead of FindMember
+	static constexpr MemberEntry Members[] = {
+		{ "Beep", GMCheckMembers::Beep, [](char*, MQTypeVar& Dest) { return TLOBool(Dest, s_settings.Current().GMBeepEnabled); } },
+		{ "CmdState", GMCheckMembers::CmdState, [](char*, MQTypeVar& Dest) { return TLOString(Dest, decltype(s_gmCommands)::Name(s_gmCommands.State())); } },
+		{ "Corpse", GMCheckMembers::Corpse, [](char*, MQTypeVar& Dest) { return TLOBool(Dest, s_settings.Current().GMCorpseEnabled); } },
+		{ "Count", GMCheckMembers::Count, [](char*, MQTypeVar& Dest) { return TLOInt(Dest, static_cast<int>(gmTrack->GMCount())); } },
+		{ "Enter", GMCheckMembers::Enter, [](char*, MQTypeVar& Dest) { return TLOString(Dest, s_settings.Current().Sound_GMEnterPath); } },
+		{ "ExcludedZoneIDs", GMCheckMembers::ExcludedZoneIDs, [](char*, MQTypeVar& Dest) { return TLOString(Dest, gmTrack->GetExcludedZoneIDs()); } },
+		{ "ExcludeZoneList", GMCheckMembers::ExcludeZoneList, [](char*, MQTypeVar& Dest) { return TLOString(Dest, s_settings.Current().szExcludeZones); } },
+		{ "ExcludeZones", GMCheckMembers::ExcludeZones, [](char*, MQTypeVar& Dest) { return TLOBool(Dest, s_settings.Current().ExcludeZonesEnabled); } },
+		{ "GM", GMCheckMembers::GM, [](char*, MQTypeVar& Dest) { return TLOBool(Dest, gmTrack->GMCount() > 0); } },
+		{ "GMEnterCmd", GMCheckMembers::GMEnterCmd, [](char*, MQTypeVar& Dest) { return TLOString(Dest, s_settings.Current().szGMEnterCmd); } },
+		{ "GMEnterCmdIf", GMCheckMembers::GMEnterCmdIf, [](char*, MQTypeVar& Dest) { return TLOString(Dest, s_conditions.Evaluate(GMStatuses::Enter) ? "TRUE" : "FALSE"); } },
+		{ "GMLeaveCmd", GMCheckMembers::GMLeaveCmd, [](char*, MQTypeVar& Dest) { return TLOString(Dest, s_settings.Current().szGMLeaveCmd); } },
+		{ "GMLeaveCmdIf", GMCheckMembers::GMLeaveCmdIf, [](char*, MQTypeVar& Dest) { return TLOString(Dest, s_conditions.Evaluate(GMStatuses::Leave) ? "TRUE" : "FALSE"); } },
+		{ "History", GMCheckMembers::History, [](char* Index, MQTypeVar& Dest)
+			{
+				// By GM name, or no index for the totals
+				Dest.Int = MQ2GMCheckHistoryType::NoGM;
+				if (Index && Index[0])
+				{
+					const uint32_t gm = s_historyIndex.FindGM(Index);
+					Dest.Int = gm ? static_cast<int>(gm) : MQ2GMCheckHistoryType::UnknownGM;
+				}
+				Dest.Type = pGMCheckHistoryType;
+				return true;
+			} },
+		{ "Interval", GMCheckMembers::Interval, [](char*, MQTypeVar& Dest) { return TLOInt(Dest, s_settings.Current().ReminderInterval); } },
+		{ "LastGMDate", GMCheckMembers::LastGMDate, [](char*, MQTypeVar& Dest) { return TLOString(Dest, gmTrack->LastGMDate); } },
+		{ "LastGMName", GMCheckMembers::LastGMName, [](char*, MQTypeVar& Dest) { return TLOString(Dest, gmTrack->LastGMName); } },
+		{ "LastGMTime", GMCheckMembers::LastGMTime, [](char*, MQTypeVar& Dest) { return TLOString(Dest, gmTrack->LastGMTime); } },
+		{ "LastGMZone", GMCheckMembers::LastGMZone, [](char*, MQTypeVar& Dest) { return TLOString(Dest, gmTrack->LastGMZone); } },
+		{ "Leave", GMCheckMembers::Leave, [](char*, MQTypeVar& Dest) { return TLOString(Dest, s_settings.Current().Sound_GMLeavePath); } },
+		{ "Name", GMCheckMembers::Name, [](char* Index, MQTypeVar& Dest)
+			{
+				// 1 based, in the same order as Names
+				if (!Index || !IsNumber(Index))
+					return false;
 
-		case GMCheckMembers::GMEnterCmd:
-			strcpy_s(DataTypeTemp, s_settings.szGMEnterCmd.c_str());
-			Dest.Ptr = &DataTypeTemp[0];
-			Dest.Type = pStringType;
-			return true;
+				const int gm_index = GetIntFromString(Index, 0) - 1;
+				if (gm_index < 0 || gm_index >= static_cast<int>(gmTrack->List().Entries.size()))
+					return false;
 
-		case GMCheckMembers::GMEnterCmdIf:
-			if (MCEval(s_settings.szGMEnterCmdIf.c_str()))
-				strcpy_s(DataTypeTemp, "TRUE");
-			else
-				strcpy_s(DataTypeTemp, "FALSE");
+				Dest.Int = gm_index;
+				Dest.Type = pGMCheckGMType;
+				return true;
+			} },
+		{ "Names", GMCheckMembers::Names, [](char*, MQTypeVar& Dest)
+			{
+				TLOString(Dest, "");
+				return !gmTrack->GMs.Empty() && s_settings.Current().GMCheckEnabled && TLOString(Dest, gmTrack->List().Names);
+			} },
+		{ "Perf", GMCheckMembers::Perf, [](char* Index, MQTypeVar& Dest)
+			{
+				// By name (Pulse, AddSpawn, ...) or 1 based number
+				if (!Index || !Index[0])
+					return false;
 
-			Dest.Ptr = &DataTypeTemp[0];
-			Dest.Type = pStringType;
-			return true;
+				int phase_index = -1;
+				if (const PerfPhaseStats* pPhase = FindPerfPhase(Index))
+					phase_index = static_cast<int>(pPhase - s_perfPhases.data());
+				else if (IsNumber(Index))
+					phase_index = GetIntFromString(Index, 0) - 1;
 
-		case GMCheckMembers::GMLeaveCmd:
-			strcpy_s(DataTypeTemp, s_settings.szGMLeaveCmd.c_str());
-			Dest.Ptr = &DataTypeTemp[0];
-			Dest.Type = pStringType;
-			return true;
+				if (phase_index < 0 || phase_index >= static_cast<int>(s_perfPhases.size()))
+					return false;
 
-		case GMCheckMembers::GMLeaveCmdIf:
-			if (MCEval(s_settings.szGMLeaveCmdIf.c_str()))
-				strcpy_s(DataTypeTemp, "TRUE");
-			else
-				strcpy_s(DataTypeTemp, "FALSE");
+				Dest.Int = phase_index;
+				Dest.Type = pGMCheckPerfType;
+				return true;
+			} },
+		{ "Popup", GMCheckMembers::Popup, [](char*, MQTypeVar& Dest) { return TLOBool(Dest, s_settings.Current().GMPopupEnabled); } },
+		{ "Quiet", GMCheckMembers::Quiet, [](char*, MQTypeVar& Dest) { return TLOBool(Dest, s_settings.Current().GMQuietEnabled); } },
+		{ "Remind", GMCheckMembers::Remind, [](char*, MQTypeVar& Dest) { return TLOString(Dest, s_settings.Current().Sound_GMRemindPath); } },
+		{ "Shared", GMCheckMembers::Shared, [](char*, MQTypeVar& Dest) { return TLOBool(Dest, s_settings.Current().SharedStateEnabled); } },
+		{ "SharedGMs", GMCheckMembers::SharedGMs, [](char*, MQTypeVar& Dest) { return TLOInt(Dest, SharedGMCount()); } },
+		{ "Sound", GMCheckMembers::Sound, [](char*, MQTypeVar& Dest) { return TLOBool(Dest, s_settings.Current().GMSoundEnabled); } },
+		{ "Status", GMCheckMembers::Status, [](char*, MQTypeVar& Dest) { return TLOBool(Dest, s_settings.Current().GMCheckEnabled); } },
+	};
+	static constexpr MemberHashTable MemberTable = MakeMemberHashTable(Members);
+	static_assert(MemberTable.Seed, "GMCheck member names must hash apart");
 
-			Dest.Ptr = &DataTypeTemp[0];
-			Dest.Type = pStringType;
-			return true;
-		case GMCheckMembers::ExcludeZoneList:
-			strcpy_s(DataTypeTemp, s_settings.szExcludeZones.c_str());
-			Dest.Ptr = &DataTypeTemp[0];
-			Dest.Type = pStringType;
-			return true;
-		}
+	MQ2GMCheckType() :MQ2Type("GMCheck")
+	{
+		// Still registered so MQ can list them
+		for (const MemberEntry& member : Members)
+			AddMember(static_cast<int>(member.ID), member.Name);
+	}
 
-		return false;
+	virtual bool GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQTypeVar& Dest) override
+	{
+		ScopedPhase phase(PerfPhase::TLO);
+		const MemberEntry* pMember = FindMemberEntry(Members, MemberTable, Member);
+		return pMember && pMember->Get(Index, Dest);
 	}
 
 	virtual bool ToString(MQVarPtr VarPtr, char* Destination) override
 	{
-		strcpy_s(Destination, MAX_STRING, gmTrack->GMNames.empty() ? "FALSE" : "TRUE");
+		strcpy_s(Destination, MAX_STRING, gmTrack->GMs.Empty() ? "FALSE" : "TRUE");
 		return true;
 	}
 
@@ -826,22 +1980,65 @@ static void GMCheckStatus(bool MentionHelp = false)
 	WriteChatf("\at%s \agv%1.2f", mqplugin::PluginName, MQ2Version);
 	char szTemp[MAX_STRING] = { 0 };
 
-	if (s_settings.GetReminderInterval())
-		sprintf_s(szTemp, "\ag%u \atsecs", s_settings.GetReminderInterval());
+	const SettingsSnapshot& settings = s_settings.Current();
+	if (settings.ReminderInterval)
+		sprintf_s(szTemp, "\ag%u \atsecs (x\ag%d \atafter each, up to \ag%d \atsecs)", settings.ReminderInterval,
+			settings.ReminderBackoff, std::max(settings.ReminderMax, settings.ReminderInterval));
 	else
 		strcpy_s(szTemp, "\arDisabled");
 
 	WriteChatf("%s\ar- \atGM Check is: %s \at(Chat: %s \at- Sound: %s \at- Beep: %s \at- Popup: %s \at- Corpses: %s \at- Exclude: \ag%s\at) - Reminder Interval: %s",
 		PluginMsg,
-		s_settings.m_GMCheckEnabled.Read() ? "\agON" : "\arOFF",
-		s_settings.m_GMChatAlertEnabled.Read() ? "\agON" : "\arOFF",
-		s_settings.m_GMSoundEnabled.Read() ? "\agON" : "\arOFF",
-		s_settings.m_GMBeepEnabled.Read() ? "\agON" : "\arOFF",
-		s_settings.m_GMPopupEnabled.Read() ? "\agON" : "\arOFF",
-		s_settings.m_GMCorpseEnabled.Read() ? "\agINCLUDED" : "\ayIGNORED",
-		s_settings.m_ExcludeZonesEnabled.Read() ? s_settings.szExcludeZones.c_str() : "\arOFF",
+		s_settings.Current().GMCheckEnabled ? "\agON" : "\arOFF",
+		s_settings.Current().GMChatAlertEnabled ? "\agON" : "\arOFF",
+		s_settings.Current().GMSoundEnabled ? "\agON" : "\arOFF",
+		s_settings.Current().GMBeepEnabled ? "\agON" : "\arOFF",
+		s_settings.Current().GMPopupEnabled ? "\agON" : "\arOFF",
+		s_settings.Current().GMCorpseEnabled ? "\agINCLUDED" : "\ayIGNORED",
+		s_settings.Current().ExcludeZonesEnabled ? s_settings.Current().szExcludeZones.c_str() : "\arOFF",
 		szTemp);
 
+	WriteChatf("%s\ar- \atHistory queue: \ag%u \atpending, \ag%llu \atflushes (last \ag%.1f\atms, max \ag%.1f\atms)",
+		PluginMsg,
+		static_cast<uint32_t>(s_history.QueueDepth()),
+		s_history.FlushCount(),
+		s_history.LastFlushMS(),
+		s_history.MaxFlushMS());
+	WriteChatf("%s\ar- \atHistory log: \ag%u \atevents (\ag%u \atin this client's segment), index of \ag%u \atGMs", PluginMsg,
+		s_history.LogEventCount(), s_history.SegmentEventCount(), static_cast<uint32_t>(s_historyIndex.GMCount()));
+	WriteChatf("%s\ar- \atSounds: \ag%llu \atplayed, \ag%llu \atsuperseded (queue latency last \ag%.1f\atms, max \ag%.1f\atms)",
+		PluginMsg,
+		s_soundWorker.PlayCount(),
+		s_soundWorker.SupersededCount(),
+		s_soundWorker.LastLatencyMS(),
+		s_soundWorker.MaxLatencyMS());
+	if (const SoundCache* pCache = s_soundWorker.GetCache())
+	{
+		const uint64_t frames = s_gainStats.Frames;
+		WriteChatf("%s\ar- \atSound cache: \ag%zu \atsounds, \ag%zu\atKB, \ag%llu \atevicted (gain \ag%.2f\atns per frame)",
+			PluginMsg,
+			pCache->Count(),
+			pCache->Bytes() / 1024,
+			pCache->Evictions(),
+			frames ? static_cast<double>(s_gainStats.Nanoseconds) / frames : 0.0);
+	}
+	WriteChatf("%s\ar- \atSound paths: \ag%zu \atcached, \ag%u \athits, \ag%u \atlookups",
+		PluginMsg, s_settings.SoundFileCount(), s_settings.SoundFileHits(), s_settings.SoundFileMisses());
+	if (s_sharedState.IsOpen())
+		WriteChatf("%s\ar- \atShared GM table: \ag%d \atGMs in zone across clients", PluginMsg, SharedGMCount());
+	else
+		WriteChatf("%s\ar- \atShared GM table: %s", PluginMsg, s_settings.Current().SharedStateEnabled ? "\ayOPENING" : "\arOFF");
+	WriteChatf("%s\ar- \atAlerts: \ag%llu \atenter/leave sent as \ag%llu \at(window \ag%d\atms), suppressed sound \ag%llu\at, beep \ag%llu\at, popup \ag%llu",
+		PluginMsg, s_alertCoalescer.Queued(), s_alertCoalescer.Sent(), s_settings.Current().AlertWindow,
+		s_alertLimits.Sound.Suppressed(), s_alertLimits.Beep.Suppressed(), s_alertLimits.Popup.Suppressed());
+	WriteChatf("%s\ar- \atGM reminders sent: \ag%llu", PluginMsg, gmTrack->RemindersFired());
+	WriteChatf("%s\ar- \atGM commands: \ag%s\at, \ag%llu \atrun, \ag%llu \atheld back, \ag%llu \atleaves cancelled by the GM coming back", PluginMsg,
+		decltype(s_gmCommands)::Name(s_gmCommands.State()), s_gmCommands.Commands(), s_gmCommands.Held(), s_gmCommands.Absorbed());
+	WriteChatf("%s\ar- \atPulses: \ag%llu \atactive, \ag%llu \atskipped", PluginMsg, gmTrack->ActivePulses, gmTrack->SkippedPulses);
+	WriteChatf("%s\ar- \atSpawn list audits: \ag%u\at, found drift: \ag%u", PluginMsg, gmTrack->AuditCount, gmTrack->AuditDriftCount);
+	WriteChatf("%s\ar- \atCmdIf conditions: \ag%llu \atevaluated, \ag%llu \atfrom this pulse's cache, \ag%llu \atconstant", PluginMsg,
+		s_conditions.Evaluations, s_conditions.CachedReads, s_conditions.FoldedReads);
+
 	if (MentionHelp)
 		WriteChatf("%s\ayUse '/gmcheck help' for command help", PluginMsg);
 }
@@ -852,84 +2049,6 @@ static void PlayErrorSound(const char* sound = "SystemDefault")
 	PlaySound(sound, nullptr, SND_ALIAS | SND_ASYNC | SND_NODEFAULT);
 }
 
-static void StopGMSound()
-{
-	mciSendString("Close mySound", nullptr, 0, nullptr);
-}
-
-static void PlayGMSound(const std::filesystem::path& sound_file)
-{
-	StopGMSound();
-
-	std::error_code ec;
-	if (!exists(sound_file, ec))
-	{
-		WriteChatf("%s\atERROR - Sound file not found: \am%s", PluginMsg, sound_file.string().c_str());
-	}
-	else
-	{
-		if (!bVolSet)
-		{
-			if (waveOutGetVolume(nullptr, &dwVolume) == MMSYSERR_NOERROR)
-			{
-				bVolSet = true;
-				waveOutSetVolume(nullptr, NewVol);
-			}
-		}
-
-		std::string sound_open;
-		if (sound_file.extension() == ".mp3")
-		{
-			sound_open = "MPEGVideo";
-		}
-		else if (sound_file.extension() == ".wav")
-		{
-			sound_open = "waveaudio";
-		}
-
-		if (sound_open.empty())
-		{
-			WriteChatf("%s\atERROR - Sound file not supported: \am%s", PluginMsg, sound_file.string().c_str());
-		}
-		else
-		{
-			sound_open = fmt::format("Open \"{}\" type {} Alias mySound", absolute(sound_file, ec).string(), sound_open);
-			int mci_error = mciSendString(sound_open.c_str(), nullptr, 0, nullptr);
-			if (mci_error == 0)
-			{
-				char szMsg[MAX_STRING] = { 0 };
-				mci_error = mciSendString("status mySound length", szMsg, MAX_STRING, nullptr);
-				if (mci_error == 0)
-				{
-					const int i = std::clamp(GetIntFromString(szMsg, 0), 0, 9000);
-
-					StopSoundTimer = MQGetTickCount64() + i;
-
-					const std::string play_command = fmt::format("play mySound from 0 {}notify", i < 9000 ? "" : "to 9000 ");
-
-					mci_error = mciSendString(play_command.c_str(), nullptr, 0, nullptr);
-
-					if (mci_error == 0)
-						return;
-
-					WriteChatf("%s\atERROR - Something went wrong playing: \am%s\ax", PluginMsg, sound_file.string().c_str());
-				}
-				else
-				{
-					WriteChatf("%s\atERROR - Something went wrong checking length of: \am%s\ax", PluginMsg, sound_file.string().c_str());
-				}
-			}
-			else
-			{
-				WriteChatf("%s\atERROR - Something went wrong opening: \am%s", PluginMsg, sound_file.string().c_str());
-			}
-		}
-	}
-
-	PlayErrorSound();
-	StopSoundTimer = MQGetTickCount64() + 1000;
-}
-
 static void GMReminder(char* szLine)
 {
 	char Interval[MAX_STRING];
@@ -941,14 +2060,13 @@ static void GMReminder(char* szLine)
 		return;
 	}
 
+	// Anything under 10 seconds (other than 0) is made 10
 	s_settings.SetReminderInterval(GetIntFromString(Interval, 0));
-	if (s_settings.GetReminderInterval() < 10 && s_settings.GetReminderInterval())
-		s_settings.SetReminderInterval(10);
-
-	if (s_settings.GetReminderInterval())
-		WriteChatf("%s\aw: Reminder interval set to \ar%u \awseconds.", PluginMsg, s_settings.GetReminderInterval());
+	const int interval = s_settings.Current().ReminderInterval;
+	if (interval)
+		WriteChatf("%s\aw: Reminder interval set to \ar%u \awseconds.", PluginMsg, interval);
 	else
-		WriteChatf("%s\aw: Reminder interval set to \ar%u \awseconds (\arDISABLED\aw).", PluginMsg, s_settings.GetReminderInterval());
+		WriteChatf("%s\aw: Reminder interval set to \ar%u \awseconds (\arDISABLED\aw).", PluginMsg, interval);
 }
 
 static void GMQuiet(char* szLine)
@@ -966,38 +2084,230 @@ static void GMQuiet(char* szLine)
 
 static void TrackGMs(const char* GMName)
 {
-	char szSection[MAX_STRING] = { 0 };
-	char szTemp[MAX_STRING] = { 0 };
-	int iCount = 0;
-	char szTime[MAX_STRING] = { 0 };
+	ScopedPhase phase(PerfPhase::TrackGMs);
+	HistorySighting sighting;
+	sighting.Timestamp = static_cast<int64_t>(time(nullptr));
+	sighting.GM = GMName;
+	sighting.Server = GetServerShortName();
+	sighting.Zone = pZoneInfo->LongName;
+	s_historyIndex.Add(sighting.GM, sighting.Server, sighting.Zone, sighting.Timestamp, sighting.Count);
+	s_history.Add(std::move(sighting));
+}
+
+// Old ini history entries end in "Date: 01-31-24 Time: 09:15:02 PM"
+static int64_t ParseLegacyHistoryTime(const char* szValue)
+{
+	const char* pDate = strstr(szValue, "Date: ");
+	if (!pDate)
+		return 0;
+
+	int month = 0, day = 0, year = 0, hour = 0, minute = 0, second = 0;
+	char szAMPM[3] = { 0 };
+	if (sscanf_s(pDate, "Date: %d-%d-%d Time: %d:%d:%d %2s", &month, &day, &year, &hour, &minute, &second, szAMPM, static_cast<unsigned>(sizeof(szAMPM))) < 6)
+		return 0;
+
+	struct tm seenDT = {};
+	seenDT.tm_year = (year < 100 ? year + 2000 : year) - 1900;
+	seenDT.tm_mon = month - 1;
+	seenDT.tm_mday = day;
+	seenDT.tm_hour = hour % 12 + (!_stricmp(szAMPM, "PM") ? 12 : 0);
+	seenDT.tm_min = minute;
+	seenDT.tm_sec = second;
+	seenDT.tm_isdst = -1;
+	const time_t seen = mktime(&seenDT);
+	return seen == -1 ? 0 : static_cast<int64_t>(seen);
+}
+
+// [GM] entries are "count,server,Date..." and are the only place that tells us which sections are servers
+static std::set<std::string> LegacyHistoryServers()
+{
+	std::set<std::string> servers;
+	char szArg[MAX_STRING] = { 0 };
+	for (const std::string& GMName : s_profileStore.GetKeys("GM"))
+	{
+		const std::string value = s_profileStore.GetString("GM", GMName.c_str(), "");
+		GetArg(szArg, value.c_str(), 2, 0, 0, 0, ',', 0);
+		if (szArg[0])
+			servers.insert(szArg);
+	}
+	return servers;
+}
+
+// The old [GM], [Server] and [Server-Zone] ini sections, imported into the sighting log once
+// by the merge on load
+static std::vector<HistorySighting> LoadIniHistory()
+{
+	std::vector<HistorySighting> sightings;
+	if (s_profileStore.GetBool("Settings", "HistoryMigrated", false))
+		return sightings;
+
+	const std::set<std::string> servers = LegacyHistoryServers();
+	char szArg[MAX_STRING] = { 0 };
+
+	// Only the Server-Zone sections are imported, the other two are just sums of them
+	for (const std::string& section : s_profileStore.GetSections())
+	{
+		const char* pSection = section.c_str();
+		const char* pDash = strchr(pSection, '-');
+		if (!pDash || servers.find(std::string(pSection, pDash)) == servers.end())
+			continue;
+
+		for (const std::string& GMName : s_profileStore.GetKeys(pSection))
+		{
+			const std::string value = s_profileStore.GetString(pSection, GMName.c_str(), "");
+			GetArg(szArg, value.c_str(), 1, 0, 0, 0, ',', 0);
+
+			HistorySighting sighting;
+			sighting.Event = HistoryEvent::Rollup;
+			sighting.Timestamp = ParseLegacyHistoryTime(value.c_str());
+			sighting.GM = GMName;
+			sighting.Server = std::string(pSection, pDash);
+			sighting.Zone = pDash + 1;
+			sighting.Count = std::max(GetIntFromString(szArg, 1), 1);
+			sightings.push_back(std::move(sighting));
+		}
+	}
+
+	return sightings;
+}
+
+// Once they've been imported the old history sections only slow down every other ini read, so
+// they go as soon as a load has put them in the log
+static uint32_t PruneIniHistory()
+{
+	const std::set<std::string> servers = LegacyHistoryServers();
+	uint32_t pruned = 0;
+	for (const std::string& section : s_profileStore.GetSections())
+	{
+		const size_t dash = section.find('-');
+		if (section == "GM" || servers.count(section) || (dash != std::string::npos && servers.count(section.substr(0, dash))))
+		{
+			s_profileStore.DeleteSection(section.c_str());
+			++pruned;
+		}
+	}
+	return pruned;
+}
+
+// HistoryRawDays (default 30) of sightings are kept as they are, then they're rolled up per day
+// until HistoryDailyDays (default 365) and per month after that.  HistoryRawDays=0 turns it off.
+static bool GetHistoryRetention(HistoryRetention& Retention)
+{
+	constexpr int64_t Day = 24 * 60 * 60;
+	const SettingsSnapshot& settings = s_settings.Current();
+	Retention.RawSeconds = settings.HistoryRawDays * Day;
+	Retention.DailySeconds = settings.HistoryDailyDays * Day;
+	return settings.HistoryRawDays > 0;
+}
+
+// Set when a compaction is started, for PollHistory to report it
+static bool s_historyQuietCompact = false;
+
+// Quiet is for the one after loading, which only says something if it did something.  Not
+// until the ini history is in the log, the import skips anything older than a compaction.
+static bool CompactHistory(bool Quiet)
+{
+	HistoryRetention retention;
+	if (!s_profileStore.GetBool("Settings", "HistoryMigrated", false) || !GetHistoryRetention(retention)
+		|| !s_history.Compact(static_cast<int64_t>(time(nullptr)), retention))
+		return false;
+
+	s_historyQuietCompact = Quiet;
+	return true;
+}
+
+// Reports the history thread's last merge or compaction and swaps in the index it built
+static void PollHistory()
+{
+	HistoryJobResult result;
+	if (!s_history.TakeResult(result))
+		return;
+
+	if (result.Reindexed)
+		s_historyIndex = std::move(result.Index);
+
+	switch (result.Job)
+	{
+	case HistoryJob::Load:
+		if (!result.Succeeded)
+		{
+			WriteChatf("%s\arERROR - Could not open the GM history log, sightings will be merged into it later (/gmcheck merge).", PluginMsg);
+			break;
+		}
+
+		if (result.DroppedBytes)
+			WriteChatf("%s\atWARNING - GM history log was not closed cleanly, dropped \ay%llu\at bytes of incomplete records.", PluginMsg, result.DroppedBytes);
+		if (result.Imported)
+			WriteChatf("%s\amImported \ag%u\am GM history entries from the ini into the sighting log.", PluginMsg, result.Imported);
+		if (!s_profileStore.GetBool("Settings", "HistoryMigrated", false))
+			s_profileStore.WriteBool("Settings", "HistoryMigrated", true);
+		if (const uint32_t pruned = PruneIniHistory())
+			WriteChatf("%s\amRemoved \ag%u\am old GM history sections from the ini, they're in the sighting log now.", PluginMsg, pruned);
+		CompactHistory(true);
+		break;
 
-	sprintf_s(szTime, "Date: %s Time: %s", DisplayDT("%m-%d-%y").c_str(), DisplayDT("%I:%M:%S %p").c_str());
+	case HistoryJob::Merge:
+		if (!result.Succeeded)
+			WriteChatf("%s\arERROR - Could not merge the GM history, another client may be holding the log.", PluginMsg);
+		else
+			WriteChatf("%s\amMerged \ag%u\am history segments in \ag%.1f\am ms: \ag%u\am new events, removed \ag%u\am segments of clients that are gone.", PluginMsg,
+				result.Merged.Segments, result.ElapsedMS, result.Merged.Added, result.Merged.Removed);
+		break;
+
+	case HistoryJob::Compact:
+		if (!result.Succeeded)
+			WriteChatf("%s\arERROR - Could not compact the GM history log, it was left as it was.", PluginMsg);
+		else if (result.Compaction.Changed || !s_historyQuietCompact)
+			WriteChatf("%s\amCompacted GM history in \ag%.1f\am ms: \ag%u\am -> \ag%u\am events, \ag%.1f\am -> \ag%.1f\am KB.",
+				PluginMsg, result.ElapsedMS, result.Compaction.EventsBefore, result.Compaction.EventsAfter,
+				result.Compaction.BytesBefore / 1024.0f, result.Compaction.BytesAfter / 1024.0f);
+		break;
 
-	// Store total GM count regardless of server
-	strcpy_s(szSection, "GM");
-	iCount = GetPrivateProfileInt(szSection, GMName, 0, INIFileName) + 1;
-	sprintf_s(szTemp, "%d,%s,%s", iCount, GetServerShortName(), szTime);
-	WritePrivateProfileString(szSection, GMName, szTemp, INIFileName);
+	case HistoryJob::None:
+		break;
+	}
+}
 
-	// Store GM count by Server
-	sprintf_s(szSection, "%s", GetServerShortName());
-	iCount = GetPrivateProfileInt(szSection, GMName, 0, INIFileName) + 1;
-	sprintf_s(szTemp, "%d,%s", iCount, szTime);
-	WritePrivateProfileString(szSection, GMName, szTemp, INIFileName);
+//----------------------------------------------------------------------------
+// On every enter/leave alert, and on the pulse while a command is being held or a leave confirmed
+static void RunGMCommands()
+{
+	const SettingsSnapshot& settings = s_settings.Current();
+	CommandHysteresis<std::chrono::steady_clock>::Config config;
+	config.MinState = std::chrono::seconds(settings.CmdMinState);
+	config.LeaveDelay = std::chrono::seconds(settings.CmdLeaveDelay);
+	config.MaxCommands = static_cast<uint32_t>(settings.CmdMaxPerWindow);
+	config.Window = std::chrono::seconds(settings.CmdWindow);
+	s_gmCommands.Configure(config);
+
+	const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	const CommandAction action = s_gmCommands.Update(!gmTrack->GMs.Empty(), now);
+	if (action == CommandAction::None)
+		return;
 
-	// Store GM count by Server-Zone
-	sprintf_s(szSection, "%s-%s", GetServerShortName(), pZoneInfo->LongName);
-	iCount = GetPrivateProfileInt(szSection, GMName, 0, INIFileName) + 1;
-	sprintf_s(szTemp, "%d,%s", iCount, szTime);
-	WritePrivateProfileString(szSection, GMName, szTemp, INIFileName);
+	char szTmpCmd[MAX_STRING] = { 0 };
+	strcpy_s(szTmpCmd, action == CommandAction::Enter ? settings.szGMEnterCmd.c_str() : settings.szGMLeaveCmd.c_str());
+	bool ran = false;
+	if (szTmpCmd[0] == '/' && s_conditions.Evaluate(action == CommandAction::Enter ? GMStatuses::Enter : GMStatuses::Leave, true))
+	{
+		TraceSpan span(s_trace, action == CommandAction::Enter ? "GMEnterCmd" : "GMLeaveCmd");
+		EzCommand(szTmpCmd);
+		ran = true;
+	}
+	s_gmCommands.Completed(action, ran, now);
 }
 
-static void DoGMAlert(const char* gm_name, GMStatuses status, bool test)
+static void DoGMAlert(const char* gm_name, GMStatuses status, bool test, bool owner)
 {
+	ScopedPhase phase(PerfPhase::Alert);
 	char szMsg[MAX_STRING] = { 0 };
-	std::filesystem::path sound_to_play;
+	char szTime[64];
+	// The commands below can change settings, this keeps the sound paths alive without copying them
+	const std::shared_ptr<const SettingsSnapshot> settings = s_settings.Snapshot();
+	const std::filesystem::path* sound_to_play = nullptr;
+	SoundPriority sound_priority = SoundPriority::Enter;
 	int overlay_color = CONCOLOR_RED;
-	std::string beep_sound = "SystemDefault";
+	const char* beep_sound = "SystemDefault";
 
 	if (!test && !gmTrack->IsIncludedZone())
 		return;
@@ -1005,60 +2315,64 @@ static void DoGMAlert(const char* gm_name, GMStatuses status, bool test)
 	if (!strcmp(gm_name, pLocalPlayer->Name))
 		return;
 
+	// Coalesced enter/leave alerts name several GMs
+	const bool several = strstr(gm_name, ", ") != nullptr;
+	const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
 	switch(status)
 	{
 	case GMStatuses::Enter:
-		sprintf_s(szMsg, "\arGM %s \ayhas entered the zone at \ar%s", gm_name, DisplayDT("%I:%M:%S %p").c_str());
-		sound_to_play = s_settings.Sound_GMEnter;
+		sprintf_s(szMsg, "\arGM%s %s \ay%s entered the zone at \ar%s", several ? "s" : "", gm_name, several ? "have" : "has", DisplayDT(szTime, "%I:%M:%S %p"));
+		sound_to_play = &settings->Sound_GMEnter;
 		beep_sound = "SystemAsterisk";
 		break;
 	case GMStatuses::Leave:
-		sprintf_s(szMsg, "\agGM %s \ayhas left the zone (or gone GM Invis) at \ag%s", gm_name, DisplayDT("%I:%M:%S %p").c_str());
-		sound_to_play = s_settings.Sound_GMLeave;
+		sprintf_s(szMsg, "\agGM%s %s \ay%s left the zone (or gone GM Invis) at \ag%s", several ? "s" : "", gm_name, several ? "have" : "has", DisplayDT(szTime, "%I:%M:%S %p"));
+		sound_to_play = &settings->Sound_GMLeave;
+		sound_priority = SoundPriority::Leave;
 		overlay_color = CONCOLOR_GREEN;
 		break;
 	case GMStatuses::Reminder:
 		sprintf_s(szMsg, "\arGM ALERT!!  \ayGM in zone.  \at(%s\at)", gm_name);
-		sound_to_play = s_settings.Sound_GMRemind;
+		sound_to_play = &settings->Sound_GMRemind;
+		sound_priority = SoundPriority::Remind;
 		break;
 	}
 
-	if (s_settings.m_GMChatAlertEnabled.Read())
+	if (s_settings.Current().GMChatAlertEnabled)
 		WriteChatf("%s%s", PluginMsg, szMsg);
 
-	if (test || (status == GMStatuses::Enter && !bGMCmdActive) || (status == GMStatuses::Leave && bGMCmdActive && gmTrack->GMNames.empty()))
+	if (test)
 	{
-		// TODO: This could use some cleanup -- is MCEval even necessary?
 		char szTmpCmd[MAX_STRING] = { 0 };
-		char szTmpIf[MAX_STRING] = { 0 };
-		strcpy_s(szTmpCmd, status == GMStatuses::Enter ? s_settings.szGMEnterCmd.c_str() : s_settings.szGMLeaveCmd.c_str());
-		strcpy_s(szTmpIf, status == GMStatuses::Enter ? s_settings.szGMEnterCmdIf.c_str() : s_settings.szGMLeaveCmdIf.c_str());
-		if (test)
-		{
-			const int lResult = MCEval(szTmpIf);
-			WriteChatf("%s\at(If GM %s zone): GMEnterCmdIf evaluates to %s\at.  Plugin would %s \atGMEnterCmd: \am%s",
-			PluginMsg, status == GMStatuses::Enter ? "entered" : "left",
-			lResult ? "\agTRUE" : "\arFALSE", lResult ? (szTmpCmd[0] ? (szTmpCmd[0] == '/' ? "\agEXECUTE" : "\arNOT EXECUTE") : "\arNOT EXECUTE") : "\arNOT EXECUTE",
-			szTmpCmd[0] ? (szTmpCmd[0] == '/' ? szTmpCmd : "<IGNORED>") : "<NONE>");
-		}
-		else if (szTmpCmd[0] == '/' && MCEval(szTmpIf))
-		{
-			EzCommand(szTmpCmd);
-			bGMCmdActive = status == GMStatuses::Enter;
-		}
+		strcpy_s(szTmpCmd, status == GMStatuses::Enter ? s_settings.Current().szGMEnterCmd.c_str() : s_settings.Current().szGMLeaveCmd.c_str());
+		const GMStatuses condition = status == GMStatuses::Enter ? GMStatuses::Enter : GMStatuses::Leave;
+		const bool lResult = s_conditions.Evaluate(condition, true);
+		WriteChatf("%s\at(If GM %s zone): GMEnterCmdIf evaluates to %s\at.  Plugin would %s \atGMEnterCmd: \am%s \at(command state: \ag%s\at)",
+		PluginMsg, status == GMStatuses::Enter ? "entered" : "left",
+		lResult ? "\agTRUE" : "\arFALSE", lResult ? (szTmpCmd[0] ? (szTmpCmd[0] == '/' ? "\agEXECUTE" : "\arNOT EXECUTE") : "\arNOT EXECUTE") : "\arNOT EXECUTE",
+		szTmpCmd[0] ? (szTmpCmd[0] == '/' ? szTmpCmd : "<IGNORED>") : "<NONE>", decltype(s_gmCommands)::Name(s_gmCommands.State()));
+	}
+	else if (status != GMStatuses::Reminder)
+	{
+		RunGMCommands();
 	}
 
-	if (!s_settings.m_GMQuietEnabled.Read() && s_settings.m_GMSoundEnabled.Read())
+	// Only one client plays the sound for a GM when they share state, and tests skip the limits
+	const bool sound_owner = test || owner;
+	if (!s_settings.Current().GMQuietEnabled && s_settings.Current().GMSoundEnabled && sound_to_play && sound_owner
+		&& (test || s_alertLimits.Sound.Take(now)))
 	{
-		PlayGMSound(sound_to_play);
+		s_soundWorker.Play(*sound_to_play, sound_priority);
 	}
 
-	if (!s_settings.m_GMQuietEnabled.Read() && s_settings.m_GMBeepEnabled.Read())
+	if (!s_settings.Current().GMQuietEnabled && s_settings.Current().GMBeepEnabled && sound_owner
+		&& (test || s_alertLimits.Beep.Take(now)))
 	{
-		PlayErrorSound(beep_sound.c_str());
+		PlayErrorSound(beep_sound);
 	}
 
-	if (s_settings.m_GMPopupEnabled.Read())
+	if (s_settings.Current().GMPopupEnabled && (test || s_alertLimits.Popup.Take(now)))
 	{
 		StripMQChat(szMsg, szMsg);
 		DisplayOverlayText(szMsg, overlay_color, 100, 500, 500, 3000);
@@ -1107,9 +2421,10 @@ static void GMSS(const char* szLine)
 	}
 	else
 	{
-		std::error_code ec;
-		std::filesystem::path tmp = s_settings.GetBestSoundFile(szFile);
-		if (!exists(tmp, ec))
+		s_settings.InvalidateSoundFiles();
+		const Settings::ResolvedSoundFile& sound = s_settings.GetBestSoundFile(szFile);
+		const std::filesystem::path tmp = sound.Path;
+		if (!sound.Exists)
 		{
 			WriteChatf("%s\arSound file not found (%s).  No settings changed", PluginMsg, szFile);
 		}
@@ -1132,92 +2447,170 @@ static void GMSS(const char* szLine)
 				WriteChatf("%s\arBad option (%s), usage: \at/gmcheck ss {enter|leave|remind} SoundFileName", PluginMsg, szArg);
 				return;
 			}
+			s_settings.Publish();
 		}
 	}
 }
 
-static void HistoryGMs(HistoryType histValue)
+static std::string FormatHistoryTime(int64_t Timestamp)
 {
-	// TODO: Clean up this format, left it for backwards compatibility
-
-	std::vector<std::string> vKeys;
-	char szSection[MAX_STRING] = { 0 };
-	switch (histValue)
-	{
-	case eHistory_All:
-		strcpy_s(szSection, "GM");
-		vKeys = GetPrivateProfileKeys(szSection, INIFileName);
-		break;
-	case eHistory_Server:
-		strcpy_s(szSection, GetServerShortName());
-		vKeys = GetPrivateProfileKeys(szSection, INIFileName);
-		break;
-	case eHistory_Zone:
-		sprintf_s(szSection, "%s-%s", GetServerShortName(), pZoneInfo->LongName);
-		vKeys = GetPrivateProfileKeys(szSection, INIFileName);
-		break;
-	}
+	if (!Timestamp)
+		return "UNKNOWN";
 
-	std::vector<std::string> Outputs;
-	for (const std::string& GMName : vKeys)//cycle through all the entries
-	{
-		if (GMName.empty())
-			continue;
+	char szTime[MAX_STRING] = { 0 };
+	struct tm seenDT;
+	const time_t seen = static_cast<time_t>(Timestamp);
+	localtime_s(&seenDT, &seen);
+	strftime(szTime, MAX_STRING, "%m-%d-%Y %I:%M:%S %p", &seenDT);
+	return szTime;
+}
 
-		//Collect Information for the currently listed GM.
-		char szTemp[MAX_STRING] = { 0 };
-		GetPrivateProfileString(szSection, GMName.c_str(), "", szTemp, MAX_STRING, INIFileName);
+// "mm-dd-yy", "mm-dd-yyyy" or a number of days back ("7d"), 0 if it's neither
+static int64_t ParseHistorySince(const char* szSince)
+{
+	int month = 0, day = 0, year = 0;
+	char szUnit[2] = { 0 };
+	if (sscanf_s(szSince, "%d%1s", &day, szUnit, static_cast<unsigned>(sizeof(szUnit))) == 2 && (szUnit[0] == 'd' || szUnit[0] == 'D') && day >= 0)
+		return static_cast<int64_t>(time(nullptr)) - static_cast<int64_t>(day) * 24 * 60 * 60;
+
+	if (sscanf_s(szSince, "%d-%d-%d", &month, &day, &year) != 3)
+		return 0;
+
+	struct tm sinceDT = {};
+	sinceDT.tm_year = (year < 100 ? year + 2000 : year) - 1900;
+	sinceDT.tm_mon = month - 1;
+	sinceDT.tm_mday = day;
+	sinceDT.tm_isdst = -1;
+	const time_t since = mktime(&sinceDT);
+	return since == -1 ? 0 : static_cast<int64_t>(since);
+}
 
-		//1: Count
-		char SeenCount[MAX_STRING] = { 0 };
-		GetArg(SeenCount, szTemp, 1, 0, 0, 0, ',', 0);
+// /gmcheck zone|server|all [sort name|count|last] [filter text] [since date|Nd] [page n]
+static void HistoryGMs(HistoryType histValue, const char* szLine)
+{
+	constexpr size_t PageSize = 20;
+	const char* szSection = histValue == eHistory_All ? "All" : histValue == eHistory_Server ? "Server" : "Zone";
 
-		char LastSeenDate[MAX_STRING] = { 0 };
-		char ServerName[MAX_STRING] = { 0 };
-		//All History also has the server.
-		if (histValue == eHistory_All)
+	HistoryQuery query;
+	char szFilter[MAX_STRING] = { 0 };
+	char szArg[MAX_STRING] = { 0 };
+	char szValue[MAX_STRING] = { 0 };
+	size_t page = 0;
+	for (int arg = 1; GetArg(szArg, szLine, arg), szArg[0]; arg += 2)
+	{
+		GetArg(szValue, szLine, arg + 1);
+		if (ci_equals(szArg, "sort") && ci_equals(szValue, "count"))
+			query.Sort = HistorySort::Count;
+		else if (ci_equals(szArg, "sort") && (ci_equals(szValue, "last") || ci_equals(szValue, "lastseen")))
+			query.Sort = HistorySort::LastSeen;
+		else if (ci_equals(szArg, "sort") && ci_equals(szValue, "name"))
+			query.Sort = HistorySort::Name;
+		else if (ci_equals(szArg, "filter") && szValue[0])
+			strcpy_s(szFilter, szValue);
+		else if (ci_equals(szArg, "since") && ParseHistorySince(szValue))
+			query.Since = ParseHistorySince(szValue);
+		else if (ci_equals(szArg, "page") && IsNumber(szValue) && GetIntFromString(szValue, 0) > 0)
+			page = static_cast<size_t>(GetIntFromString(szValue, 0));
+		else
 		{
-			//2: ServerName
-			GetArg(ServerName, szTemp, 2, 0, 0, 0, ',', 0);
-
-			//3: Date
-			GetArg(LastSeenDate, szTemp, 3, 0, 0, 0, ',', 0);
-		}
-		else {
-			//2: Date
-			GetArg(LastSeenDate, szTemp, 2, 0, 0, 0, ',', 0);
+			WriteChatf("%s\arBad option (%s %s), usage: \at/gmcheck %s [sort name|count|last] [filter text] [since mm-dd-yy|Nd] [page n]", PluginMsg, szArg, szValue, szSection);
+			return;
 		}
+	}
+
+	const std::string server = GetServerShortName();
+	if (histValue != eHistory_All)
+		query.Server = server;
+	if (histValue == eHistory_Zone)
+		query.Zone = pZoneInfo->LongName;
+	query.Filter = szFilter;
+	if (page)
+	{
+		query.Offset = (page - 1) * PageSize;
+		query.Limit = PageSize;
+	}
+
+	static std::vector<HistoryRow> rows;
+	const auto start = std::chrono::steady_clock::now();
+	const size_t matched = s_historyIndex.Run(query, rows);
+	const float elapsedUS = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+	// What GM's have been seen on all servers?
+	if (rows.empty())
+	{
+		WriteChatf("%s\ayWe were unable to find any history for \ag%s\ax section", PluginMsg, szSection);
+		return;
+	}
 
+	WriteChatf("\n%sHistory of GM's in \ag%s\ax section", PluginMsg, szSection);
+	char szLastSeen[MAX_STRING] = { 0 };
+	for (const HistoryRow& row : rows)
+	{
+		strcpy_s(szLastSeen, FormatHistoryTime(row.LastSeen).c_str());
+		const std::string GMName(row.GM);
 		switch (histValue)
 		{
 		case eHistory_All:
-			sprintf_s(szTemp, "%sGM \ap%s\ax - seen \a-t%s\ax times on server \a-t%s\ax, last seen \a-t%s", PluginMsg, GMName.c_str(), SeenCount, ServerName, LastSeenDate);
+			WriteChatf("%sGM \ap%s\ax - seen \a-t%llu\ax times, last on server \a-t%s\ax, last seen \a-t%s", PluginMsg, GMName.c_str(), row.Count, std::string(row.LastServer).c_str(), szLastSeen);
 			break;
 		case eHistory_Server:
-			sprintf_s(szTemp, "%sGM \ap%s\ax - seen \a-t%s\ax times on this server, last seen \a-t%s", PluginMsg, GMName.c_str(), SeenCount, LastSeenDate);
+			WriteChatf("%sGM \ap%s\ax - seen \a-t%llu\ax times on this server, last seen \a-t%s", PluginMsg, GMName.c_str(), row.Count, szLastSeen);
 			break;
 		case eHistory_Zone:
-			sprintf_s(szTemp, "%sGM \ap%s\ax - seen \a-t%s\ax times in this zone, last seen \a-t%s", PluginMsg, GMName.c_str(), SeenCount, LastSeenDate);
+			WriteChatf("%sGM \ap%s\ax - seen \a-t%llu\ax times in this zone, last seen \a-t%s", PluginMsg, GMName.c_str(), row.Count, szLastSeen);
 			break;
 		}
-
-		Outputs.push_back(szTemp);
 	}
 
-	// What GM's have been seen on all servers?
-	if (!Outputs.empty())
+	if (page)
+		WriteChatf("%s\atPage \ag%u\at of \ag%u\at (%u GMs), found in \ag%.0f\at us", PluginMsg, static_cast<uint32_t>(page),
+			static_cast<uint32_t>((matched + PageSize - 1) / PageSize), static_cast<uint32_t>(matched), elapsedUS);
+}
+
+// Reported by PollHistory once it's done
+static void GMMerge()
+{
+	if (!s_history.Merge())
+		WriteChatf("%s\arCan't merge the GM history now, the log isn't open or it's already being merged or compacted.", PluginMsg);
+}
+
+static void GMTrace(const char* szLine)
+{
+	char szArg[MAX_STRING] = { 0 };
+	GetArg(szArg, szLine, 1);
+
+	if (ci_equals(szArg, "start"))
+	{
+		s_trace.Start();
+		WriteChatf("%s\amTracing started, use \ay/gmcheck trace stop\am to save it.", PluginMsg);
+	}
+	else if (ci_equals(szArg, "stop"))
 	{
-		WriteChatf("\n%sHistory of GM's in \ag%s\ax section", PluginMsg, (histValue == eHistory_All ? "All" : histValue == eHistory_Server ? "Server" : "Zone"));
-		for (const std::string& GMInfo : Outputs)
+		if (!s_trace.Enabled())
+		{
+			WriteChatf("%s\arTracing is not running.", PluginMsg);
+			return;
+		}
+		s_trace.Stop();
+
+		std::filesystem::path trace_path = std::filesystem::path(gPathLogs) / "MQ2GMCheck.trace.json";
+		GetArg(szArg, szLine, 2);
+		if (szArg[0])
 		{
-			WriteChatf("%s", GMInfo.c_str());//already has PluginMsg input when pushed into the vector.
+			trace_path = szArg;
+			if (trace_path.is_relative())
+				trace_path = std::filesystem::path(gPathLogs) / trace_path;
 		}
+
+		if (s_trace.WriteChromeJson(trace_path))
+			WriteChatf("%s\amSaved \ag%llu\am spans (\ag%llu\am overwritten) to \ay%s", PluginMsg, s_trace.Recorded() - s_trace.Dropped(), s_trace.Dropped(), trace_path.string().c_str());
+		else
+			WriteChatf("%s\arERROR - Could not write the trace to %s", PluginMsg, trace_path.string().c_str());
 	}
-	else {
-		WriteChatf("%s\ayWe were unable to find any history for \ag%s\ax section", PluginMsg, (histValue == eHistory_All ? "All" : histValue == eHistory_Server ? "Server" : "Zone"));
+	else
+	{
+		WriteChatf("%s\atUsage: \am/gmcheck trace {start|stop} [file]", PluginMsg);
 	}
-
-	return;
 }
 
 static void GMHelp()
@@ -1232,13 +2625,18 @@ static void GMHelp()
 	WriteChatf("%s\ay/gmcheck chat [off|on]\ax: \agToggle GM alert being output to the MQ chat window, or force on/off.", PluginMsg);
 	WriteChatf("%s\ay/gmcheck corpse [off|on]\ax: \agToggle GM alert being ignored if the spawn is a corpse, or force on/off.", PluginMsg);
 	WriteChatf("%s\ay/gmcheck exclude [off|on]\ax: \agToggle GM alert being ignored if in a zone defined by ExcludeZoneList, or force on/off.", PluginMsg);
-	WriteChatf("%s\ay/gmcheck rem \ax: \agChange alert reminder interval, in seconds.  e.g.: /gmcheck rem 15 (0 to disable)", PluginMsg);
+	WriteChatf("%s\ay/gmcheck shared [off|on]\ax: \agToggle sharing GM state with the other clients on this PC (one of them records history and plays sounds), or force on/off.", PluginMsg);
+	WriteChatf("%s\ay/gmcheck rem \ax: \agChange the seconds before the first reminder for a GM, later ones back off by RemBackoff.  e.g.: /gmcheck rem 15 (0 to disable)", PluginMsg);
 	WriteChatf("%s\ay/gmcheck load \ax: \agLoad settings from INI file.", PluginMsg);
 	WriteChatf("%s\ay/gmcheck test {enter|leave|remind} \ax: Test alerts & sounds for the indicated type.  e.g.: /gmcheck test leave", PluginMsg);
 	WriteChatf("%s\ay/gmcheck ss {enter|leave|remind} SoundFileName \ax: Set the filename (wav/mp3) to play for indicated alert. Full path if sound file is not in your MQ/resources/sounds dir.", PluginMsg);
 	WriteChatf("%s\ay/gmcheck zone \ax: History of GMs in this zone.", PluginMsg);
 	WriteChatf("%s\ay/gmcheck server \ax: History of GMs on this server.", PluginMsg);
 	WriteChatf("%s\ay/gmcheck all \ax: History of GMs on all servers.", PluginMsg);
+	WriteChatf("%s\ay    [sort name|count|last] [filter text] [since mm-dd-yy|Nd] [page n] \ax: Options for the three history commands.  e.g.: /gmcheck all sort count since 30d page 1", PluginMsg);
+	WriteChatf("%s\ay/gmcheck compact \ax: Roll up old GM sightings (see HistoryRawDays and HistoryDailyDays).", PluginMsg);
+	WriteChatf("%s\ay/gmcheck merge \ax: Fold every client's GM sightings into the shared history log and reload the history.", PluginMsg);
+	WriteChatf("%s\ay/gmcheck trace {start|stop} [file] \ax: Record timing spans, and on stop save them as a Chrome trace (default MQ2GMCheck.trace.json in your logs dir).", PluginMsg);
 
 	WriteChatf("%s\ay/gmcheck help \ax: \agThis help.\n", PluginMsg);
 }
@@ -1307,12 +2705,30 @@ void GMCheckCmd(PlayerClient* pChar, char* szLine)
 		s_settings.m_ExcludeZonesEnabled.Write(!_stricmp(szArg2, "on") ? FlagOptions::On : !_stricmp(szArg2, "off") ? FlagOptions::Off : FlagOptions::Toggle);
 		gmTrack->SetExcludedZone();
 	}
+	else if (!_stricmp(szArg1, "shared"))
+	{
+		strcpy_s(szArg2, GetNextArg(szLine));
+		s_settings.m_SharedStateEnabled.Write(!_stricmp(szArg2, "on") ? FlagOptions::On : !_stricmp(szArg2, "off") ? FlagOptions::Off : FlagOptions::Toggle);
+	}
 	else if (!_stricmp(szArg1, "load"))
 	{
 		s_settings.Load();
 		GMCheckStatus();
 		WriteChatf("%s\amSettings loaded.", PluginMsg);
 	}
+	else if (!_stricmp(szArg1, "compact"))
+	{
+		if (!CompactHistory(false))
+			WriteChatf("%s\arCan't compact the GM history now, it's off (HistoryRawDays=0), already running, the ini history isn't imported yet, or the log isn't open.", PluginMsg);
+	}
+	else if (!_stricmp(szArg1, "merge"))
+	{
+		GMMerge();
+	}
+	else if (!_stricmp(szArg1, "trace"))
+	{
+		GMTrace(GetNextArg(szLine));
+	}
 	else if (!_stricmp(szArg1, "help"))
 	{
 		GMHelp();
@@ -1323,48 +2739,40 @@ void GMCheckCmd(PlayerClient* pChar, char* szLine)
 	}
 	else if (!_stricmp(szArg1, "Zone"))
 	{
-		HistoryGMs(eHistory_Zone);
+		HistoryGMs(eHistory_Zone, GetNextArg(szLine));
 	}
 	else if (!_stricmp(szArg1, "Server"))
 	{
-		HistoryGMs(eHistory_Server);
+		HistoryGMs(eHistory_Server, GetNextArg(szLine));
 	}
 	else if (!_stricmp(szArg1, "All"))
 	{
-		HistoryGMs(eHistory_All);
+		HistoryGMs(eHistory_All, GetNextArg(szLine));
 	}
 	else
 		GMCheckStatus(true);
 }
 
-static void SetupVolumesFromINI()
+static void SetupVolumes()
 {
-	//LeftVolume
-	int i = GetPrivateProfileInt("Settings", "LeftVolume", -1, INIFileName);
-	if (i > 100 || i < 0)
-	{
-		i = 50;
-		WritePrivateProfileInt("Settings", "LeftVolume", i, INIFileName);
-	}
+	float x = 65535.0f * (static_cast<float>(s_settings.Current().LeftVolume) / 100.0f);
+	uint32_t NewVol = static_cast<uint32_t>(x);
 
-	float x = 65535.0f * (static_cast<float>(i) / 100.0f);
-	NewVol = static_cast<DWORD>(x);
-
-	//RightVolume
-	i = GetPrivateProfileInt("Settings", "RightVolume", -1, INIFileName);
-	if (i > 100 || i < 0)
-	{
-		i = 50;
-		WritePrivateProfileInt("Settings", "RightVolume", i, INIFileName);
-	}
+	x = 65535.0f * (static_cast<float>(s_settings.Current().RightVolume) / 100.0f);
+	NewVol = NewVol + (static_cast<uint32_t>(x) << 16);
+	s_soundWorker.SetVolume(NewVol);
+}
 
-	x = 65535.0f * (static_cast<float>(i) / 100.0f);
-	NewVol = NewVol + (static_cast<DWORD>(x) << 16);
+static void PreloadSounds(const SettingsSnapshot& Snapshot)
+{
+	s_soundWorker.Preload({ Snapshot.Sound_GMEnter, Snapshot.Sound_GMLeave, Snapshot.Sound_GMRemind });
 }
 
 static void DrawGMCheckSettingsPanel()
 {
-	bool GMCheckEnabled = s_settings.m_GMCheckEnabled.Read();
+	ScopedPhase phase(PerfPhase::Panel);
+
+	bool GMCheckEnabled = s_settings.Current().GMCheckEnabled;
 	if (ImGui::Checkbox("Checking Enabled", &GMCheckEnabled))
 	{
 		s_settings.m_GMCheckEnabled.Write(GMCheckEnabled ? FlagOptions::On : FlagOptions::Off);
@@ -1372,7 +2780,7 @@ static void DrawGMCheckSettingsPanel()
 	ImGui::SameLine();
 	mq::imgui::HelpMarker("Turn GM alerting on or off");
 
-	bool GMSoundEnabled = s_settings.m_GMSoundEnabled.Read();
+	bool GMSoundEnabled = s_settings.Current().GMSoundEnabled;
 	if (ImGui::Checkbox("Sound Playing Enabled", &GMSoundEnabled))
 	{
 		s_settings.m_GMSoundEnabled.Write(GMSoundEnabled ? FlagOptions::On : FlagOptions::Off);
@@ -1380,7 +2788,7 @@ static void DrawGMCheckSettingsPanel()
 	ImGui::SameLine();
 	mq::imgui::HelpMarker("Toggle playing sounds for GM alerts, be sure to set the GM Enter/Leave/Reminder file names");
 
-	bool GMBeepEnabled = s_settings.m_GMBeepEnabled.Read();
+	bool GMBeepEnabled = s_settings.Current().GMBeepEnabled;
 	if (ImGui::Checkbox("Beep Enabled", &GMBeepEnabled))
 	{
 		s_settings.m_GMBeepEnabled.Write(GMBeepEnabled ? FlagOptions::On : FlagOptions::Off);
@@ -1388,7 +2796,7 @@ static void DrawGMCheckSettingsPanel()
 	ImGui::SameLine();
 	mq::imgui::HelpMarker("Toggle playing beeps for GM alerts");
 
-	bool GMPopupEnabled = s_settings.m_GMPopupEnabled.Read();
+	bool GMPopupEnabled = s_settings.Current().GMPopupEnabled;
 	if (ImGui::Checkbox("Popup Enabled", &GMPopupEnabled))
 	{
 		s_settings.m_GMPopupEnabled.Write(GMPopupEnabled ? FlagOptions::On : FlagOptions::Off);
@@ -1396,7 +2804,7 @@ static void DrawGMCheckSettingsPanel()
 	ImGui::SameLine();
 	mq::imgui::HelpMarker("Toggle showing popup messages for GM alerts");
 
-	bool GMCorpseEnabled = s_settings.m_GMCorpseEnabled.Read();
+	bool GMCorpseEnabled = s_settings.Current().GMCorpseEnabled;
 	if (ImGui::Checkbox("Include Corpses", &GMCorpseEnabled))
 	{
 		s_settings.m_GMCorpseEnabled.Write(GMCorpseEnabled ? FlagOptions::On : FlagOptions::Off);
@@ -1404,7 +2812,7 @@ static void DrawGMCheckSettingsPanel()
 	ImGui::SameLine();
 	mq::imgui::HelpMarker("Toggle GM alert being ignored if the spawn is a corpse");
 
-	bool GMChatAlertEnabled = s_settings.m_GMChatAlertEnabled.Read();
+	bool GMChatAlertEnabled = s_settings.Current().GMChatAlertEnabled;
 	if (ImGui::Checkbox("Alert in MQ Chat", &GMChatAlertEnabled))
 	{
 		s_settings.m_GMChatAlertEnabled.Write(GMChatAlertEnabled ? FlagOptions::On : FlagOptions::Off);
@@ -1412,7 +2820,7 @@ static void DrawGMCheckSettingsPanel()
 	ImGui::SameLine();
 	mq::imgui::HelpMarker("Toggle GM alert being output to the MQ chat window");
 
-	bool ExcludeZonesEnabled = s_settings.m_ExcludeZonesEnabled.Read();
+	bool ExcludeZonesEnabled = s_settings.Current().ExcludeZonesEnabled;
 	if (ImGui::Checkbox("Exclude Zones", &ExcludeZonesEnabled))
 	{
 		s_settings.m_ExcludeZonesEnabled.Write(ExcludeZonesEnabled ? FlagOptions::On : FlagOptions::Off);
@@ -1421,39 +2829,34 @@ static void DrawGMCheckSettingsPanel()
 	ImGui::SameLine();
 	mq::imgui::HelpMarker("Toggle GM alerts being excluded for zones defined in ExcludeZoneList");
 
-	int GMReminderInterval = s_settings.GetReminderInterval();
-	if (ImGui::SliderInt("Reminder Interval", &GMReminderInterval, 0, 600))
+	bool SharedStateEnabled = s_settings.Current().SharedStateEnabled;
+	if (ImGui::Checkbox("Share With Other Clients", &SharedStateEnabled))
 	{
-		s_settings.SetReminderInterval(GMReminderInterval);
+		s_settings.m_SharedStateEnabled.Write(SharedStateEnabled ? FlagOptions::On : FlagOptions::Off);
 	}
 	ImGui::SameLine();
-	mq::imgui::HelpMarker("Set GM reminder interval, in seconds, 0 to disable reminders");
+	mq::imgui::HelpMarker("Share GMs seen with the other clients on this PC, so only one of them records history and plays sounds");
 
-	int LeftVolume = GetPrivateProfileInt("Settings", "LeftVolume", -1, INIFileName);
-	if (LeftVolume > 100 || LeftVolume < 0)
+	int GMReminderInterval = s_settings.Current().ReminderInterval;
+	if (ImGui::SliderInt("Reminder Interval", &GMReminderInterval, 0, 600))
 	{
-		LeftVolume = 50;
-		WritePrivateProfileInt("Settings", "LeftVolume", LeftVolume, INIFileName);
+		s_settings.SetReminderInterval(GMReminderInterval);
 	}
+	ImGui::SameLine();
+	mq::imgui::HelpMarker("Set GM reminder interval, in seconds, 0 to disable reminders");
 
+	int LeftVolume = s_settings.Current().LeftVolume;
 	if (ImGui::SliderInt("Left Volume", &LeftVolume, 0, 100))
 	{
-		WritePrivateProfileInt("Settings", "LeftVolume", LeftVolume, INIFileName);
-		SetupVolumesFromINI();
+		s_settings.SetVolume(LeftVolume, s_settings.Current().RightVolume);
 	}
 	ImGui::SameLine();
 	mq::imgui::HelpMarker("Set the volume for alert sounds for the left speaker");
 
-	int RightVolume = GetPrivateProfileInt("Settings", "RightVolume", -1, INIFileName);
-	if (RightVolume > 100 || RightVolume < 0)
-	{
-		RightVolume = 50;
-		WritePrivateProfileInt("Settings", "RightVolume", RightVolume, INIFileName);
-	}
+	int RightVolume = s_settings.Current().RightVolume;
 	if (ImGui::SliderInt("Right Volume", &RightVolume, 0, 100))
 	{
-		WritePrivateProfileInt("Settings", "RightVolume", RightVolume, INIFileName);
-		SetupVolumesFromINI();
+		s_settings.SetVolume(s_settings.Current().LeftVolume, RightVolume);
 	}
 	ImGui::SameLine();
 	mq::imgui::HelpMarker("Set the volume for alert sounds for the right speaker");
@@ -1461,37 +2864,43 @@ static void DrawGMCheckSettingsPanel()
 	ImGui::NewLine();
 
 	static char szSoundGMEnter[MAX_STRING] = { 0 };
-	strcpy_s(szSoundGMEnter, MAX_STRING, s_settings.Sound_GMEnter.string().c_str());
+	strcpy_s(szSoundGMEnter, MAX_STRING, s_settings.Current().Sound_GMEnter.string().c_str());
 	ImGui::SetNextItemWidth(320.0f);
 	if (ImGui::InputText("GM Enter Sound", szSoundGMEnter, MAX_STRING, ImGuiInputTextFlags_EnterReturnsTrue) && strlen(szSoundGMEnter) > 0)
 	{
 		WriteChatf("Set GM Enter Sound to:  \ay%s\ax", szSoundGMEnter);
 		s_settings.Sound_GMEnter = szSoundGMEnter;
-		WritePrivateProfileString("Settings", "EnterSound", szSoundGMEnter, INIFileName);
+		s_profileStore.WriteString("Settings", "EnterSound", szSoundGMEnter);
+		s_settings.InvalidateSoundFiles();
+		s_settings.Publish();
 	}
 	ImGui::SameLine();
 	mq::imgui::HelpMarker("Set the sound (.wav or .mp3) to play when a GM enters the zone");
 
 	static char szSoundGMLeave[MAX_STRING] = { 0 };
-	strcpy_s(szSoundGMLeave, MAX_STRING, s_settings.Sound_GMLeave.string().c_str());
+	strcpy_s(szSoundGMLeave, MAX_STRING, s_settings.Current().Sound_GMLeave.string().c_str());
 	ImGui::SetNextItemWidth(320.0f);
 	if (ImGui::InputText("GM Leave Sound", szSoundGMLeave, MAX_STRING, ImGuiInputTextFlags_EnterReturnsTrue) && strlen(szSoundGMLeave) > 0)
 	{
 		WriteChatf("Set GM Enter Leave to:  \ay%s\ax", szSoundGMLeave);
 		s_settings.Sound_GMLeave = szSoundGMLeave;
-		WritePrivateProfileString("Settings", "LeaveSound", szSoundGMLeave, INIFileName);
+		s_profileStore.WriteString("Settings", "LeaveSound", szSoundGMLeave);
+		s_settings.InvalidateSoundFiles();
+		s_settings.Publish();
 	}
 	ImGui::SameLine();
 	mq::imgui::HelpMarker("Set the sound (.wav or .mp3) to play when a GM leaves the zone");
 
 	static char szSoundGMRemind[MAX_STRING] = { 0 };
-	strcpy_s(szSoundGMRemind, MAX_STRING, s_settings.Sound_GMRemind.string().c_str());
+	strcpy_s(szSoundGMRemind, MAX_STRING, s_settings.Current().Sound_GMRemind.string().c_str());
 	ImGui::SetNextItemWidth(320.0f);
 	if (ImGui::InputText("GM Reminder Sound", szSoundGMRemind, MAX_STRING, ImGuiInputTextFlags_EnterReturnsTrue) && strlen(szSoundGMRemind) > 0)
 	{
 		WriteChatf("Set GM Enter Reminder to:  \ay%s\ax", szSoundGMRemind);
 		s_settings.Sound_GMRemind = szSoundGMRemind;
-		WritePrivateProfileString("Settings", "RemindSound", szSoundGMRemind, INIFileName);
+		s_profileStore.WriteString("Settings", "RemindSound", szSoundGMRemind);
+		s_settings.InvalidateSoundFiles();
+		s_settings.Publish();
 	}
 	ImGui::SameLine();
 	mq::imgui::HelpMarker("Set the sound (.wav or .mp3) to play every 'Reminder Interval' when a GM is in zone");
@@ -1499,61 +2908,66 @@ static void DrawGMCheckSettingsPanel()
 	ImGui::NewLine();
 
 	static char szGMEnterCmd[MAX_STRING] = { 0 };
-	strcpy_s(szGMEnterCmd, s_settings.szGMEnterCmd.c_str());
+	strcpy_s(szGMEnterCmd, s_settings.Current().szGMEnterCmd.c_str());
 	ImGui::SetNextItemWidth(320.0f);
 	if (ImGui::InputText("GM Enter Cmd", szGMEnterCmd, MAX_STRING, ImGuiInputTextFlags_EnterReturnsTrue) && strlen(szGMEnterCmd) > 0)
 	{
 		WriteChatf("Set GMEnterCmd to:  \ay%s\ax", szGMEnterCmd);
 		s_settings.szGMEnterCmd = szGMEnterCmd;
-		WritePrivateProfileString("Settings", "GMEnterCmd", szGMEnterCmd, INIFileName);
+		s_profileStore.WriteString("Settings", "GMEnterCmd", szGMEnterCmd);
+		s_settings.Publish();
 	}
 	ImGui::SameLine();
 	mq::imgui::HelpMarker("Set the command to execute when a GM enters the zone");
 
 	static char szGMEnterCmdIf[MAX_STRING] = { 0 };
-	strcpy_s(szGMEnterCmdIf, s_settings.szGMEnterCmdIf.c_str());
+	strcpy_s(szGMEnterCmdIf, s_settings.Current().szGMEnterCmdIf.c_str());
 	ImGui::SetNextItemWidth(320.0f);
 	if (ImGui::InputText("GM Enter CmdIf", szGMEnterCmdIf, MAX_STRING, ImGuiInputTextFlags_EnterReturnsTrue) && strlen(szGMEnterCmdIf) > 0)
 	{
 		WriteChatf("Set GMEnterCmdIf to:  \ay%s\ax", szGMEnterCmdIf);
 		s_settings.szGMEnterCmdIf = szGMEnterCmdIf;
-		WritePrivateProfileString("Settings", "GMEnterCmdIf", szGMEnterCmdIf, INIFileName);
+		s_profileStore.WriteString("Settings", "GMEnterCmdIf", szGMEnterCmdIf);
+		s_settings.Publish();
 	}
 	ImGui::SameLine();
 	mq::imgui::HelpMarker("Set any conditions to evaluate whether the GM Enter Cmd is executed when a GM enters the zone");
 
 	static char szGMLeaveCmd[MAX_STRING] = { 0 };
-	strcpy_s(szGMLeaveCmd, s_settings.szGMLeaveCmd.c_str());
+	strcpy_s(szGMLeaveCmd, s_settings.Current().szGMLeaveCmd.c_str());
 	ImGui::SetNextItemWidth(320.0f);
 	if (ImGui::InputText("GM Leave Cmd", szGMLeaveCmd, MAX_STRING, ImGuiInputTextFlags_EnterReturnsTrue) && strlen(szGMLeaveCmd) > 0)
 	{
 		WriteChatf("Set GMLeaveCmd to:  \ay%s\ax", szGMLeaveCmd);
 		s_settings.szGMLeaveCmd = szGMLeaveCmd;
-		WritePrivateProfileString("Settings", "GMLeaveCmd", szGMLeaveCmd, INIFileName);
+		s_profileStore.WriteString("Settings", "GMLeaveCmd", szGMLeaveCmd);
+		s_settings.Publish();
 	}
 	ImGui::SameLine();
 	mq::imgui::HelpMarker("Set the command to execute when a GM leaves the zone");
 
 	static char szGMLeaveCmdIf[MAX_STRING] = { 0 };
-	strcpy_s(szGMLeaveCmdIf, s_settings.szGMLeaveCmdIf.c_str());
+	strcpy_s(szGMLeaveCmdIf, s_settings.Current().szGMLeaveCmdIf.c_str());
 	ImGui::SetNextItemWidth(320.0f);
 	if (ImGui::InputText("GM Leave CmdIf", szGMLeaveCmdIf, MAX_STRING, ImGuiInputTextFlags_EnterReturnsTrue) && strlen(szGMLeaveCmdIf) > 0)
 	{
 		WriteChatf("Set GMLeaveCmdIf to:  \ay%s\ax", szGMLeaveCmdIf);
 		s_settings.szGMLeaveCmdIf = szGMLeaveCmdIf;
-		WritePrivateProfileString("Settings", "GMLeaveCmdIf", szGMLeaveCmdIf, INIFileName);
+		s_profileStore.WriteString("Settings", "GMLeaveCmdIf", szGMLeaveCmdIf);
+		s_settings.Publish();
 	}
 	ImGui::SameLine();
 	mq::imgui::HelpMarker("Set any conditions to evaluate whether the GM Leave Cmd is executed when a GM leaves the zone");
 
 	static char szGMExcludeZones[MAX_STRING] = { 0 };
-	strcpy_s(szGMExcludeZones, s_settings.szExcludeZones.c_str());
+	strcpy_s(szGMExcludeZones, s_settings.Current().szExcludeZones.c_str());
 	ImGui::SetNextItemWidth(320.0f);
 	if (ImGui::InputText("Exclude Zone List", szGMExcludeZones, MAX_STRING, ImGuiInputTextFlags_EnterReturnsTrue) && strlen(szGMExcludeZones) > 0)
 	{
 		WriteChatf("Set ExcludeZoneList to:  \ay%s\ax", szGMExcludeZones);
 		s_settings.szExcludeZones = szGMExcludeZones;
-		WritePrivateProfileString("Settings", "ExcludeZoneList", szGMExcludeZones, INIFileName);
+		s_profileStore.WriteString("Settings", "ExcludeZoneList", szGMExcludeZones);
+		s_settings.Publish();
 		gmTrack->SetExcludedZone();
 	}
 	ImGui::SameLine();
@@ -1576,22 +2990,59 @@ static void DrawGMCheckSettingsPanel()
 	}
 	ImGui::SameLine();
 	mq::imgui::HelpMarker("Resets all settings to default");
+
+	ImGui::NewLine();
+	if (ImGui::CollapsingHeader("Performance"))
+	{
+		if (ImGui::BeginTable("##GMCheckPerf", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+		{
+			ImGui::TableSetupColumn("Phase");
+			ImGui::TableSetupColumn("Count");
+			ImGui::TableSetupColumn("P50 (ms)");
+			ImGui::TableSetupColumn("P99 (ms)");
+			ImGui::TableSetupColumn("Max (ms)");
+			ImGui::TableHeadersRow();
+
+			for (const PerfPhaseStats& stats : s_perfPhases)
+			{
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::Text("%s", stats.Name);
+				ImGui::TableNextColumn();
+				ImGui::Text("%llu", stats.Histogram.Count());
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", stats.Histogram.Percentile(50.0) / 1000000.0);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", stats.Histogram.Percentile(99.0) / 1000000.0);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", stats.Histogram.Max() / 1000000.0);
+			}
+			ImGui::EndTable();
+		}
+	}
 }
 
 PLUGIN_API void InitializePlugin()
 {
 	DebugSpewAlways("Initializing MQ2GMCheck");
 
-	gmTrack = new GMTrack();
+	gmTrack = new GMTrack(s_spawnSource, s_alertSink);
+	s_soundWorker.Start(CreateSoundBackend());
 
-	SetupVolumesFromINI();
+	if (s_history.Start(std::filesystem::path(INIFileName).replace_extension("gmlog")))
+		s_history.Load(LoadIniHistory());
+	else
+		WriteChatf("%s\arERROR - Could not open the GM history log, GM sightings will not be recorded.", PluginMsg);
 
 	AddSettingsPanel("plugins/GMCheck", DrawGMCheckSettingsPanel);
 	s_settings.Load();
 
 	AddMQ2Data("GMCheck", MQ2GMCheckType::dataGMCheck);
-	bmMQ2GMCheck = AddMQ2Benchmark(mqplugin::PluginName);
+	RegisterPerfPhases();
 	pGMCheckType = new MQ2GMCheckType;
+	pGMCheckPerfType = new MQ2GMCheckPerfType;
+	pGMCheckGMType = new MQ2GMCheckGMType;
+	pGMCheckHistoryType = new MQ2GMCheckHistoryType;
 
 	AddCommand("/gmcheck", GMCheckCmd);
 }
@@ -1603,49 +3054,64 @@ PLUGIN_API void ShutdownPlugin()
 	RemoveCommand("/gmcheck");
 
 	RemoveMQ2Data("GMCheck");
-	RemoveMQ2Benchmark(bmMQ2GMCheck);
+	UnregisterPerfPhases();
 	delete pGMCheckType;
+	delete pGMCheckPerfType;
+	delete pGMCheckGMType;
+	delete pGMCheckHistoryType;
 
-	if (bVolSet)
-		waveOutSetVolume(nullptr, dwVolume);
+	s_soundWorker.Stop();
 
 	RemoveSettingsPanel("plugins/GMCheck");
 
+	s_sharedState.Close();
+	s_history.Stop();
 	delete gmTrack;
 }
 
 PLUGIN_API void OnPulse()
 {
+	++s_pulseNumber;
+	PollHistory();
+	SyncSharedGMs();
 	gmTrack->PlayAlerts();
+	if (s_alertCoalescer.Pending())
+		FlushGMAlerts(false);
+	if (s_gmCommands.Pending() && gGameState == GAMESTATE_INGAME && gmTrack->IsIncludedZone())
+		RunGMCommands();
+}
+
+static bool IsTrackableGM(const PlayerClient* pSpawn)
+{
+	return pSpawn->GM
+		&& pSpawn->DisplayedName[0] != '\0'
+		&& (!pLocalPlayer || pSpawn->SpawnID != pLocalPlayer->SpawnID)
+		&& (s_settings.Current().GMCorpseEnabled || pSpawn->Type != SPAWN_CORPSE);
 }
 
 PLUGIN_API void OnAddSpawn(PlayerClient* pSpawn)
 {
-	if (pLocalPC && s_settings.m_GMCheckEnabled.Read() && pSpawn && pSpawn->GM && (s_settings.m_GMCorpseEnabled.Read() || pSpawn->Type != SPAWN_CORPSE))
+	ScopedPhase phase(PerfPhase::AddSpawn);
+	if (pLocalPC && s_settings.Current().GMCheckEnabled && pSpawn && IsTrackableGM(pSpawn))
 	{
-		if (pSpawn->DisplayedName[0] != '\0')
-		{
-			gmTrack->AddGM(pSpawn->DisplayedName);
-		}
+		gmTrack->AddGM(MakeSpawnRef(pSpawn));
 	}
 }
 
 PLUGIN_API void OnRemoveSpawn(PlayerClient* pSpawn)
 {
-	if (pLocalPC && s_settings.m_GMCheckEnabled.Read() && pSpawn && pSpawn->GM && (s_settings.m_GMCorpseEnabled.Read() || pSpawn->Type != SPAWN_CORPSE))
-	{
-		if (pSpawn->DisplayedName[0] != '\0')
-		{
-			gmTrack->RemoveGM(pSpawn->DisplayedName);
-			if (gmTrack->IsIncludedZone())
-				DoGMAlert(pSpawn->DisplayedName, GMStatuses::Leave);
-		}
-	}
+	ScopedPhase phase(PerfPhase::RemoveSpawn);
+	if (pSpawn)
+		gmTrack->RemoveGM(pSpawn->SpawnID);
 }
 
 PLUGIN_API void OnBeginZone()
 {
 	gmTrack->BeginZone();
+	s_alertCoalescer.Clear();
+	s_gmCommands.Reset();
+	s_sharedState.ReleaseAll();
+	s_history.RequestFlush();
 }
 
 PLUGIN_API void OnEndZone()
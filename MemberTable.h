@@ -0,0 +1,95 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Member lookup for the TLO types: a perfect hash over the member names, built at compile
+// time, so a read is one pass over the name to hash it and one compare against the only
+// member it can be, instead of going through MQ2Type::FindMember and a switch on the ID.
+
+// MQ matches member names without regard to case.  Folding with | 0x20 is only right for
+// letters, but both sides fold the same way and the compare after it is exact.
+constexpr uint32_t MemberNameHash(const char* Name)
+{
+	uint32_t hash = 0;
+	for (; *Name; ++Name)
+		hash = hash * 31 + static_cast<unsigned char>(*Name | 0x20);
+	return hash;
+}
+
+constexpr bool MemberNameEquals(const char* A, const char* B)
+{
+	for (; *A && *B; ++A, ++B)
+	{
+		const char a = *A >= 'A' && *A <= 'Z' ? *A - 'A' + 'a' : *A;
+		const char b = *B >= 'A' && *B <= 'Z' ? *B - 'A' + 'a' : *B;
+		if (a != b)
+			return false;
+	}
+	return *A == *B;
+}
+
+// Slots holds the index + 1 of the member that hashes there, 0 for none.  A Seed of 0 means
+// no seed was found that puts every member in a slot of its own (two names hash the same).
+template <size_t Size>
+struct MemberHashTable
+{
+	static constexpr inline uint32_t Bits = Size <= 16 ? 6 : Size <= 32 ? 7 : Size <= 64 ? 8 : 9;
+	static_assert(Size < 256, "slots are a byte");
+
+	uint32_t Seed = 0;
+	std::array<uint8_t, size_t(1) << Bits> Slots{};
+
+	constexpr uint32_t Slot(uint32_t Hash) const { return (Hash * Seed) >> (32 - Bits); }
+};
+
+template <typename Entry, size_t Size>
+constexpr MemberHashTable<Size> MakeMemberHashTable(const Entry (&Members)[Size])
+{
+	std::array<uint32_t, Size> hashes{};
+	for (size_t member = 0; member < Size; ++member)
+		hashes[member] = MemberNameHash(Members[member].Name);
+
+	// With two to four times the slots there are members, an odd multiplier that spreads them
+	// out is found within a few tries
+	MemberHashTable<Size> table;
+	for (uint32_t seed = 0x9E3779B1; seed != 0x9E3779B1 + 2 * 4096; seed += 2)
+	{
+		table.Seed = seed;
+		table.Slots = {};
+		size_t member = 0;
+		for (; member < Size; ++member)
+		{
+			uint8_t& slot = table.Slots[table.Slot(hashes[member])];
+			if (slot)
+				break;
+			slot = static_cast<uint8_t>(member + 1);
+		}
+		if (member == Size)
+			return table;
+	}
+	return MemberHashTable<Size>();
+}
+
+// nullptr if there's no such member
+template <typename Entry, size_t Size>
+const Entry* FindMemberEntry(const Entry (&Members)[Size], const MemberHashTable<Size>& Table, const char* Name)
+{
+	const uint8_t slot = Table.Slots[Table.Slot(MemberNameHash(Name))];
+	if (!slot || !MemberNameEquals(Members[slot - 1].Name, Name))
+		return nullptr;
+	return &Members[slot - 1];
+}
+
+// String results are copied into the caller's buffer (DataTypeTemp), cut short if they don't fit.
+// Pointing at the string itself isn't safe, the settings snapshot and the tracker's lists can be
+// replaced before MQ is done with the result.
+inline void CopyMemberString(char* Buffer, size_t BufferSize, const char* Value)
+{
+	const size_t length = std::min(strlen(Value), BufferSize - 1);
+	memcpy(Buffer, Value, length);
+	Buffer[length] = '\0';
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+
+// Deadlines for the pulse, so a pulse with nothing due is a single compare
+template <typename Clock, typename Timer>
+class PulseScheduler
+{
+public:
+	using time_point = typename Clock::time_point;
+
+	PulseScheduler() { m_Deadlines.fill(time_point::max()); }
+
+	void Schedule(Timer Which, time_point When)
+	{
+		time_point& deadline = m_Deadlines[static_cast<size_t>(Which)];
+		const time_point previous = deadline;
+		deadline = When;
+		if (When < m_NextDue)
+			m_NextDue = When;
+		else if (previous == m_NextDue && When > previous)
+			Recompute(); // Pushed back the soonest deadline, another timer may be next now
+	}
+
+	void Cancel(Timer Which)
+	{
+		m_Deadlines[static_cast<size_t>(Which)] = time_point::max();
+		Recompute();
+	}
+
+	bool AnyDue(time_point Now) const { return Now >= m_NextDue; }
+
+	// True (and unscheduled) if the timer has come due, reschedule it when handled if it repeats
+	bool TakeDue(Timer Which, time_point Now)
+	{
+		if (Now < m_Deadlines[static_cast<size_t>(Which)])
+			return false;
+		Cancel(Which);
+		return true;
+	}
+
+private:
+	void Recompute()
+	{
+		m_NextDue = *std::min_element(m_Deadlines.begin(), m_Deadlines.end());
+	}
+
+	std::array<time_point, static_cast<size_t>(Timer::Count)> m_Deadlines;
+	time_point m_NextDue = time_point::max();
+};
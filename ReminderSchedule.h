@@ -0,0 +1,186 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+// When each GM is next due a reminder.  The first comes First after the GM's enter alert,
+// and every one after that waits Backoff times longer than the one before, up to Max.  A
+// new GM starts everybody over from First.  Deadlines are kept in a min-heap so the pulse
+// only ever looks at the soonest one; entries that were removed or rescheduled are left in
+// it and skipped when they come up.  Time only ever comes in through the arguments.
+template <typename Clock>
+class ReminderSchedule
+{
+public:
+	using time_point = typename Clock::time_point;
+	using duration = typename Clock::duration;
+
+	struct Config
+	{
+		duration First = duration::zero();  // zero turns reminders off
+		uint32_t Backoff = 1;
+		duration Max = duration::zero();    // anything under First is First
+
+		bool operator==(const Config& Other) const { return First == Other.First && Backoff == Other.Backoff && Max == Other.Max; }
+		bool operator!=(const Config& Other) const { return !(*this == Other); }
+	};
+
+	// Settings changes take effect on the waits already running
+	void Configure(const Config& Settings)
+	{
+		if (Settings == m_Config)
+			return;
+		m_Config = Settings;
+		for (auto& [key, entry] : m_Entries)
+			entry.Due = entry.From + Interval(entry.Step);
+		Rebuild();
+	}
+
+	bool Enabled() const { return m_Config.First > duration::zero(); }
+
+	// The GM was just alerted, which puts everyone back on the first interval
+	void Add(uint64_t Key, time_point Now)
+	{
+		m_Entries[Key];
+		for (auto& [key, entry] : m_Entries)
+		{
+			entry.Step = 0;
+			entry.From = Now;
+			entry.Due = Now + Interval(0);
+		}
+		Rebuild();
+	}
+
+	void Remove(uint64_t Key)
+	{
+		m_Entries.erase(Key);
+		if (m_Heap.size() > m_Entries.size() * 2 + 8)
+			Rebuild();
+		else
+			DropStale();
+	}
+
+	void Clear()
+	{
+		m_Entries.clear();
+		m_Heap.clear();
+	}
+
+	// Nothing fires before Until (after zoning)
+	void Hold(time_point Until) { m_NotBefore = Until; }
+
+	// time_point::max() if there's nothing to remind about
+	time_point NextDue() const
+	{
+		if (!Enabled() || m_Heap.empty())
+			return time_point::max();
+		return std::max(m_Heap.front().Due, m_NotBefore);
+	}
+
+	time_point Due(uint64_t Key) const
+	{
+		const auto it = m_Entries.find(Key);
+		if (!Enabled() || it == m_Entries.end())
+			return time_point::max();
+		return std::max(it->second.Due, m_NotBefore);
+	}
+
+	// Callback gets the key of every GM that's due, soonest first, and each one moves on to its next interval
+	template <typename Callback>
+	void TakeDue(time_point Now, Callback&& callback)
+	{
+		if (!Enabled() || Now < m_NotBefore)
+			return;
+
+		while (!m_Heap.empty() && m_Heap.front().Due <= Now)
+		{
+			std::pop_heap(m_Heap.begin(), m_Heap.end(), std::greater<>());
+			const Node node = m_Heap.back();
+			m_Heap.pop_back();
+
+			if (Stale(node))
+				continue;
+
+			Entry& entry = m_Entries.find(node.Key)->second;
+			if (Interval(entry.Step) < EffectiveMax())
+				++entry.Step;
+			entry.From = Now;
+			entry.Due = Now + Interval(entry.Step);
+			Push(node.Key, entry);
+			++m_Fired;
+			callback(node.Key);
+		}
+		DropStale();
+	}
+
+	uint64_t Fired() const { return m_Fired; }
+
+private:
+	struct Entry
+	{
+		uint32_t Step = 0;
+		uint64_t Generation = 0;
+		time_point From;
+		time_point Due;
+	};
+
+	struct Node
+	{
+		time_point Due;
+		uint64_t Key = 0;
+		uint64_t Generation = 0;
+
+		bool operator>(const Node& Other) const { return Due > Other.Due; }
+	};
+
+	duration EffectiveMax() const { return std::max(m_Config.Max, m_Config.First); }
+
+	duration Interval(uint32_t Step) const
+	{
+		const duration max = EffectiveMax();
+		duration interval = m_Config.First;
+		for (uint32_t i = 0; i < Step && interval < max && m_Config.Backoff > 1; ++i)
+			interval = interval > max / m_Config.Backoff ? max : interval * m_Config.Backoff;
+		return std::min(interval, max);
+	}
+
+	void Push(uint64_t Key, Entry& entry)
+	{
+		entry.Generation = ++m_Generation;
+		m_Heap.push_back({ entry.Due, Key, entry.Generation });
+		std::push_heap(m_Heap.begin(), m_Heap.end(), std::greater<>());
+	}
+
+	bool Stale(const Node& node) const
+	{
+		const auto it = m_Entries.find(node.Key);
+		return it == m_Entries.end() || it->second.Generation != node.Generation;
+	}
+
+	// Keeps the top of the heap a live entry, so NextDue is exact
+	void DropStale()
+	{
+		while (!m_Heap.empty() && Stale(m_Heap.front()))
+		{
+			std::pop_heap(m_Heap.begin(), m_Heap.end(), std::greater<>());
+			m_Heap.pop_back();
+		}
+	}
+
+	void Rebuild()
+	{
+		m_Heap.clear();
+		for (auto& [key, entry] : m_Entries)
+			Push(key, entry);
+	}
+
+	Config m_Config;
+	std::unordered_map<uint64_t, Entry> m_Entries;
+	std::vector<Node> m_Heap;
+	time_point m_NotBefore;
+	uint64_t m_Generation = 0;
+	uint64_t m_Fired = 0;
+};
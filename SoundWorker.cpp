@@ -0,0 +1,224 @@
+#include "SoundWorker.h"
+
+std::shared_ptr<const PcmSound> SoundCache::Find(const std::string& Key)
+{
+	const auto it = m_Index.find(Key);
+	if (it == m_Index.end())
+		return nullptr;
+
+	m_Entries.splice(m_Entries.begin(), m_Entries, it->second);
+	return it->second->second;
+}
+
+void SoundCache::Insert(const std::string& Key, std::shared_ptr<const PcmSound> Sound)
+{
+	if (const auto it = m_Index.find(Key); it != m_Index.end())
+	{
+		m_Bytes -= it->second->second->Bytes();
+		m_Entries.erase(it->second);
+		m_Index.erase(it);
+	}
+
+	m_Bytes += Sound->Bytes();
+	m_Entries.emplace_front(Key, std::move(Sound));
+	m_Index[Key] = m_Entries.begin();
+
+	// Never evict the sound that was just added, even if it's bigger than the cap on its own
+	while (m_Bytes > m_Limit && m_Entries.size() > 1)
+	{
+		m_Bytes -= m_Entries.back().second->Bytes();
+		m_Index.erase(m_Entries.back().first);
+		m_Entries.pop_back();
+		++m_Evictions;
+	}
+	m_Count = m_Entries.size();
+}
+
+void SoundCache::Clear()
+{
+	m_Entries.clear();
+	m_Index.clear();
+	m_Bytes = 0;
+	m_Count = 0;
+}
+
+void SoundWorker::Start(std::unique_ptr<SoundBackend> Backend)
+{
+	if (m_Thread.joinable())
+		return;
+
+	m_Backend = std::move(Backend);
+	m_Stop = false;
+	m_Thread = std::thread(&SoundWorker::Run, this);
+}
+
+void SoundWorker::Stop()
+{
+	if (!m_Thread.joinable())
+		return;
+
+	{
+		std::scoped_lock lock(m_Mutex);
+		m_Stop = true;
+	}
+	m_Wake.notify_all();
+	m_Thread.join();
+	m_Backend.reset();
+}
+
+void SoundWorker::Play(const std::filesystem::path& SoundFile, SoundPriority Priority)
+{
+	{
+		std::scoped_lock lock(m_Mutex);
+		if (m_PendingPlay && m_PendingPlay->Priority > Priority)
+		{
+			++m_SupersededCount;
+			return;
+		}
+
+		if (m_PendingPlay)
+			++m_SupersededCount;
+		m_PendingPlay = SoundJob{ SoundFile, Priority, std::chrono::steady_clock::now() };
+	}
+	m_Wake.notify_all();
+}
+
+void SoundWorker::StopSound()
+{
+	{
+		std::scoped_lock lock(m_Mutex);
+		m_PendingPlay.reset();
+		m_PendingStop = true;
+	}
+	m_Wake.notify_all();
+}
+
+void SoundWorker::SetVolume(uint32_t Volume)
+{
+	{
+		std::scoped_lock lock(m_Mutex);
+		m_PendingVolume = Volume;
+	}
+	m_Wake.notify_all();
+}
+
+void SoundWorker::Preload(std::vector<std::filesystem::path> SoundFiles)
+{
+	{
+		std::scoped_lock lock(m_Mutex);
+		m_PendingPreload = std::move(SoundFiles);
+	}
+	m_Wake.notify_all();
+}
+
+bool SoundWorker::IsPending()
+{
+	std::scoped_lock lock(m_Mutex);
+	return m_PendingPlay.has_value();
+}
+
+bool SoundWorker::TakeErrors(std::vector<std::string>& Errors)
+{
+	std::scoped_lock lock(m_Mutex);
+	if (m_Errors.empty())
+		return false;
+
+	Errors.swap(m_Errors);
+	m_Errors.clear();
+	m_HasErrors = false;
+	return true;
+}
+
+void SoundWorker::Run()
+{
+	TraceBuffer::SetThreadName("Sound");
+	m_Backend->Initialize();
+
+	// When the sound playing now ends, max() if nothing is
+	constexpr std::chrono::steady_clock::time_point NotPlaying = std::chrono::steady_clock::time_point::max();
+	std::chrono::steady_clock::time_point stop_at = NotPlaying;
+	std::unique_lock lock(m_Mutex);
+	while (true)
+	{
+		const auto ready = [this] { return m_Stop || m_PendingPlay || m_PendingStop || m_PendingVolume || !m_PendingPreload.empty(); };
+		if (stop_at != NotPlaying)
+			m_Wake.wait_until(lock, stop_at, ready);
+		else
+			m_Wake.wait(lock, ready);
+
+		if (m_Stop)
+			break;
+
+		std::optional<SoundJob> play = std::move(m_PendingPlay);
+		std::optional<uint32_t> volume = m_PendingVolume;
+		const bool stop = m_PendingStop;
+		std::vector<std::filesystem::path> preload = std::move(m_PendingPreload);
+		m_PendingPreload.clear();
+		m_PendingPlay.reset();
+		m_PendingVolume.reset();
+		m_PendingStop = false;
+		lock.unlock();
+
+		const auto now = std::chrono::steady_clock::now();
+		if (volume)
+			m_Backend->SetVolume(*volume);
+
+		if (play)
+		{
+			const float latency = std::chrono::duration<float, std::milli>(now - play->Queued).count();
+			m_LastLatencyMS = latency;
+			if (latency > m_MaxLatencyMS)
+				m_MaxLatencyMS = latency;
+			++m_PlayCount;
+
+			uint32_t length = 0;
+			std::string error;
+			bool played;
+			{
+				TraceSpan span(m_Trace, "Sound");
+				const auto start = std::chrono::steady_clock::now();
+				played = m_Backend->Play(play->SoundFile, length, error);
+				m_PlayTime.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+			}
+			if (played)
+			{
+				stop_at = now + std::min<std::chrono::milliseconds>(std::chrono::milliseconds(length), MaxPlayTime);
+			}
+			else
+			{
+				m_Backend->PlayError();
+				stop_at = now + ErrorPlayTime;
+				lock.lock();
+				m_Errors.push_back(std::move(error));
+				m_HasErrors = true;
+				lock.unlock();
+			}
+		}
+		else if (stop || (stop_at != NotPlaying && now >= stop_at))
+		{
+			TraceSpan span(m_Trace, "SoundStop");
+			m_Backend->Stop();
+			stop_at = NotPlaying;
+		}
+
+		// Done after any play so a reload never holds up an alert
+		for (const std::filesystem::path& sound_file : preload)
+		{
+			std::string error;
+			TraceSpan span(m_Trace, "SoundPreload");
+			if (!sound_file.empty() && !m_Backend->Preload(sound_file, error))
+			{
+				lock.lock();
+				m_Errors.push_back(std::move(error));
+				m_HasErrors = true;
+				lock.unlock();
+			}
+		}
+
+		lock.lock();
+	}
+	lock.unlock();
+
+	m_Backend->Stop();
+	m_Backend->Shutdown();
+}
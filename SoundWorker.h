@@ -0,0 +1,171 @@
+#pragma once
+
+#include "LatencyHistogram.h"
+#include "TraceBuffer.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Alert sound output.  A SoundBackend does the actual playing and is only ever touched
+// from the SoundWorker thread, so opening a sound (and waiting on the device) never
+// stalls the game thread.  The plugin's backend decodes and plays through Windows,
+// NullSoundBackend stands in for it everywhere else.
+enum class SoundPriority
+{
+	Remind,
+	Leave,
+	Enter,
+};
+
+// Decoded sound, always 16 bit interleaved stereo
+struct PcmSound
+{
+	uint32_t SampleRate = 0;
+	std::vector<int16_t> Samples;
+
+	size_t Frames() const { return Samples.size() / 2; }
+	size_t Bytes() const { return Samples.size() * sizeof(int16_t); }
+	uint32_t LengthMS() const { return SampleRate ? static_cast<uint32_t>(Frames() * 1000 / SampleRate) : 0; }
+};
+
+// Decoded sounds by path, least recently played are dropped once over the memory cap
+class SoundCache
+{
+public:
+	static constexpr inline size_t DefaultLimit = 16 * 1024 * 1024;
+
+	std::shared_ptr<const PcmSound> Find(const std::string& Key);
+	void Insert(const std::string& Key, std::shared_ptr<const PcmSound> Sound);
+	void Clear();
+
+	size_t Bytes() const { return m_Bytes; }
+	size_t Count() const { return m_Count; }
+	uint64_t Evictions() const { return m_Evictions; }
+
+private:
+	using Entry = std::pair<std::string, std::shared_ptr<const PcmSound>>;
+
+	std::list<Entry> m_Entries;
+	std::unordered_map<std::string, std::list<Entry>::iterator> m_Index;
+	size_t m_Limit = DefaultLimit;
+	std::atomic<size_t> m_Bytes = 0;
+	std::atomic<size_t> m_Count = 0;
+	std::atomic<uint64_t> m_Evictions = 0;
+};
+
+class SoundBackend
+{
+public:
+	virtual ~SoundBackend() = default;
+	// Called on the worker thread before/after anything else
+	virtual void Initialize() {}
+	virtual void Shutdown() {}
+	// Decodes SoundFile ahead of time so playing it doesn't have to
+	virtual bool Preload(const std::filesystem::path& /*SoundFile*/, std::string& /*Error*/) { return true; }
+	// Starts playing SoundFile, sets LengthMS to how long it will play for or Error if it can't
+	virtual bool Play(const std::filesystem::path& SoundFile, uint32_t& LengthMS, std::string& Error) = 0;
+	virtual void Stop() = 0;
+	// Volume is packed the same way as waveOutSetVolume (left in the low word)
+	virtual void SetVolume(uint32_t Volume) = 0;
+	virtual void PlayError() = 0;
+	virtual const SoundCache* GetCache() const { return nullptr; }
+};
+
+// Stand-in that plays nothing, for timing the queue without a sound device
+class NullSoundBackend : public SoundBackend
+{
+public:
+	static constexpr inline uint32_t LengthMS = 1000;
+
+	bool Play(const std::filesystem::path&, uint32_t& Length, std::string&) override
+	{
+		++PlayCount;
+		Length = LengthMS;
+		return true;
+	}
+	void Stop() override {}
+	void SetVolume(uint32_t Volume) override { LastVolume = Volume; }
+	void PlayError() override {}
+
+	// Read from other threads by the tests
+	std::atomic<uint32_t> PlayCount = 0;
+	std::atomic<uint32_t> LastVolume = 0;
+};
+
+class SoundWorker
+{
+public:
+	// Longest an alert plays for, sounds are cut to this when decoded
+	static constexpr inline std::chrono::milliseconds MaxPlayTime = std::chrono::milliseconds(9000);
+	static constexpr inline std::chrono::milliseconds ErrorPlayTime = std::chrono::milliseconds(1000);
+
+	// PlayTime gets how long each SoundBackend::Play takes
+	SoundWorker(TraceBuffer& Trace, LatencyHistogram& PlayTime) : m_Trace(Trace), m_PlayTime(PlayTime) {}
+	~SoundWorker() { Stop(); }
+	SoundWorker(const SoundWorker&) = delete;
+	SoundWorker& operator=(const SoundWorker&) = delete;
+
+	void Start(std::unique_ptr<SoundBackend> Backend);
+	void Stop();
+
+	// A queued sound is replaced by anything of the same or higher priority (enter > leave > remind)
+	void Play(const std::filesystem::path& SoundFile, SoundPriority Priority);
+	void StopSound();
+	void SetVolume(uint32_t Volume);
+	// Decodes sounds into the cache ahead of the alerts that play them
+	void Preload(std::vector<std::filesystem::path> SoundFiles);
+
+	// Anything that went wrong on the worker thread since the last call, for the pulse to report
+	bool TakeErrors(std::vector<std::string>& Errors);
+	bool HasErrors() const { return m_HasErrors; }
+
+	bool IsPending();
+	uint64_t PlayCount() const { return m_PlayCount; }
+	uint64_t SupersededCount() const { return m_SupersededCount; }
+	// From Play to the backend starting it
+	float LastLatencyMS() const { return m_LastLatencyMS; }
+	float MaxLatencyMS() const { return m_MaxLatencyMS; }
+	const SoundCache* GetCache() const { return m_Backend ? m_Backend->GetCache() : nullptr; }
+
+private:
+	struct SoundJob
+	{
+		std::filesystem::path SoundFile;
+		SoundPriority Priority = SoundPriority::Remind;
+		std::chrono::steady_clock::time_point Queued;
+	};
+
+	void Run();
+
+	TraceBuffer& m_Trace;
+	LatencyHistogram& m_PlayTime;
+	std::unique_ptr<SoundBackend> m_Backend;
+	std::optional<SoundJob> m_PendingPlay;
+	std::optional<uint32_t> m_PendingVolume;
+	std::vector<std::filesystem::path> m_PendingPreload;
+	bool m_PendingStop = false;
+	std::vector<std::string> m_Errors;
+	std::atomic<bool> m_HasErrors = false;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_Wake;
+	std::thread m_Thread;
+	bool m_Stop = false;
+
+	std::atomic<uint64_t> m_PlayCount = 0;
+	std::atomic<uint64_t> m_SupersededCount = 0;
+	std::atomic<float> m_LastLatencyMS = 0.0f;
+	std::atomic<float> m_MaxLatencyMS = 0.0f;
+};
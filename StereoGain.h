@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define GMCHECK_STEREO_GAIN_SSE2 1
+#else
+#define GMCHECK_STEREO_GAIN_SSE2 0
+#endif
+
+// Volume for the alert sounds, applied to the decoded PCM before it's played so the
+// device's own volume (shared with everything else) is left alone.  The SSE2 kernel
+// is what plays, the scalar one is what it has to match and what the benchmark runs
+// it against.
+
+// Scales interleaved stereo samples by Q15 left/right gains (32767 is full volume)
+inline void ApplyStereoGainScalar(const int16_t* pIn, int16_t* pOut, size_t Frames, int16_t LeftGain, int16_t RightGain)
+{
+	for (size_t i = 0; i < Frames * 2; i += 2)
+	{
+		pOut[i] = static_cast<int16_t>((pIn[i] * LeftGain) >> 15);
+		pOut[i + 1] = static_cast<int16_t>((pIn[i + 1] * RightGain) >> 15);
+	}
+}
+
+inline void ApplyStereoGain(const int16_t* pIn, int16_t* pOut, size_t Frames, int16_t LeftGain, int16_t RightGain)
+{
+	size_t frame = 0;
+#if GMCHECK_STEREO_GAIN_SSE2
+	const __m128i gain = _mm_set_epi16(RightGain, LeftGain, RightGain, LeftGain, RightGain, LeftGain, RightGain, LeftGain);
+	for (; frame + 4 <= Frames; frame += 4)
+	{
+		const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pIn + frame * 2));
+		// Full 32 bit products, shifted back down and packed with saturation
+		const __m128i lo = _mm_mullo_epi16(in, gain);
+		const __m128i hi = _mm_mulhi_epi16(in, gain);
+		const __m128i first = _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 15);
+		const __m128i second = _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 15);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pOut + frame * 2), _mm_packs_epi32(first, second));
+	}
+#endif
+	ApplyStereoGainScalar(pIn + frame * 2, pOut + frame * 2, Frames - frame, LeftGain, RightGain);
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <string>
+
+// Lock-free ring of finished spans for /gmcheck trace.  Any thread can record, the
+// oldest spans are overwritten once it wraps, and while tracing is off recording is
+// a single relaxed load.  Each slot carries its own sequence number so a span that
+// is being overwritten while the buffer is saved is skipped rather than torn.
+class TraceBuffer
+{
+public:
+	using clock = std::chrono::steady_clock;
+	static constexpr inline size_t DefaultCapacity = 1 << 16;
+
+	bool Enabled() const { return m_Enabled.load(std::memory_order_relaxed); }
+	uint64_t Recorded() const { return m_Next.load(std::memory_order_relaxed); }
+	uint64_t Dropped() const { const uint64_t next = Recorded(); return next > m_Capacity ? next - m_Capacity : 0; }
+
+	void Start(size_t Capacity = DefaultCapacity)
+	{
+		m_Enabled.store(false);
+		// Capacity is a power of two so the slot is just a mask
+		size_t capacity = 1;
+		while (capacity < Capacity)
+			capacity <<= 1;
+
+		if (capacity != m_Capacity)
+		{
+			m_Slots = std::make_unique<Slot[]>(capacity);
+			m_Capacity = capacity;
+		}
+		for (size_t i = 0; i < m_Capacity; ++i)
+			m_Slots[i].Sequence.store(0, std::memory_order_relaxed);
+
+		m_Epoch = clock::now();
+		m_Next.store(0);
+		m_Enabled.store(true);
+	}
+
+	void Stop()
+	{
+		m_Enabled.store(false);
+	}
+
+	// Names must be string literals (or otherwise outlive the buffer)
+	void Record(const char* Name, clock::time_point Begin, clock::time_point End)
+	{
+		if (!Enabled())
+			return;
+
+		const uint64_t index = m_Next.fetch_add(1, std::memory_order_relaxed);
+		Slot& slot = m_Slots[index & (m_Capacity - 1)];
+		slot.Sequence.store(0, std::memory_order_release);
+		slot.Name.store(Name, std::memory_order_relaxed);
+		slot.Thread.store(t_ThreadName, std::memory_order_relaxed);
+		slot.Begin.store(std::chrono::duration_cast<std::chrono::nanoseconds>(Begin - m_Epoch).count(), std::memory_order_relaxed);
+		slot.Duration.store(std::chrono::duration_cast<std::chrono::nanoseconds>(End - Begin).count(), std::memory_order_relaxed);
+		slot.Sequence.store(index + 1, std::memory_order_release);
+	}
+
+	// Names the calling thread in the trace, the thread that never calls this shows up as "Game"
+	static void SetThreadName(const char* Name) { t_ThreadName = Name; }
+
+	// Chrome trace event format, loads in chrome://tracing and ui.perfetto.dev
+	bool WriteChromeJson(const std::filesystem::path& Path) const
+	{
+		std::ofstream file(Path, std::ios::out | std::ios::trunc);
+		if (!file.is_open())
+			return false;
+
+		std::map<std::string, int> threads;
+		file << std::fixed << std::setprecision(3);
+		file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+		bool first = true;
+		const uint64_t next = Recorded();
+		for (uint64_t index = next > m_Capacity ? next - m_Capacity : 0; index < next; ++index)
+		{
+			const Slot& slot = m_Slots[index & (m_Capacity - 1)];
+			if (slot.Sequence.load(std::memory_order_acquire) != index + 1)
+				continue;
+			const char* name = slot.Name.load(std::memory_order_relaxed);
+			const char* thread = slot.Thread.load(std::memory_order_relaxed);
+			const int64_t begin = slot.Begin.load(std::memory_order_relaxed);
+			const int64_t duration = slot.Duration.load(std::memory_order_relaxed);
+			if (slot.Sequence.load(std::memory_order_acquire) != index + 1)
+				continue;
+
+			const int tid = threads.emplace(thread, static_cast<int>(threads.size())).first->second;
+			file << (first ? "" : ",") << "\n{\"name\":\"" << name << "\",\"cat\":\"MQ2GMCheck\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+				<< ",\"ts\":" << begin / 1000.0 << ",\"dur\":" << duration / 1000.0 << "}";
+			first = false;
+		}
+
+		for (const auto& [thread, tid] : threads)
+		{
+			file << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+				<< ",\"args\":{\"name\":\"" << thread << "\"}}";
+			first = false;
+		}
+		file << "\n]}\n";
+		return !file.fail();
+	}
+
+private:
+	struct Slot
+	{
+		// Fields are atomic only so a slot being overwritten while it's saved isn't a data race
+		std::atomic<uint64_t> Sequence = 0;
+		std::atomic<const char*> Name = nullptr;
+		std::atomic<const char*> Thread = nullptr;
+		std::atomic<int64_t> Begin = 0;
+		std::atomic<int64_t> Duration = 0;
+	};
+
+	static inline thread_local const char* t_ThreadName = "Game";
+
+	std::unique_ptr<Slot[]> m_Slots;
+	size_t m_Capacity = 0;
+	std::atomic<uint64_t> m_Next = 0;
+	std::atomic<bool> m_Enabled = false;
+	clock::time_point m_Epoch;
+};
+
+// Records the enclosing scope into the trace buffer, if tracing is on when it starts
+class TraceSpan
+{
+public:
+	TraceSpan(TraceBuffer& Buffer, const char* Name) : m_Buffer(Buffer), m_Name(Name)
+	{
+		if (m_Buffer.Enabled())
+			m_Begin = TraceBuffer::clock::now();
+	}
+
+	~TraceSpan()
+	{
+		if (m_Begin != TraceBuffer::clock::time_point())
+			m_Buffer.Record(m_Name, m_Begin, TraceBuffer::clock::now());
+	}
+
+	TraceSpan(const TraceSpan&) = delete;
+	TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+	TraceBuffer& m_Buffer;
+	const char* m_Name;
+	TraceBuffer::clock::time_point m_Begin;
+};
@@ -0,0 +1,416 @@
+// Benchmarks for the parts of MQ2GMCheck that run without the game.  The pulse is driven
+// against a stand-in zone (MockSpawnSource) on a fake clock at 60 frames a second, across
+// zone sizes and GM counts, the history log and index across log sizes, and the GMCheck
+// member lookup the old way (FindMember then a switch) against the hashed table, and the
+// alert sound gain kernel (SSE2 against scalar).  Every result is wall time per operation
+// and heap allocations per operation, and the run fails if a pulse allocates once the
+// first audit cycle has sized everything or the two gain kernels don't agree.
+//
+//   gmcheck_bench [--quick]
+
+#include "AllocAccounting.h"
+#include "GMHistoryIndex.h"
+#include "GMHistoryLog.h"
+#include "GMTracker.h"
+#include "MemberTable.h"
+#include "StereoGain.h"
+#include "TestSupport.h"
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std::chrono_literals;
+using BenchClock = std::chrono::steady_clock;
+using Tracker = GMTracker<FakeClock>;
+
+// Results nothing else reads are added in here so they aren't optimized away
+static volatile uint64_t s_Sink = 0;
+
+static_assert(AllocAccounting::Enabled, "the benchmark counts allocations, build it with GMCHECK_ALLOC_ACCOUNTING=1");
+
+// Alerts only counted, so the sink itself never allocates
+class CountingAlertSink : public IAlertSink
+{
+public:
+	void Sighted(const SpawnRef&) override { ++Sightings; }
+	void Removed(const SpawnRef&) override { ++Removals; }
+	void Alert(const char*, GMStatuses Status) override { ++Alerts[static_cast<size_t>(Status)]; }
+
+	uint64_t Sightings = 0;
+	uint64_t Removals = 0;
+	uint64_t Alerts[3] = {};
+};
+
+struct Measured
+{
+	uint64_t Count = 0;
+	uint64_t Nanoseconds = 0;
+	uint64_t Allocations = 0;
+
+	double PerOp() const { return Count ? static_cast<double>(Nanoseconds) / Count : 0.0; }
+	double AllocationsPerOp() const { return Count ? static_cast<double>(Allocations) / Count : 0.0; }
+};
+
+// Times Count calls of Body
+template <typename Body>
+static Measured Measure(uint64_t Count, Body&& body)
+{
+	Measured result;
+	result.Count = Count;
+	const uint64_t allocations = AllocAccounting::ThreadAllocations();
+	const BenchClock::time_point start = BenchClock::now();
+	for (uint64_t i = 0; i < Count; ++i)
+		body(i);
+	result.Nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(BenchClock::now() - start).count();
+	result.Allocations = AllocAccounting::ThreadAllocations() - allocations;
+	return result;
+}
+
+struct PulseResult
+{
+	Measured All;
+	Measured Active;
+	Measured Audit;
+	uint64_t Alerts = 0;
+};
+
+// Simulated minutes of pulses in a zone of Spawns with GMs of them GMs, after one full audit
+// cycle of warm up so the buffers are all sized
+static PulseResult RunPulses(uint32_t Spawns, uint32_t GMs, std::chrono::seconds Length)
+{
+	TraceBuffer trace;
+	MockSpawnSource zone;
+	zone.Populate(Spawns, GMs ? Spawns / GMs : 0);
+	CountingAlertSink alerts;
+	Tracker track(zone, alerts, trace, TrackerOptions(), FakeClock::now());
+	zone.ForEachGM([&track](const SpawnRef& spawn) { track.AddGM(spawn); });
+
+	uint64_t active_ns = 0;
+	const auto frame = [&track, &active_ns](uint64_t)
+		{
+			FakeClock::Advance(16ms);
+			if (track.Idle(FakeClock::now()))
+				return;
+			const BenchClock::time_point start = BenchClock::now();
+			track.Pulse(FakeClock::now());
+			active_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(BenchClock::now() - start).count();
+		};
+	const uint64_t frames = static_cast<uint64_t>(Length / 16ms);
+	Measure(static_cast<uint64_t>(Tracker::AuditInterval / 16ms) + 1, frame);
+
+	PulseResult result;
+	const uint64_t active = track.ActivePulses;
+	const uint64_t sent = alerts.Alerts[0] + alerts.Alerts[1] + alerts.Alerts[2];
+	active_ns = 0;
+	result.All = Measure(frames, frame);
+	result.Active.Count = track.ActivePulses - active;
+	result.Active.Nanoseconds = active_ns;
+	result.Alerts = alerts.Alerts[0] + alerts.Alerts[1] + alerts.Alerts[2] - sent;
+	result.Audit = Measure(100, [&track](uint64_t) { track.Audit(); });
+	return result;
+}
+
+// False if any steady state pulse allocated, which fails the run
+static bool PulseSweep(bool Quick)
+{
+	bool quiet = true;
+	std::printf("pulse (60 fps, %s simulated per row)\n", Quick ? "1 minute" : "10 minutes");
+	std::printf("%8s %6s %12s %12s %14s %12s %12s %8s\n", "spawns", "gms", "ns/pulse", "allocs/pulse", "ns/active", "active", "ns/audit", "alerts");
+	for (const uint32_t spawns : { 100u, 500u, 1000u, 2500u, 5000u })
+	{
+		for (const uint32_t gms : { 0u, 1u, 10u, 50u })
+		{
+			if (gms > spawns)
+				continue;
+			const PulseResult result = RunPulses(spawns, gms, Quick ? 60s : 600s);
+			std::printf("%8u %6u %12.1f %12.4f %14.1f %12" PRIu64 " %12.1f %8" PRIu64 "\n", spawns, gms, result.All.PerOp(), result.All.AllocationsPerOp(),
+				result.Active.PerOp(), result.Active.Count, result.Audit.PerOp(), result.Alerts);
+			quiet = quiet && result.All.Allocations == 0;
+		}
+	}
+	std::printf("\n");
+	if (!quiet)
+		std::fprintf(stderr, "FAILED: pulses allocated after the first audit cycle\n\n");
+	return quiet;
+}
+
+static HistorySighting MakeSighting(uint64_t Index, int64_t Now)
+{
+	HistorySighting sighting;
+	sighting.Event = Index % 5 ? HistoryEvent::Sighting : HistoryEvent::Leave;
+	sighting.Timestamp = Now - static_cast<int64_t>(Index) * 60;
+	sighting.GM = "Guide" + std::to_string(Index % 300);
+	sighting.Server = Index % 3 ? "server" : "other";
+	sighting.Zone = "Zone" + std::to_string(Index % 50);
+	return sighting;
+}
+
+static void HistorySweep(bool Quick)
+{
+	constexpr int64_t Now = 1700000000;
+	constexpr int64_t Day = 24 * 60 * 60;
+	TempDir dir;
+
+	std::printf("history\n");
+	std::printf("%8s %-10s %14s %12s\n", "events", "operation", "ns/op", "allocs/op");
+	const auto report = [](size_t Events, const char* Operation, const Measured& Result)
+		{
+			std::printf("%8zu %-10s %14.1f %12.2f\n", Events, Operation, Result.PerOp(), Result.AllocationsPerOp());
+		};
+
+	std::vector<size_t> sizes = { 1000, 10000, 100000 };
+	if (Quick)
+		sizes.pop_back();
+	for (const size_t events : sizes)
+	{
+		const std::filesystem::path path = dir / ("bench" + std::to_string(events) + ".gmlog").c_str();
+		std::vector<HistorySighting> sightings;
+		for (size_t i = 0; i < events; ++i)
+			sightings.push_back(MakeSighting(i, Now));
+
+		// Written the way the history thread does, in batches
+		{
+			GMHistoryLog log;
+			log.Open(path);
+			std::vector<HistorySighting> batch;
+			report(events, "append", Measure(events, [&](uint64_t i)
+				{
+					batch.push_back(sightings[i]);
+					if (batch.size() == 16 || i + 1 == events)
+					{
+						log.Append(batch);
+						batch.clear();
+					}
+				}));
+		}
+
+		GMHistoryLog log;
+		report(events, "open", Measure(1, [&](uint64_t) { log.Open(path); }));
+
+		GMHistoryIndex index;
+		report(events, "index", Measure(1, [&](uint64_t)
+			{
+				log.ForEach([&index](const HistoryEntry& entry)
+					{
+						if (entry.Event != HistoryEvent::Leave)
+							index.Add(entry.GM, entry.Server, entry.Zone, entry.Timestamp, entry.Count);
+					});
+			}));
+
+		std::vector<HistoryRow> rows;
+		HistoryQuery query;
+		query.Server = "server";
+		query.Since = Now - 7 * Day;
+		index.Run(query, rows);
+		report(events, "query", Measure(1000, [&](uint64_t) { index.Run(query, rows); }));
+
+		char name[32];
+		report(events, "lookup", Measure(100000, [&](uint64_t i)
+			{
+				snprintf(name, sizeof(name), "guide%u", static_cast<uint32_t>(i % 300));
+				s_Sink = s_Sink + index.Totals(index.FindGM(name)).Count;
+			}));
+
+		std::vector<HistorySighting> merged(sightings.begin(), sightings.begin() + std::min<size_t>(events, 1000));
+		uint32_t added = 0;
+		report(events, "merge", Measure(1, [&](uint64_t) { log.Merge(merged, 30, added); }));
+
+		HistoryCompaction compaction;
+		report(events, "compact", Measure(1, [&](uint64_t) { log.Compact(Now, { 7 * Day, 30 * Day }, compaction); }));
+		log.Close();
+	}
+	std::printf("\n");
+}
+
+// A stand-in for the GMCheck members: the same names and a mix of strings, ints and bools
+enum class BenchMember
+{
+	Beep = 1, CmdState, Corpse, Count, Enter, ExcludedZoneIDs, ExcludeZoneList, ExcludeZones, GM, GMEnterCmd,
+	GMEnterCmdIf, GMLeaveCmd, GMLeaveCmdIf, History, Interval, LastGMDate, LastGMName, LastGMTime, LastGMZone,
+	Leave, Name, Names, Perf, Popup, Quiet, Remind, Shared, SharedGMs, Sound, Status,
+};
+
+struct BenchResult
+{
+	int Int = 0;
+	const char* Ptr = nullptr;
+};
+
+static constexpr size_t BenchMaxString = 2048;
+static char s_BenchTemp[BenchMaxString];
+static const std::string s_BenchPath = "C:\\MQ\\resources\\Sounds\\gmenter.mp3";
+static const std::string s_BenchNames = "Guidea, Guideb, Guidec, Guided, Guidee, Guidef, Guideg, Guideh";
+
+static bool BenchString(BenchResult& Dest, const std::string& Value)
+{
+	CopyMemberString(s_BenchTemp, sizeof(s_BenchTemp), Value.c_str());
+	Dest.Ptr = s_BenchTemp;
+	return true;
+}
+
+static bool BenchInt(BenchResult& Dest, int Value)
+{
+	Dest.Int = Value;
+	return true;
+}
+
+struct BenchEntry
+{
+	const char* Name;
+	BenchMember ID;
+	bool (*Get)(BenchResult& Dest);
+};
+
+#define BENCH_INT(member) { #member, BenchMember::member, [](BenchResult& Dest) { return BenchInt(Dest, static_cast<int>(BenchMember::member)); } }
+#define BENCH_STRING(member, value) { #member, BenchMember::member, [](BenchResult& Dest) { return BenchString(Dest, value); } }
+static constexpr BenchEntry s_BenchMembers[] = {
+	BENCH_INT(Beep), BENCH_STRING(CmdState, s_BenchPath), BENCH_INT(Corpse), BENCH_INT(Count), BENCH_STRING(Enter, s_BenchPath),
+	BENCH_STRING(ExcludedZoneIDs, s_BenchNames), BENCH_STRING(ExcludeZoneList, s_BenchNames), BENCH_INT(ExcludeZones), BENCH_INT(GM),
+	BENCH_STRING(GMEnterCmd, s_BenchPath), BENCH_STRING(GMEnterCmdIf, s_BenchPath), BENCH_STRING(GMLeaveCmd, s_BenchPath),
+	BENCH_STRING(GMLeaveCmdIf, s_BenchPath), BENCH_INT(History), BENCH_INT(Interval), BENCH_STRING(LastGMDate, s_BenchPath),
+	BENCH_STRING(LastGMName, s_BenchPath), BENCH_STRING(LastGMTime, s_BenchPath), BENCH_STRING(LastGMZone, s_BenchPath),
+	BENCH_STRING(Leave, s_BenchPath), BENCH_INT(Name), BENCH_STRING(Names, s_BenchNames), BENCH_INT(Perf), BENCH_INT(Popup),
+	BENCH_INT(Quiet), BENCH_STRING(Remind, s_BenchPath), BENCH_INT(Shared), BENCH_INT(SharedGMs), BENCH_INT(Sound), BENCH_INT(Status),
+};
+#undef BENCH_INT
+#undef BENCH_STRING
+static constexpr MemberHashTable s_BenchMemberTable = MakeMemberHashTable(s_BenchMembers);
+static_assert(s_BenchMemberTable.Seed, "bench member names must hash apart");
+
+// How MQ2Type::FindMember keys its members, ignoring case
+struct FindMemberKeyHash
+{
+	size_t operator()(const std::string& Name) const
+	{
+		size_t hash = 14695981039346656037ull;
+		for (const char c : Name)
+			hash = (hash ^ static_cast<unsigned char>(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c)) * 1099511628211ull;
+		return hash;
+	}
+};
+
+struct FindMemberKeyEqual
+{
+	bool operator()(const std::string& A, const std::string& B) const { return MemberNameEquals(A.c_str(), B.c_str()); }
+};
+
+static void MemberSweep(bool Quick)
+{
+	std::unordered_map<std::string, int, FindMemberKeyHash, FindMemberKeyEqual> member_map;
+	for (const BenchEntry& entry : s_BenchMembers)
+		member_map.emplace(entry.Name, static_cast<int>(entry.ID));
+
+	// Names the way macros write them, not always in the table's case
+	std::vector<std::string> lookups;
+	for (const BenchEntry& entry : s_BenchMembers)
+	{
+		lookups.push_back(entry.Name);
+		std::string lower = entry.Name;
+		for (char& c : lower)
+			c = static_cast<char>(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+		lookups.push_back(lower);
+	}
+
+	const uint64_t count = Quick ? 200000 : 2000000;
+	std::printf("GMCheck members (%zu names)\n", std::size(s_BenchMembers));
+	std::printf("%-12s %12s %12s\n", "lookup", "ns/read", "allocs/read");
+	const auto report = [](const char* Lookup, const Measured& Result)
+		{
+			std::printf("%-12s %12.1f %12.4f\n", Lookup, Result.PerOp(), Result.AllocationsPerOp());
+		};
+
+	// Before: FindMember, then a switch on the ID with each string copied out
+	report("findmember", Measure(count, [&](uint64_t i)
+		{
+			BenchResult result;
+			const auto it = member_map.find(lookups[i % lookups.size()].c_str());
+			if (it == member_map.end())
+				return;
+			switch (static_cast<BenchMember>(it->second))
+			{
+			case BenchMember::Names:
+			case BenchMember::ExcludedZoneIDs:
+			case BenchMember::ExcludeZoneList:
+				BenchString(result, s_BenchNames);
+				break;
+			case BenchMember::CmdState: case BenchMember::Enter: case BenchMember::GMEnterCmd: case BenchMember::GMEnterCmdIf:
+			case BenchMember::GMLeaveCmd: case BenchMember::GMLeaveCmdIf: case BenchMember::LastGMDate: case BenchMember::LastGMName:
+			case BenchMember::LastGMTime: case BenchMember::LastGMZone: case BenchMember::Leave: case BenchMember::Remind:
+				BenchString(result, s_BenchPath);
+				break;
+			default:
+				BenchInt(result, it->second);
+				break;
+			}
+			s_Sink = s_Sink + result.Int + (result.Ptr ? result.Ptr[0] : 0);
+		}));
+
+	// After: the hashed table
+	report("table", Measure(count, [&](uint64_t i)
+		{
+			BenchResult result;
+			if (const BenchEntry* pEntry = FindMemberEntry(s_BenchMembers, s_BenchMemberTable, lookups[i % lookups.size()].c_str()))
+				pEntry->Get(result);
+			s_Sink = s_Sink + result.Int + (result.Ptr ? result.Ptr[0] : 0);
+		}));
+	std::printf("\n");
+}
+
+// Alert sounds at 44.1kHz from a short blip to the 9 second cap, at half volume on the left
+static bool GainSweep(bool Quick)
+{
+	std::printf("sound gain (%s)\n", GMCHECK_STEREO_GAIN_SSE2 ? "SSE2" : "no SSE2, both scalar");
+	std::printf("%8s %-8s %12s %12s %10s\n", "ms", "kernel", "ns/frame", "ns/sound", "speedup");
+
+	std::mt19937 random(1234);
+	std::uniform_int_distribution<int> sample(-32768, 32767);
+	bool same = true;
+	for (const size_t ms : { 250u, 2000u, 9000u })
+	{
+		const size_t frames = 44100 * ms / 1000;
+		std::vector<int16_t> in(frames * 2);
+		for (int16_t& value : in)
+			value = static_cast<int16_t>(sample(random));
+		// The extremes are where a kernel would overflow
+		in[0] = -32768;
+		in[1] = 32767;
+		std::vector<int16_t> scalar_out(in.size());
+		std::vector<int16_t> simd_out(in.size());
+
+		const uint64_t count = std::max<uint64_t>(1, (Quick ? 20000000 : 200000000) / frames);
+		const Measured scalar = Measure(count, [&](uint64_t)
+			{
+				ApplyStereoGainScalar(in.data(), scalar_out.data(), frames, 16384, 32767);
+				s_Sink = s_Sink + scalar_out[frames];
+			});
+		const Measured simd = Measure(count, [&](uint64_t)
+			{
+				ApplyStereoGain(in.data(), simd_out.data(), frames, 16384, 32767);
+				s_Sink = s_Sink + simd_out[frames];
+			});
+		same = same && scalar_out == simd_out;
+
+		std::printf("%8zu %-8s %12.3f %12.1f %10s\n", ms, "scalar", scalar.PerOp() / frames, scalar.PerOp(), "");
+		std::printf("%8zu %-8s %12.3f %12.1f %9.2fx\n", ms, "sse2", simd.PerOp() / frames, simd.PerOp(), simd.PerOp() ? scalar.PerOp() / simd.PerOp() : 0.0);
+	}
+	std::printf("\n");
+	if (!same)
+		std::fprintf(stderr, "FAILED: the SSE2 and scalar gain kernels gave different samples\n\n");
+	return same;
+}
+
+int main(int argc, char** argv)
+{
+	const bool quick = argc > 1 && !strcmp(argv[1], "--quick");
+	const bool quiet = PulseSweep(quick);
+	HistorySweep(quick);
+	MemberSweep(quick);
+	const bool gain = GainSweep(quick);
+	return quiet && gain ? 0 : 1;
+}
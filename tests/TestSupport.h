@@ -0,0 +1,179 @@
+#pragma once
+
+// Shared by the tests and benchmarks: a CHECK that keeps going (and still works with
+// NDEBUG), a clock that only moves when told to, and a stand-in spawn list and alert
+// sink for driving GMTracker without the game.
+
+#include "GMCheckCore.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+inline int& TestFailures()
+{
+	static int failures = 0;
+	return failures;
+}
+
+#define CHECK(expr) \
+	do \
+	{ \
+		if (!(expr)) \
+		{ \
+			std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #expr); \
+			++TestFailures(); \
+		} \
+	} while (0)
+
+// What main returns
+inline int TestResult(const char* Name)
+{
+	if (TestFailures())
+	{
+		std::fprintf(stderr, "%s: %d check(s) failed\n", Name, TestFailures());
+		return 1;
+	}
+	std::printf("%s: ok\n", Name);
+	return 0;
+}
+
+// A fresh directory under the temp path, removed again with everything in it
+class TempDir
+{
+public:
+	TempDir()
+	{
+		std::random_device random;
+		m_Path = std::filesystem::temp_directory_path() / ("gmcheck_test_" + std::to_string(random()));
+		std::filesystem::create_directories(m_Path);
+	}
+
+	~TempDir()
+	{
+		std::error_code ec;
+		std::filesystem::remove_all(m_Path, ec);
+	}
+
+	TempDir(const TempDir&) = delete;
+	TempDir& operator=(const TempDir&) = delete;
+
+	const std::filesystem::path& Path() const { return m_Path; }
+	std::filesystem::path operator/(const char* Name) const { return m_Path / Name; }
+
+private:
+	std::filesystem::path m_Path;
+};
+
+struct FakeClock
+{
+	using duration = std::chrono::nanoseconds;
+	using rep = duration::rep;
+	using period = duration::period;
+	using time_point = std::chrono::time_point<FakeClock>;
+	static constexpr inline bool is_steady = true;
+
+	static inline time_point Now = time_point(std::chrono::hours(1));
+	static time_point now() { return Now; }
+	static void Advance(duration By) { Now += By; }
+};
+
+// A zone's worth of spawns, some of them GMs.  Walking it for the audit looks at every spawn
+// the way the plugin walks pSpawnList, finding one by id is a lookup like GetSpawnByID.
+class MockSpawnSource : public ISpawnSource
+{
+public:
+	struct Spawn
+	{
+		std::string Name;
+		bool GM = false;
+		bool Present = false;
+	};
+
+	// SpawnIDs are 1 based, every GMEvery'th spawn is a GM (0 for none)
+	void Populate(uint32_t Spawns, uint32_t GMEvery)
+	{
+		m_Spawns.assign(Spawns + 1, Spawn());
+		for (uint32_t id = 1; id <= Spawns; ++id)
+		{
+			Spawn& spawn = m_Spawns[id];
+			spawn.GM = GMEvery && id % GMEvery == 0;
+			spawn.Name = (spawn.GM ? "Guide" : "Player") + std::to_string(id);
+			spawn.Present = true;
+		}
+	}
+
+	uint32_t Add(const std::string& Name, bool GM)
+	{
+		m_Spawns.resize(std::max<size_t>(m_Spawns.size(), 1));
+		m_Spawns.push_back({ Name, GM, true });
+		return static_cast<uint32_t>(m_Spawns.size() - 1);
+	}
+
+	void Remove(uint32_t SpawnID) { m_Spawns[SpawnID].Present = false; }
+	void SetGM(uint32_t SpawnID, bool GM) { m_Spawns[SpawnID].GM = GM; }
+	SpawnRef Ref(uint32_t SpawnID) const { return { SpawnID, m_Spawns[SpawnID].Name.c_str(), &m_Spawns[SpawnID] }; }
+	size_t Size() const { return m_Spawns.empty() ? 0 : m_Spawns.size() - 1; }
+
+	bool FindGM(uint32_t SpawnID, SpawnRef& Found) const override
+	{
+		if (SpawnID >= m_Spawns.size() || !m_Spawns[SpawnID].Present || !m_Spawns[SpawnID].GM)
+			return false;
+		Found = Ref(SpawnID);
+		return true;
+	}
+
+	void ForEachGM(const std::function<void(const SpawnRef&)>& Callback) const override
+	{
+		for (uint32_t id = 1; id < m_Spawns.size(); ++id)
+		{
+			if (m_Spawns[id].Present && m_Spawns[id].GM)
+				Callback(Ref(id));
+		}
+	}
+
+private:
+	// A deque so a spawn's address (its handle) stays put as more are added
+	std::deque<Spawn> m_Spawns;
+};
+
+// Keeps what it was told, for checking after
+class RecordingAlertSink : public IAlertSink
+{
+public:
+	struct Alerted
+	{
+		std::string Names;
+		GMStatuses Status;
+	};
+
+	void Sighted(const SpawnRef& Spawn) override { Sightings.emplace_back(Spawn.Name); }
+	void Removed(const SpawnRef& Spawn) override { Removals.emplace_back(Spawn.Name); }
+	void Alert(const char* Names, GMStatuses Status) override { Alerts.push_back({ Names, Status }); }
+
+	size_t Count(GMStatuses Status) const
+	{
+		size_t count = 0;
+		for (const Alerted& alert : Alerts)
+			count += alert.Status == Status;
+		return count;
+	}
+
+	void Clear()
+	{
+		Sightings.clear();
+		Removals.clear();
+		Alerts.clear();
+	}
+
+	std::vector<std::string> Sightings;
+	std::vector<std::string> Removals;
+	std::vector<Alerted> Alerts;
+};
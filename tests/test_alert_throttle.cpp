@@ -0,0 +1,65 @@
+#include "AlertThrottle.h"
+#include "TestSupport.h"
+
+#include <string>
+
+using namespace std::chrono_literals;
+
+int main()
+{
+	const FakeClock::time_point now = FakeClock::now();
+
+	// A burst of 3, then one every 10 seconds
+	TokenBucket<FakeClock> bucket(3, 10s);
+	int taken = 0;
+	for (int i = 0; i < 10; ++i)
+		taken += bucket.Take(now);
+	CHECK(taken == 3);
+	CHECK(bucket.Suppressed() == 7);
+	CHECK(!bucket.Take(now + 9999ms));
+	CHECK(bucket.Take(now + 10s));
+	CHECK(!bucket.Take(now + 10001ms));
+	CHECK(bucket.Take(now + 40s));
+	CHECK(bucket.Take(now + 40s));
+	CHECK(bucket.Take(now + 40s));
+	CHECK(!bucket.Take(now + 40s));
+
+	// No refill time is the shortest there is, not a division by zero
+	TokenBucket<FakeClock> unlimited(1, 0s);
+	CHECK(unlimited.Take(now));
+	CHECK(!unlimited.Take(now));
+	CHECK(unlimited.Take(now + FakeClock::duration(1)));
+
+	// Enter and leave alerts inside the window go out as one each, the older batch first
+	AlertCoalescer<FakeClock> coalescer;
+	coalescer.SetWindow(250ms);
+	std::string sent;
+	int calls = 0;
+	const auto send = [&](const char* Names, GMStatuses Status, bool Owned)
+		{
+			++calls;
+			sent += std::string(Status == GMStatuses::Enter ? "E:" : "L:") + Names + (Owned ? "*" : "") + ";";
+		};
+	coalescer.Add("A", GMStatuses::Enter, false, now);
+	coalescer.Add("B", GMStatuses::Enter, true, now + 100ms);
+	coalescer.Add("A", GMStatuses::Leave, false, now + 50ms);
+	coalescer.Flush(now + 249ms, false, send);
+	CHECK(calls == 0);
+	coalescer.Flush(now + 250ms, false, send);
+	CHECK(calls == 1 && sent == "E:A, B*;");
+	CHECK(coalescer.Pending());
+	coalescer.Flush(now + 300ms, false, send);
+	CHECK(calls == 2 && sent == "E:A, B*;L:A;");
+	CHECK(!coalescer.Pending());
+
+	// Forced flushes don't wait, a zero window never does
+	coalescer.Add("C", GMStatuses::Leave, true, now);
+	coalescer.Flush(now, true, send);
+	CHECK(calls == 3);
+	coalescer.SetWindow(0ms);
+	coalescer.Add("D", GMStatuses::Enter, true, now);
+	coalescer.Flush(now, false, send);
+	CHECK(calls == 4);
+	CHECK(coalescer.Queued() == 5 && coalescer.Sent() == 4);
+	return TestResult("test_alert_throttle");
+}
@@ -0,0 +1,123 @@
+#include "CommandHysteresis.h"
+#include "TestSupport.h"
+
+using namespace std::chrono_literals;
+using Hysteresis = CommandHysteresis<FakeClock>;
+
+static Hysteresis::Config Defaults()
+{
+	Hysteresis::Config config;
+	config.MinState = 10s;
+	config.LeaveDelay = 10s;
+	config.MaxCommands = 4;
+	config.Window = 300s;
+	return config;
+}
+
+// Runs whatever Update asks for
+static CommandAction Step(Hysteresis& Commands, bool GMsPresent, FakeClock::time_point Now)
+{
+	const CommandAction action = Commands.Update(GMsPresent, Now);
+	Commands.Completed(action, true, Now);
+	return action;
+}
+
+int main()
+{
+	const FakeClock::time_point start = FakeClock::now();
+
+	// A GM flickering in and out inside the leave delay never runs the leave command
+	{
+		Hysteresis commands;
+		commands.Configure(Defaults());
+		FakeClock::time_point now = start;
+		CHECK(Step(commands, true, now) == CommandAction::Enter);
+		for (int i = 0; i < 50; ++i)
+		{
+			now += 1s;
+			CHECK(Step(commands, false, now) == CommandAction::None);
+			now += 1s;
+			CHECK(Step(commands, true, now) == CommandAction::None);
+		}
+		CHECK(commands.Commands() == 1 && commands.Absorbed() == 50);
+		CHECK(commands.State() == CommandState::Active);
+
+		// Gone for good, the leave command runs once the delay is up
+		now += 1s;
+		CHECK(Step(commands, false, now) == CommandAction::None);
+		CHECK(commands.State() == CommandState::Leaving && commands.Pending());
+		CHECK(Step(commands, false, now + 9s) == CommandAction::None);
+		CHECK(Step(commands, false, now + 10s) == CommandAction::Leave);
+		CHECK(commands.State() == CommandState::Idle && !commands.Pending());
+	}
+
+	// No more than MaxCommands in the window, the held one runs when the window allows it
+	{
+		Hysteresis::Config config = Defaults();
+		config.MinState = 0s;
+		config.LeaveDelay = 0s;
+		Hysteresis commands;
+		commands.Configure(config);
+		FakeClock::time_point now = start;
+		CHECK(Step(commands, true, now) == CommandAction::Enter);
+		CHECK(Step(commands, false, now += 1s) == CommandAction::Leave);
+		CHECK(Step(commands, true, now += 1s) == CommandAction::Enter);
+		CHECK(Step(commands, false, now += 1s) == CommandAction::Leave);
+		CHECK(Step(commands, true, now += 1s) == CommandAction::None);
+		CHECK(commands.State() == CommandState::Entering && commands.Held() == 1);
+		while (Step(commands, true, now) == CommandAction::None)
+			now += 1s;
+		CHECK(now == start + 300s);
+	}
+
+	// A skipped enter (no command, or its condition was false) leaves nothing to undo
+	{
+		Hysteresis commands;
+		commands.Configure(Defaults());
+		const CommandAction action = commands.Update(true, start);
+		CHECK(action == CommandAction::Enter);
+		commands.Completed(action, false, start);
+		CHECK(commands.State() == CommandState::Idle && commands.Commands() == 0);
+		CHECK(commands.Update(false, start + 1s) == CommandAction::None);
+	}
+
+	// MinState runs from the change of state, a skipped leave (no GMLeaveCmd) included
+	{
+		Hysteresis::Config config = Defaults();
+		config.LeaveDelay = 0s;
+		Hysteresis commands;
+		commands.Configure(config);
+		CHECK(Step(commands, true, start) == CommandAction::Enter);
+		const CommandAction action = commands.Update(false, start + 100s);
+		CHECK(action == CommandAction::Leave);
+		commands.Completed(action, false, start + 100s);
+		CHECK(commands.State() == CommandState::Idle);
+		CHECK(Step(commands, true, start + 105s) == CommandAction::None);
+		CHECK(commands.State() == CommandState::Entering);
+		CHECK(Step(commands, true, start + 109s) == CommandAction::None);
+		CHECK(Step(commands, true, start + 110s) == CommandAction::Enter);
+
+		// A command held past MinState is timed from when it finally ran
+		CHECK(Step(commands, false, start + 115s) == CommandAction::None);
+		CHECK(commands.State() == CommandState::Leaving);
+		CHECK(Step(commands, false, start + 120s) == CommandAction::Leave);
+	}
+
+	// Zoning drops back to Idle without the leave command, the window carries over
+	{
+		Hysteresis::Config config = Defaults();
+		config.MaxCommands = 2;
+		Hysteresis commands;
+		commands.Configure(config);
+		CHECK(Step(commands, true, start) == CommandAction::Enter);
+		commands.Reset();
+		CHECK(commands.State() == CommandState::Idle && !commands.Pending());
+		CHECK(Step(commands, false, start + 20s) == CommandAction::None);
+		CHECK(Step(commands, true, start + 30s) == CommandAction::Enter);
+		commands.Reset();
+		CHECK(Step(commands, true, start + 60s) == CommandAction::None);
+		CHECK(commands.State() == CommandState::Entering && commands.Commands() == 2);
+		CHECK(Step(commands, true, start + 300s) == CommandAction::Enter);
+	}
+	return TestResult("test_command_hysteresis");
+}
@@ -0,0 +1,59 @@
+#include "GMHistoryIndex.h"
+#include "TestSupport.h"
+
+#include <vector>
+
+int main()
+{
+	GMHistoryIndex index;
+	std::vector<HistoryRow> rows;
+	index.Add("Bob", "server", "Zone A", 100, 1);
+	index.Add("Bob", "server", "Zone A", 300, 1);
+	index.Add("Bob", "server", "Zone A", 200, 5);
+	index.Add("alice", "server", "Zone B", 150, 2);
+	index.Add("Carl", "other", "Zone A", 400, 1);
+
+	HistoryQuery query;
+	CHECK(index.Run(query, rows) == 3 && rows.size() == 3);
+	CHECK(rows[0].GM == "Bob" && rows[0].Count == 7 && rows[0].LastSeen == 300);
+
+	query.Server = "server";
+	CHECK(index.Run(query, rows) == 2);
+	query.Zone = "Zone A";
+	CHECK(index.Run(query, rows) == 1 && rows[0].Count == 7);
+	query.Since = 200;
+	index.Run(query, rows);
+	CHECK(rows[0].Count == 6);
+
+	query = HistoryQuery();
+	query.Sort = HistorySort::Count;
+	index.Run(query, rows);
+	CHECK(rows[0].GM == "Bob" && rows[1].GM == "alice");
+	query.Sort = HistorySort::LastSeen;
+	index.Run(query, rows);
+	CHECK(rows[0].GM == "Carl");
+	query.Filter = "AL";
+	CHECK(index.Run(query, rows) == 1 && rows[0].GM == "alice");
+
+	query = HistoryQuery();
+	query.Offset = 1;
+	query.Limit = 1;
+	CHECK(index.Run(query, rows) == 3 && rows.size() == 1 && rows[0].GM == "Carl");
+	query = HistoryQuery();
+	query.Server = "nope";
+	CHECK(index.Run(query, rows) == 0);
+
+	// The per GM totals the TLO reads
+	const uint32_t bob = index.FindGM("bob");
+	CHECK(bob != 0);
+	CHECK(index.Totals(bob).Count == 7 && index.Totals(bob).LastSeen == 300);
+	CHECK(index.Count(bob, "server") == 7);
+	CHECK(index.Count(bob, "server", "Zone A") == 7);
+	CHECK(index.Count(bob, "other", "Zone A") == 0);
+	CHECK(index.FindGM("nobody") == 0 && index.Totals(0).Count == 0);
+	CHECK(index.Sightings() == 10);
+
+	index.Clear();
+	CHECK(index.GMCount() == 0 && index.Sightings() == 0);
+	return TestResult("test_history_index");
+}
@@ -0,0 +1,140 @@
+#include "GMHistoryLog.h"
+#include "TestSupport.h"
+
+#include <fstream>
+
+static HistorySighting Sighting(HistoryEvent Event, int64_t Timestamp, const char* GM, const char* Zone = "Zone")
+{
+	HistorySighting sighting;
+	sighting.Event = Event;
+	sighting.Timestamp = Timestamp;
+	sighting.GM = GM;
+	sighting.Server = "server";
+	sighting.Zone = Zone;
+	return sighting;
+}
+
+static uint64_t Total(GMHistoryLog& Log)
+{
+	uint64_t total = 0;
+	Log.ForEach([&total](const HistoryEntry& entry) { total += entry.Count; });
+	return total;
+}
+
+int main()
+{
+	TempDir dir;
+	const std::filesystem::path path = dir / "test.gmlog";
+	constexpr int64_t Now = 1700000000;
+	constexpr int64_t Day = 24 * 60 * 60;
+
+	// Appends survive a reopen, long names spill into more slots
+	{
+		GMHistoryLog log;
+		CHECK(log.Open(path));
+		const std::string long_zone(200, 'z');
+		CHECK(log.Append({ Sighting(HistoryEvent::Sighting, Now, "Bob"), Sighting(HistoryEvent::Sighting, Now + 1, "Alice", long_zone.c_str()) }));
+		CHECK(log.EventCount() == 2);
+	}
+	{
+		GMHistoryLog log;
+		CHECK(log.Open(path));
+		CHECK(!log.Recovered());
+		CHECK(log.EventCount() == 2);
+		std::string zone;
+		log.ForEach([&zone](const HistoryEntry& entry) { if (entry.GM == "Alice") zone = entry.Zone; });
+		CHECK(zone == std::string(200, 'z'));
+	}
+
+	// A torn write at the end is dropped when it's next opened
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::app);
+		file.write("torn", 4);
+	}
+	{
+		GMHistoryLog log;
+		CHECK(log.Open(path));
+		CHECK(log.Recovered() && log.DroppedBytes() > 0);
+		CHECK(log.EventCount() == 2);
+		CHECK(log.Append({ Sighting(HistoryEvent::Sighting, Now + 2, "Carl") }));
+	}
+	{
+		std::vector<HistorySighting> loaded;
+		CHECK(GMHistoryLog::Load(path, loaded));
+		CHECK(loaded.size() == 3);
+	}
+
+	// Merge only adds what isn't already there within the window
+	{
+		GMHistoryLog log;
+		CHECK(log.Open(path));
+		std::vector<HistorySighting> sightings = { Sighting(HistoryEvent::Sighting, Now + 10, "Bob"), Sighting(HistoryEvent::Sighting, Now + 100, "Bob"),
+			Sighting(HistoryEvent::Leave, Now + 5, "Bob") };
+		uint32_t added = 0;
+		CHECK(log.Merge(sightings, 30, added));
+		CHECK(added == 2);
+		CHECK(log.Merge(sightings, 30, added));
+		CHECK(added == 0);
+		CHECK(log.EventCount() == 5);
+	}
+
+	// Compaction rolls the old sightings up without losing any of the counts
+	{
+		const std::filesystem::path compact_path = dir / "compact.gmlog";
+		GMHistoryLog log;
+		CHECK(log.Open(compact_path));
+		std::vector<HistorySighting> sightings;
+		for (int i = 0; i < 100; ++i)
+			sightings.push_back(Sighting(HistoryEvent::Sighting, Now - i * Day / 4, i % 2 ? "Bob" : "Alice"));
+		sightings.push_back(Sighting(HistoryEvent::Leave, Now - 20 * Day, "Bob"));
+		CHECK(log.Append(sightings));
+
+		HistoryCompaction result;
+		const HistoryRetention retention = { 5 * Day, 15 * Day };
+		CHECK(log.Compact(Now, retention, result));
+		CHECK(result.Changed && result.EventsAfter < result.EventsBefore && result.BytesAfter < result.BytesBefore);
+		// The old leave is dropped, every sighting is still counted
+		CHECK(Total(log) == 100);
+		CHECK(log.Compact(Now, retention, result));
+		CHECK(!result.Changed);
+
+		CHECK(log.Append({ Sighting(HistoryEvent::Sighting, Now, "Carl") }));
+		log.Close();
+		GMHistoryLog reopened;
+		CHECK(reopened.Open(compact_path));
+		CHECK(!reopened.Recovered());
+		CHECK(Total(reopened) == 101);
+	}
+
+	// Merging a segment again after its sightings were rolled up doesn't count them twice
+	{
+		const std::filesystem::path merge_path = dir / "merge.gmlog";
+		GMHistoryLog log;
+		CHECK(log.Open(merge_path));
+		CHECK(log.CompactedBefore() == 0);
+		std::vector<HistorySighting> segment;
+		for (int i = 0; i < 100; ++i)
+			segment.push_back(Sighting(HistoryEvent::Sighting, Now - i * Day / 4, "Bob"));
+		std::vector<HistorySighting> merging = segment;
+		uint32_t added = 0;
+		CHECK(log.Merge(merging, 30, added) && added == 100);
+
+		HistoryCompaction result;
+		CHECK(log.Compact(Now, { 5 * Day, 15 * Day }, result) && result.Changed);
+		CHECK(log.CompactedBefore() == Now - 5 * Day);
+		merging = segment;
+		CHECK(log.Merge(merging, 30, added) && added == 0);
+		CHECK(Total(log) == 100);
+
+		// The cutoff is kept in the log, and newer sightings still merge
+		log.Close();
+		GMHistoryLog reopened;
+		CHECK(reopened.Open(merge_path));
+		CHECK(reopened.CompactedBefore() == Now - 5 * Day);
+		merging = segment;
+		merging.push_back(Sighting(HistoryEvent::Sighting, Now + Day, "Bob"));
+		CHECK(reopened.Merge(merging, 30, added) && added == 1);
+		CHECK(Total(reopened) == 101);
+	}
+	return TestResult("test_history_log");
+}
@@ -0,0 +1,186 @@
+#include "GMHistorySegments.h"
+#include "GMHistoryWorker.h"
+#include "TestSupport.h"
+
+#include <string>
+#include <thread>
+#if !defined(_WIN32)
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace std::chrono_literals;
+
+static HistorySighting Sighting(int64_t Timestamp, const std::string& GM, HistoryEvent Event = HistoryEvent::Sighting, uint32_t Count = 1)
+{
+	HistorySighting sighting;
+	sighting.Event = Event;
+	sighting.Timestamp = Timestamp;
+	sighting.GM = GM;
+	sighting.Server = "server";
+	sighting.Zone = "Zone";
+	sighting.Count = Count;
+	return sighting;
+}
+
+// What the plugin's pulse does, polls until the job is done
+static bool WaitForResult(HistoryWorker& Worker, HistoryJobResult& Result)
+{
+	const auto give_up = std::chrono::steady_clock::now() + 30s;
+	while (!Worker.TakeResult(Result))
+	{
+		if (std::chrono::steady_clock::now() > give_up)
+			return false;
+		std::this_thread::sleep_for(5ms);
+	}
+	return true;
+}
+
+// Sightings added while a merge is running end up in the index it hands back exactly once,
+// whether they made it into the segment it read or not
+static void CheckReplay()
+{
+	TempDir dir;
+	TraceBuffer trace;
+	HistoryWorker worker(trace);
+	CHECK(worker.Start(dir / "test.gmlog"));
+
+	int64_t now = 1700000000;
+	for (int i = 0; i < 10; ++i)
+		worker.Add(Sighting(now += 100, "Bob"));
+	CHECK(worker.Load({ Sighting(1600000000, "Old", HistoryEvent::Rollup, 5) }));
+	CHECK(worker.Busy() && !worker.Merge());
+	for (int i = 0; i < 10; ++i)
+		worker.Add(Sighting(now += 100, "Bob"));
+
+	HistoryJobResult result;
+	CHECK(WaitForResult(worker, result));
+	CHECK(result.Job == HistoryJob::Load && result.Succeeded && result.Reindexed);
+	CHECK(result.Imported == 1);
+	CHECK(result.Index.Sightings() == 25);
+	CHECK(result.Index.Totals(result.Index.FindGM("bob")).Count == 20);
+	CHECK(!worker.Busy());
+
+	// Merging everything again only finds what's already there
+	worker.Add(Sighting(now += 100, "Bob"));
+	CHECK(worker.Merge());
+	CHECK(WaitForResult(worker, result));
+	CHECK(result.Job == HistoryJob::Merge && result.Succeeded && result.Index.Sightings() == 26);
+	CHECK(worker.Merge());
+	CHECK(WaitForResult(worker, result));
+	CHECK(result.Succeeded && result.Index.Sightings() == 26 && result.Merged.Added == 0);
+	CHECK(worker.LogEventCount() == 22);
+
+	// Importing the same entries again (another client, or a load that failed after the import)
+	// adds nothing
+	CHECK(worker.Load({ Sighting(1600000000, "Old", HistoryEvent::Rollup, 5), Sighting(1600000100, "New", HistoryEvent::Rollup, 2) }));
+	CHECK(WaitForResult(worker, result));
+	CHECK(result.Succeeded && result.Imported == 1 && result.Index.Sightings() == 28);
+	CHECK(worker.LogEventCount() == 23);
+
+	// Nothing rolls up, so there's nothing to reindex
+	HistoryRetention retention;
+	retention.RawSeconds = 365 * 24 * 60 * 60;
+	retention.DailySeconds = retention.RawSeconds;
+	CHECK(worker.Compact(now, retention));
+	CHECK(WaitForResult(worker, result));
+	CHECK(result.Job == HistoryJob::Compact && result.Succeeded && !result.Compaction.Changed && !result.Reindexed);
+
+	worker.Stop();
+	CHECK(!worker.Merge());
+}
+
+// Another client holding the log's lock only holds up the history thread
+static void CheckLockHeld()
+{
+	TempDir dir;
+	const std::filesystem::path path = dir / "test.gmlog";
+	TraceBuffer trace;
+	HistoryWorker worker(trace);
+	CHECK(worker.Start(path));
+
+	HistoryJobResult result;
+	{
+		HistoryFileLock lock(std::filesystem::path(path) += ".lock", 0ms);
+		CHECK(lock.Locked());
+
+		const auto start = std::chrono::steady_clock::now();
+		CHECK(worker.Merge());
+		worker.Add(Sighting(1700000000, "Bob"));
+		worker.RequestFlush();
+		CHECK(std::chrono::steady_clock::now() - start < 100ms);
+
+		std::this_thread::sleep_for(200ms);
+		CHECK(!worker.TakeResult(result));
+	}
+	CHECK(WaitForResult(worker, result));
+	CHECK(result.Succeeded && result.Index.Sightings() == 1);
+}
+
+#if !defined(_WIN32)
+constexpr int Writers = 8;
+constexpr int Sightings = 300;
+
+// Every writer is its own process with its own segment, merging into the shared log under
+// its lock while the others keep writing.  Nothing is lost or counted twice.
+static void CheckWriters()
+{
+	TempDir dir;
+	const std::filesystem::path path = dir / "test.gmlog";
+
+	for (int writer = 0; writer < Writers; ++writer)
+	{
+		if (fork())
+			continue;
+
+		TraceBuffer trace;
+		HistoryWorker worker(trace);
+		if (!worker.Start(path))
+			_exit(2);
+
+		for (int i = 0; i < Sightings; ++i)
+		{
+			worker.Add(Sighting(1700000000 + i * 100, "GM" + std::to_string(writer) + "_" + std::to_string(i % 7)));
+			// Seen by every client at once, it's only one sighting
+			if (i == Sightings / 2)
+				worker.Add(Sighting(1600000000 + writer, "Shared"));
+
+			HistoryJobResult result;
+			if (i % 50 == 0 && (!worker.Merge() || !WaitForResult(worker, result) || !result.Succeeded))
+				_exit(3);
+		}
+		worker.Stop();
+		_exit(0);
+	}
+
+	int failed = 0;
+	int status = 0;
+	while (wait(&status) > 0)
+		failed += !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+	CHECK(failed == 0);
+
+	TraceBuffer trace;
+	HistoryWorker worker(trace);
+	CHECK(worker.Start(path));
+	CHECK(worker.Merge());
+	HistoryJobResult result;
+	CHECK(WaitForResult(worker, result));
+	CHECK(result.Succeeded);
+	CHECK(result.Index.Sightings() == Writers * Sightings + 1);
+	CHECK(result.Index.Totals(result.Index.FindGM("Shared")).Count == 1);
+	worker.Stop();
+	// A writer that finished early had its segment removed by another's merge, either way only
+	// this client's own segment is left
+	CHECK(HistorySegments::Find(path).size() == 1);
+}
+#endif
+
+int main()
+{
+	CheckReplay();
+	CheckLockHeld();
+#if !defined(_WIN32)
+	CheckWriters();
+#endif
+	return TestResult("test_history_worker");
+}
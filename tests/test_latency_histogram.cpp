@@ -0,0 +1,43 @@
+#include "LatencyHistogram.h"
+#include "TestSupport.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+int main()
+{
+	// Percentiles are never under the real value and never more than a quarter over it
+	LatencyHistogram histogram;
+	std::mt19937_64 random(1);
+	std::vector<uint64_t> values;
+	for (int i = 0; i < 100000; ++i)
+	{
+		const uint64_t value = random() % (uint64_t(1) << (random() % 40));
+		values.push_back(value);
+		histogram.Record(value);
+	}
+	std::sort(values.begin(), values.end());
+	for (const double percent : { 50.0, 90.0, 99.0, 100.0 })
+	{
+		const uint64_t exact = values[std::max<size_t>(1, static_cast<size_t>(std::ceil(values.size() * percent / 100))) - 1];
+		const uint64_t reported = histogram.Percentile(percent);
+		CHECK(reported >= exact);
+		CHECK(reported <= exact * 1.25 + 3);
+	}
+	CHECK(histogram.Count() == values.size());
+	CHECK(histogram.Max() == values.back());
+
+	// Every value lands in a bucket that reports it back exactly when it's the only one
+	for (uint64_t value = 0; value < 100000; ++value)
+	{
+		LatencyHistogram single;
+		single.Record(value);
+		CHECK(single.Percentile(50) == value);
+	}
+
+	histogram.Reset();
+	CHECK(histogram.Count() == 0 && histogram.Percentile(50) == 0 && histogram.Mean() == 0);
+	return TestResult("test_latency_histogram");
+}
@@ -0,0 +1,46 @@
+#include "PulseScheduler.h"
+#include "TestSupport.h"
+
+using namespace std::chrono_literals;
+
+enum class Timer { A, B, Count };
+
+int main()
+{
+	PulseScheduler<FakeClock, Timer> timers;
+	const FakeClock::time_point now = FakeClock::now();
+
+	CHECK(!timers.AnyDue(now));
+	CHECK(!timers.AnyDue(FakeClock::time_point::max() - 1s));
+
+	timers.Schedule(Timer::A, now + 1s);
+	timers.Schedule(Timer::B, now + 5s);
+	CHECK(!timers.AnyDue(now));
+	CHECK(timers.AnyDue(now + 1s));
+	CHECK(!timers.TakeDue(Timer::B, now + 1s));
+	CHECK(timers.TakeDue(Timer::A, now + 1s));
+	CHECK(!timers.TakeDue(Timer::A, now + 1s));
+
+	// Only B is left
+	CHECK(!timers.AnyDue(now + 4s));
+	CHECK(timers.AnyDue(now + 5s));
+
+	timers.Cancel(Timer::B);
+	CHECK(!timers.AnyDue(now + 100s));
+
+	// Moving the soonest deadline later moves the next due time with it
+	timers.Schedule(Timer::A, now + 1s);
+	timers.Schedule(Timer::B, now + 10s);
+	timers.Schedule(Timer::A, now + 20s);
+	CHECK(!timers.AnyDue(now + 1s));
+	CHECK(timers.AnyDue(now + 10s));
+	timers.Schedule(Timer::B, now + 30s);
+	CHECK(!timers.AnyDue(now + 10s));
+	CHECK(timers.AnyDue(now + 20s));
+
+	// Rescheduling a later timer leaves the soonest alone
+	timers.Schedule(Timer::B, now + 40s);
+	CHECK(!timers.AnyDue(now + 19s));
+	CHECK(timers.AnyDue(now + 20s));
+	return TestResult("test_pulse_scheduler");
+}
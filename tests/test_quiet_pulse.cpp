@@ -0,0 +1,71 @@
+#include "AllocAccounting.h"
+#include "GMTracker.h"
+#include "TestSupport.h"
+
+using namespace std::chrono_literals;
+using Tracker = GMTracker<FakeClock>;
+
+static_assert(AllocAccounting::Enabled, "test_quiet_pulse counts allocations, build it with GMCHECK_ALLOC_ACCOUNTING=1");
+
+// Alerts only counted, so the sink itself never allocates
+class CountingAlertSink : public IAlertSink
+{
+public:
+	void Sighted(const SpawnRef&) override { ++Sightings; }
+	void Removed(const SpawnRef&) override { ++Removals; }
+	void Alert(const char*, GMStatuses) override { ++Alerts; }
+
+	uint64_t Sightings = 0;
+	uint64_t Removals = 0;
+	uint64_t Alerts = 0;
+};
+
+// Every pulse that didn't change the GMs has to leave the heap alone, verifies, audits and
+// reminders included.  Only the first audit cycle (which sizes the buffers) is let off.
+static void CheckZone(uint32_t Spawns, uint32_t GMs)
+{
+	TraceBuffer trace;
+	MockSpawnSource zone;
+	zone.Populate(Spawns, GMs ? Spawns / GMs : 0);
+	CountingAlertSink alerts;
+	TrackerOptions options;
+	options.ReminderInterval = 10s;
+	Tracker track(zone, alerts, trace, options, FakeClock::now());
+	zone.ForEachGM([&track](const SpawnRef& spawn) { track.AddGM(spawn); });
+
+	const FakeClock::time_point warm = FakeClock::now() + Tracker::AuditInterval + 1s;
+	const FakeClock::time_point until = warm + 2 * Tracker::AuditInterval;
+	uint64_t allocating = 0;
+	uint64_t worst = 0;
+	while (FakeClock::now() < until)
+	{
+		FakeClock::Advance(16ms);
+		const uint64_t changes = track.GMs.Changes();
+		const uint64_t allocations = AllocAccounting::ThreadAllocations();
+		if (!track.Idle(FakeClock::now()))
+			track.Pulse(FakeClock::now());
+
+		const uint64_t made = AllocAccounting::ThreadAllocations() - allocations;
+		if (made && FakeClock::now() >= warm && changes == track.GMs.Changes())
+		{
+			++allocating;
+			worst = std::max(worst, made);
+		}
+	}
+
+	if (allocating)
+		std::fprintf(stderr, "%u spawns, %u GMs: %llu quiet pulses allocated, up to %llu each\n", Spawns, GMs,
+			static_cast<unsigned long long>(allocating), static_cast<unsigned long long>(worst));
+	CHECK(allocating == 0);
+	CHECK(GMs == 0 || alerts.Alerts > 0);
+}
+
+int main()
+{
+	for (const uint32_t spawns : { 100u, 5000u })
+	{
+		for (const uint32_t gms : { 0u, 1u, 50u })
+			CheckZone(spawns, gms);
+	}
+	return TestResult("test_quiet_pulse");
+}
@@ -0,0 +1,57 @@
+#include "GMRegistry.h"
+#include "TestSupport.h"
+
+#include <string>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+static std::vector<std::string> Names(GMRegistry& Registry)
+{
+	std::vector<std::string> names;
+	Registry.ForEach([&names](const GMEntry& entry) { names.push_back(entry.Name); });
+	return names;
+}
+
+int main()
+{
+	int a = 0, b = 0, c = 0;
+	GMRegistry registry;
+	CHECK(registry.Empty());
+
+	// A new name is a new GM, the same name in any case is the same GM on a new spawn
+	CHECK(registry.Add(10, "Bob", &a, 10s).second);
+	CHECK(!registry.Add(11, "BOB", &b, 11s).second);
+	CHECK(registry.Count() == 1);
+	CHECK(!registry.FindBySpawnID(10));
+	CHECK(registry.FindBySpawnID(11) && registry.FindBySpawnID(11)->pSpawn == &b);
+	CHECK(registry.FindByName("bob") == registry.FindBySpawnID(11));
+	CHECK(registry.FindByName("bob")->FirstSeen == 10s);
+	CHECK(registry.FindByNameHash(GMRegistry::HashName("bOb")) == registry.FindBySpawnID(11));
+	CHECK(!registry.Add(11, "Bob", &b, 11s).second);
+
+	// Listed by name whatever order they came in
+	CHECK(registry.Add(3, "Carl", &c, 3s).second);
+	CHECK(registry.Add(4, "Alice", &c, 4s).second);
+	CHECK((Names(registry) == std::vector<std::string>{ "Alice", "Bob", "Carl" }));
+
+	// Alerts pending until each is flagged, removing an unflagged one takes it off too
+	CHECK(registry.PendingAlerts() == 3);
+	registry.SetAlerted(*registry.FindByName("Bob"));
+	registry.SetAlerted(*registry.FindByName("Bob"));
+	CHECK(registry.PendingAlerts() == 2);
+	const uint64_t changes = registry.Changes();
+	CHECK(registry.Remove(3));
+	CHECK(!registry.Remove(3));
+	CHECK(registry.PendingAlerts() == 1);
+	CHECK(registry.Changes() > changes);
+	CHECK(!registry.FindByName("carl"));
+
+	// Freed slots are reused
+	CHECK(registry.Add(5, "Dave", &c, 5s).second);
+	CHECK((Names(registry) == std::vector<std::string>{ "Alice", "Bob", "Dave" }));
+
+	registry.Clear();
+	CHECK(registry.Empty() && registry.PendingAlerts() == 0 && !registry.FindBySpawnID(11));
+	return TestResult("test_registry");
+}
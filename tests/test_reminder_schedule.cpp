@@ -0,0 +1,75 @@
+#include "ReminderSchedule.h"
+#include "TestSupport.h"
+
+#include <vector>
+
+using namespace std::chrono_literals;
+using Reminders = ReminderSchedule<FakeClock>;
+
+int main()
+{
+	Reminders reminders;
+	Reminders::Config config;
+	config.First = 30s;
+	config.Backoff = 2;
+	config.Max = 600s;
+	reminders.Configure(config);
+
+	const FakeClock::time_point start = FakeClock::now();
+	CHECK(reminders.NextDue() == FakeClock::time_point::max());
+
+	// 30, then 60, 120, 240, 480 after each, then capped at 600
+	reminders.Add(1, start);
+	std::vector<long long> fired;
+	for (int second = 0; second < 3000; ++second)
+	{
+		const FakeClock::time_point now = start + std::chrono::seconds(second);
+		if (now >= reminders.NextDue())
+			reminders.TakeDue(now, [&](uint64_t Key) { CHECK(Key == 1); fired.push_back(second); });
+	}
+	CHECK((fired == std::vector<long long>{ 30, 90, 210, 450, 930, 1530, 2130, 2730 }));
+
+	// A new GM puts everyone back on the first interval
+	const FakeClock::time_point now = start + 3000s;
+	reminders.Add(2, now);
+	CHECK(reminders.Due(1) == now + 30s && reminders.Due(2) == now + 30s);
+	int due = 0;
+	reminders.TakeDue(now + 30s, [&](uint64_t) { ++due; });
+	CHECK(due == 2);
+
+	reminders.Remove(1);
+	CHECK(reminders.Due(1) == FakeClock::time_point::max());
+	CHECK(reminders.NextDue() == now + 90s);
+
+	// Settings changes retime the waits already running
+	config.Backoff = 1;
+	reminders.Configure(config);
+	CHECK(reminders.NextDue() == now + 60s);
+
+	// Nothing before the hold (zoning) runs out
+	reminders.Hold(now + 100s);
+	CHECK(reminders.NextDue() == now + 100s);
+	due = 0;
+	reminders.TakeDue(now + 70s, [&](uint64_t) { ++due; });
+	CHECK(due == 0);
+	reminders.TakeDue(now + 100s, [&](uint64_t) { ++due; });
+	CHECK(due == 1);
+
+	config.First = 0s;
+	reminders.Configure(config);
+	CHECK(!reminders.Enabled());
+	CHECK(reminders.NextDue() == FakeClock::time_point::max());
+
+	// Lots of churn still leaves the soonest deadline exact
+	config.First = 10s;
+	reminders.Configure(config);
+	reminders.Hold(now);
+	for (uint64_t key = 10; key < 1000; ++key)
+	{
+		reminders.Add(key, now);
+		reminders.Remove(key - 1);
+	}
+	CHECK(reminders.Due(999) == now + 10s && reminders.NextDue() == now + 10s);
+	CHECK(reminders.Due(998) == FakeClock::time_point::max());
+	return TestResult("test_reminder_schedule");
+}
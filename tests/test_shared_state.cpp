@@ -0,0 +1,195 @@
+#include "GMSharedState.h"
+#include "TestSupport.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <thread>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#if !defined(_WIN32)
+// A client that opens the segment while the first one is still stamping it (the magic taken
+// but the layout not written yet) waits for it instead of taking it for a different layout
+static void CheckOpenWhileStamping(const std::string& Name)
+{
+	const std::string name = "/" + Name + "_stamp";
+	const int descriptor = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);
+	CHECK(descriptor >= 0 && ftruncate(descriptor, 4096) == 0);
+	void* pMapped = mmap(nullptr, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+	CHECK(pMapped != MAP_FAILED);
+	if (descriptor < 0 || pMapped == MAP_FAILED)
+		return;
+
+	// Magic, Version and Slots lead the segment
+	auto* pHeader = static_cast<std::atomic<uint32_t>*>(pMapped);
+	pHeader[0] = ~GMSharedState::Magic;
+	std::thread stamper([pHeader]
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+			pHeader[1] = GMSharedState::Version;
+			pHeader[2] = GMSharedState::SlotCount;
+			pHeader[0] = GMSharedState::Magic;
+		});
+	GMSharedState state;
+	CHECK(state.Open(name.c_str() + 1));
+	stamper.join();
+	state.Close();
+
+	// One that never finishes only holds up the next client briefly
+	pHeader[0] = ~GMSharedState::Magic;
+	CHECK(!state.Open(name.c_str() + 1));
+
+	munmap(pMapped, 4096);
+	close(descriptor);
+	shm_unlink(name.c_str());
+}
+
+constexpr int Clients = 8;
+constexpr int GMs = 100;
+
+static std::string GMName(int GM)
+{
+	return "GM" + std::to_string(GM);
+}
+
+// Every client races to claim the same GMs, each one ends up with exactly one owner.  A
+// reader scanning the whole time never sees a half written slot.
+static void CheckClients(const std::string& Name)
+{
+	int start[2];
+	int release[2];
+	int results[2];
+	CHECK(pipe(start) == 0 && pipe(release) == 0 && pipe(results) == 0);
+
+	const auto wait_for = [](int Descriptor)
+		{
+			char c;
+			return read(Descriptor, &c, 1) == 1;
+		};
+
+	for (int client = 0; client <= Clients; ++client)
+	{
+		if (fork())
+			continue;
+
+		GMSharedState state;
+		if (!state.Open(Name.c_str()) || !wait_for(start[0]))
+			_exit(2);
+
+		int result[2] = { client, 0 };
+		if (client == Clients)
+		{
+			// The reader, counts torn entries
+			for (int scan = 0; scan < 2000; ++scan)
+			{
+				state.ForEach(static_cast<int64_t>(time(nullptr)), [&result](const GMSharedState::Entry& entry)
+					{
+						const int gm = atoi(entry.GM + 2);
+						result[1] += std::string(entry.Server) != "server" || GMName(gm) != entry.GM
+							|| entry.SpawnID != static_cast<uint32_t>(gm) || entry.ZoneID != static_cast<uint32_t>(gm % 3);
+					});
+			}
+		}
+		else
+		{
+			for (int pass = 0; pass < 20; ++pass)
+			{
+				for (int gm = 0; gm < GMs; ++gm)
+					state.Claim("server", gm % 3, GMName(gm), gm, static_cast<int64_t>(time(nullptr)));
+			}
+			for (int gm = 0; gm < GMs; ++gm)
+				result[1] += state.Owns("server", gm % 3, GMName(gm));
+		}
+
+		if (write(results[1], result, sizeof(result)) != sizeof(result) || !wait_for(release[0]))
+			_exit(3);
+		state.ReleaseAll();
+		state.Close();
+		_exit(0);
+	}
+
+	const std::string go(Clients + 1, 'x');
+	CHECK(write(start[1], go.data(), go.size()) == static_cast<ssize_t>(go.size()));
+	int owned = 0;
+	int torn = -1;
+	for (int client = 0; client <= Clients; ++client)
+	{
+		int result[2] = { -1, 0 };
+		CHECK(read(results[0], result, sizeof(result)) == sizeof(result));
+		if (result[0] == Clients)
+			torn = result[1];
+		else
+			owned += result[1];
+	}
+	CHECK(owned == GMs);
+	CHECK(torn == 0);
+	GMSharedState state;
+	CHECK(state.Open(Name.c_str()));
+	int live = 0;
+	state.ForEach(static_cast<int64_t>(time(nullptr)), [&live](const GMSharedState::Entry&) { ++live; });
+	CHECK(live == GMs);
+
+	CHECK(write(release[1], go.data(), go.size()) == static_cast<ssize_t>(go.size()));
+	int status = 0;
+	while (wait(&status) > 0)
+		CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	live = 0;
+	state.ForEach(static_cast<int64_t>(time(nullptr)), [&live](const GMSharedState::Entry&) { ++live; });
+	CHECK(live == 0);
+	for (int descriptor : { start[0], start[1], release[0], release[1], results[0], results[1] })
+		close(descriptor);
+}
+#endif
+
+int main()
+{
+	const std::string name = "GMCheckTest" + std::to_string(std::random_device()());
+	const int64_t now = static_cast<int64_t>(time(nullptr));
+
+	GMSharedState first;
+	GMSharedState second;
+	CHECK(first.Open(name.c_str()));
+	CHECK(second.Open(name.c_str()));
+
+	// Both handles in this process share a PID, so the first claim owns it for both
+	CHECK(first.Claim("server", 1, "Bob", 10, now));
+	CHECK(first.Owns("server", 1, "Bob"));
+	CHECK(!first.Owns("server", 2, "Bob"));
+	CHECK(!first.Owns("other", 1, "Bob"));
+
+	int live = 0;
+	second.ForEach(now, [&live](const GMSharedState::Entry& entry) { live += std::string(entry.GM) == "Bob"; });
+	CHECK(live == 1);
+
+	// A slot that isn't refreshed goes stale and stops being listed (or owned)
+	CHECK(!first.Claim("server", 1, "Stale", 11, now - GMSharedState::StaleSeconds - 1));
+	live = 0;
+	second.ForEach(now, [&live](const GMSharedState::Entry&) { ++live; });
+	CHECK(live == 1);
+
+	first.Release("server", 1, "Bob");
+	CHECK(!first.Owns("server", 1, "Bob"));
+	CHECK(first.Claim("server", 1, "Carl", 12, now));
+	first.ReleaseAll();
+	live = 0;
+	second.ForEach(now, [&live](const GMSharedState::Entry&) { ++live; });
+	CHECK(live == 0);
+
+	first.Close();
+	second.Close();
+	CHECK(!first.IsOpen());
+#if !defined(_WIN32)
+	CheckOpenWhileStamping(name);
+	CheckClients(name);
+	// Named segments outlive their last client on Linux
+	shm_unlink(("/" + name).c_str());
+#endif
+	return TestResult("test_shared_state");
+}
@@ -0,0 +1,135 @@
+#include "SoundWorker.h"
+#include "TestSupport.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+// Records what was played and when, can hold a play up until it's let go, and fails
+// anything called missing.wav
+class RecordingSoundBackend : public NullSoundBackend
+{
+public:
+	bool Play(const std::filesystem::path& SoundFile, uint32_t& Length, std::string& Error) override
+	{
+		std::unique_lock lock(m_Mutex);
+		Played.push_back(SoundFile.string());
+		PlayedAt.push_back(std::chrono::steady_clock::now());
+		m_Changed.notify_all();
+		m_Changed.wait(lock, [this] { return !Hold; });
+
+		if (SoundFile == "missing.wav")
+		{
+			Error = "Sound file not found: missing.wav";
+			return false;
+		}
+		return NullSoundBackend::Play(SoundFile, Length, Error);
+	}
+
+	void PlayError() override { ++Errors; }
+
+	void SetHold(bool Held)
+	{
+		std::scoped_lock lock(m_Mutex);
+		Hold = Held;
+		m_Changed.notify_all();
+	}
+
+	// Waits until Count sounds have been started, true if they were
+	bool WaitForPlays(size_t Count)
+	{
+		std::unique_lock lock(m_Mutex);
+		return m_Changed.wait_for(lock, 5s, [this, Count] { return Played.size() >= Count; });
+	}
+
+	std::chrono::steady_clock::time_point LastPlayedAt()
+	{
+		std::scoped_lock lock(m_Mutex);
+		return PlayedAt.back();
+	}
+
+	std::vector<std::string> PlayedFiles()
+	{
+		std::scoped_lock lock(m_Mutex);
+		return Played;
+	}
+
+	std::atomic<uint32_t> Errors = 0;
+
+private:
+	std::mutex m_Mutex;
+	std::condition_variable m_Changed;
+	std::vector<std::string> Played;
+	std::vector<std::chrono::steady_clock::time_point> PlayedAt;
+	bool Hold = false;
+};
+
+int main()
+{
+	constexpr size_t Plays = 200;
+	TraceBuffer trace;
+	LatencyHistogram play_time;
+	SoundWorker worker(trace, play_time);
+	auto owned = std::make_unique<RecordingSoundBackend>();
+	RecordingSoundBackend& backend = *owned;
+	worker.Start(std::move(owned));
+
+	// Enqueue to play, every sound is started as soon as it's queued even with the previous
+	// one still "playing"
+	LatencyHistogram latency;
+	for (size_t play = 0; play < Plays; ++play)
+	{
+		const auto queued = std::chrono::steady_clock::now();
+		worker.Play("enter.wav", SoundPriority::Enter);
+		if (!backend.WaitForPlays(play + 1))
+			break;
+		latency.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(backend.LastPlayedAt() - queued).count());
+	}
+	CHECK(latency.Count() == Plays);
+	// The last play is timed once the backend returns, which can be after it's seen to start
+	for (int wait = 0; wait < 500 && play_time.Count() < Plays; ++wait)
+		std::this_thread::sleep_for(1ms);
+	CHECK(worker.PlayCount() == Plays && backend.PlayCount == Plays);
+	CHECK(play_time.Count() == Plays);
+	CHECK(!worker.IsPending());
+	// Just a thread wakeup, generous enough for a busy build machine
+	CHECK(latency.Percentile(50) < 5'000'000);
+	CHECK(latency.Percentile(99) < 50'000'000);
+	CHECK(worker.MaxLatencyMS() > 0.0f && worker.MaxLatencyMS() <= latency.Max() / 1e6f + 1.0f);
+
+	// With the backend busy the queue keeps only the most important sound
+	backend.SetHold(true);
+	worker.Play("remind.wav", SoundPriority::Remind);
+	CHECK(backend.WaitForPlays(Plays + 1));
+	worker.Play("remind.wav", SoundPriority::Remind);
+	worker.Play("leave.wav", SoundPriority::Leave);
+	worker.Play("remind.wav", SoundPriority::Remind);
+	CHECK(worker.IsPending());
+	CHECK(worker.SupersededCount() == 2);
+	backend.SetHold(false);
+	CHECK(backend.WaitForPlays(Plays + 2));
+	std::vector<std::string> played = backend.PlayedFiles();
+	CHECK(played.size() == Plays + 2 && played.back() == "leave.wav");
+
+	// Failures play the error sound and are handed back to the pulse
+	CHECK(!worker.HasErrors());
+	worker.Play("missing.wav", SoundPriority::Enter);
+	CHECK(backend.WaitForPlays(Plays + 3));
+	for (int wait = 0; wait < 500 && !worker.HasErrors(); ++wait)
+		std::this_thread::sleep_for(1ms);
+	std::vector<std::string> errors;
+	CHECK(worker.TakeErrors(errors) && errors.size() == 1 && errors[0].find("missing.wav") != std::string::npos);
+	CHECK(backend.Errors == 1);
+	CHECK(!worker.HasErrors() && !worker.TakeErrors(errors));
+
+	worker.SetVolume(0x12345678);
+	for (int wait = 0; wait < 500 && backend.LastVolume != 0x12345678; ++wait)
+		std::this_thread::sleep_for(1ms);
+	CHECK(backend.LastVolume == 0x12345678);
+
+	worker.Stop();
+	CHECK(worker.GetCache() == nullptr);
+	return TestResult("test_sound_worker");
+}
@@ -0,0 +1,156 @@
+#include "GMTracker.h"
+#include "TestSupport.h"
+
+using namespace std::chrono_literals;
+using Tracker = GMTracker<FakeClock>;
+
+// Pulses once a frame for Length
+static void Run(Tracker& Track, FakeClock::duration Length)
+{
+	const FakeClock::time_point until = FakeClock::now() + Length;
+	while (FakeClock::now() < until)
+	{
+		FakeClock::Advance(16ms);
+		if (!Track.Idle(FakeClock::now()))
+			Track.Pulse(FakeClock::now());
+	}
+}
+
+// A GM whose enter alert was waiting can be gone again by the time the pulse gets to it, a
+// reminder due on that same pulse still has to be given, and on its original interval
+static void CheckReminderDuringAlert()
+{
+	TraceBuffer trace;
+	MockSpawnSource spawns;
+	RecordingAlertSink alerts;
+	TrackerOptions options;
+	options.ReminderInterval = 30s;
+	options.ReminderBackoff = 2;
+	options.ReminderZoneDelay = 0s;
+	Tracker track(spawns, alerts, trace, options, FakeClock::now());
+
+	// Pulsed on the second, so every pulse verifies
+	const auto step = [&track]()
+		{
+			FakeClock::Advance(1s);
+			if (!track.Idle(FakeClock::now()))
+				track.Pulse(FakeClock::now());
+		};
+
+	const uint64_t bob = GMRegistry::HashName("Bob");
+	track.AddGM(spawns.Ref(spawns.Add("Bob", true)));
+	// First seen on the tracker's clock
+	CHECK(track.GMs.FindByName("Bob")->FirstSeen == FakeClock::now().time_since_epoch());
+	step();
+	CHECK(alerts.Count(GMStatuses::Enter) == 1);
+	while (track.ReminderIn(bob, FakeClock::now()) > 1)
+		step();
+
+	const uint32_t carl = spawns.Add("Carl", true);
+	track.AddGM(spawns.Ref(carl));
+	spawns.Remove(carl);
+	step();
+	CHECK(!track.IsTracked(carl) && alerts.Count(GMStatuses::Enter) == 1);
+	step();
+	CHECK(alerts.Count(GMStatuses::Reminder) == 1 && track.RemindersFired() == 1);
+	CHECK(track.ReminderIn(bob, FakeClock::now()) == 60);
+}
+
+int main()
+{
+	TraceBuffer trace;
+	MockSpawnSource spawns;
+	spawns.Populate(200, 0);
+	RecordingAlertSink alerts;
+	TrackerOptions options;
+	options.ReminderInterval = 30s;
+	options.ReminderBackoff = 2;
+	options.ReminderMax = 600s;
+	options.ReminderZoneDelay = 10s;
+	Tracker track(spawns, alerts, trace, options, FakeClock::now());
+
+	// Nothing to do is most pulses
+	Run(track, 500ms);
+	CHECK(track.ActivePulses == 0 && track.SkippedPulses > 0);
+
+	// A GM from the spawn callback is sighted straight away and alerted on the next pulse
+	const uint32_t bob = spawns.Add("Bob", true);
+	track.AddGM(spawns.Ref(bob));
+	CHECK(alerts.Sightings.size() == 1 && alerts.Alerts.empty());
+	CHECK(track.AlertPending());
+	Run(track, 16ms);
+	CHECK(alerts.Count(GMStatuses::Enter) == 1 && alerts.Alerts[0].Names == "Bob");
+	CHECK(!track.AlertPending());
+	CHECK(track.ReminderIn(GMRegistry::HashName("Bob"), FakeClock::now()) == 30);
+
+	// Reminders at 30 seconds, then 60 after that
+	Run(track, 30s);
+	CHECK(alerts.Count(GMStatuses::Reminder) == 1);
+	Run(track, 59s);
+	CHECK(alerts.Count(GMStatuses::Reminder) == 1);
+	Run(track, 2s);
+	CHECK(alerts.Count(GMStatuses::Reminder) == 2);
+	CHECK(track.RemindersFired() == 2);
+
+	// Quiet holds back the enter alert until it's turned off again
+	options.Quiet = true;
+	track.Configure(options);
+	const uint32_t carl = spawns.Add("Carl", true);
+	track.AddGM(spawns.Ref(carl));
+	Run(track, 1s);
+	CHECK(alerts.Count(GMStatuses::Enter) == 1);
+	options.Quiet = false;
+	track.Configure(options);
+	Run(track, 16ms);
+	CHECK(alerts.Count(GMStatuses::Enter) == 2);
+
+	// A GM that goes away without a despawn is dropped by the next verify
+	spawns.Remove(carl);
+	Run(track, 1100ms);
+	CHECK(!track.IsTracked(carl) && track.GMCount() == 1);
+	CHECK((alerts.Removals == std::vector<std::string>{ "Carl" }));
+
+	// A despawn goes the same way
+	const uint32_t gone = spawns.Add("Gone", true);
+	track.AddGM(spawns.Ref(gone));
+	Run(track, 16ms);
+	track.RemoveGM(gone);
+	spawns.Remove(gone);
+	CHECK(alerts.Removals.size() == 2 && alerts.Removals[1] == "Gone");
+
+	// The audit finds a GM flag that turned on without a spawn event
+	const uint32_t dave = spawns.Add("Dave", false);
+	spawns.SetGM(dave, true);
+	Run(track, 300s);
+	CHECK(track.IsTracked(dave));
+	CHECK(track.AuditCount == 1 && track.AuditDriftCount == 1);
+
+	// And one that loses the GM flag
+	spawns.SetGM(dave, false);
+	Run(track, 1100ms);
+	CHECK(!track.IsTracked(dave) && alerts.Removals.back() == "Dave");
+	spawns.SetGM(dave, true);
+	track.AddGM(spawns.Ref(dave));
+
+	// Zoning starts over, and reminders wait out the zone delay
+	const size_t removals = alerts.Removals.size();
+	track.Clear();
+	CHECK(track.GMCount() == 0 && alerts.Removals.size() == removals);
+	const size_t reminders = alerts.Count(GMStatuses::Reminder);
+	track.Restart(FakeClock::now());
+	Run(track, 16ms);
+	CHECK(track.GMCount() == 2);
+	Run(track, 5s);
+	CHECK(alerts.Count(GMStatuses::Reminder) == reminders);
+
+	// Turned off, nothing is alerted at all
+	options.Enabled = false;
+	track.Configure(options);
+	const size_t total = alerts.Alerts.size();
+	track.AddGM(spawns.Ref(spawns.Add("Eve", true)));
+	Run(track, 120s);
+	CHECK(alerts.Alerts.size() == total);
+
+	CheckReminderDuringAlert();
+	return TestResult("test_tracker");
+}